@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+* @addtogroup http
+*
+* @{
+* @file httpd.c
+*
+* runs the http server on the host, for load testing with loadgen.
+*
+* usage: httpd [-e] [configfile]
+*
+* -e runs the event driven server, rather than the threaded server. the config file is read
+* as on the target, httpd.conf by default, with fsroot set to a local directory.
+*
+* besides the files under fsroot, four API calls are served:
+*  - /api/channel/:id, a small JSON response, to measure the cost of an API call.
+*  - /api/status, the connection pool and cache counters.
+*  - /api/echo, a websocket that sends back each message, served by the threaded server only.
+*  - /metrics, the request counters and latency histograms, see http_metrics.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include "http_server.h"
+#include "http_event_server.h"
+#include "http_api.h"
+#include "http_metrics.h"
+
+#define HTTPD_DEFAULT_CONFIG        "httpd.conf"
+
+static httpserver_t* httpd;
+static int httpd_conn_bytes;
+
+static int httpd_channel(int fdes, const http_api_params_t* params, int content_length, char* buffer, int size)
+{
+    (void)content_length;
+    int length = snprintf(buffer, size, "{\"channel\":\"%s\",\"value\":%u}",
+                            http_api_param(params, "id"), (unsigned int)xTaskGetTickCount());
+    return http_api_write_chunk(fdes, buffer, length);
+}
+
+static int httpd_status(int fdes, int content_length, char* buffer, int size)
+{
+    (void)content_length;
+    int length = snprintf(buffer, size,
+            "{\"conns\":%d,\"conn_bytes\":%d,\"peak\":%d,\"exhausted\":%lu,\"cache_hits\":%u,\"cache_misses\":%u}",
+            httpd->conn_pool.count, httpd_conn_bytes, httpd->conn_pool.peak, httpd->conn_pool.exhausted,
+            httpd->cache.hits, httpd->cache.misses);
+    return http_api_write_chunk(fdes, buffer, length);
+}
+
+static int httpd_echo(http_websocket_t* websocket, const http_api_params_t* params, char* buffer, int size)
+{
+    (void)params;
+    int length;
+
+    while(!websocket->closed)
+    {
+        // 0 is returned once a ping or pong has been handled
+        length = http_websocket_receive(websocket, buffer, size, -1);
+        if(length > 0)
+            http_websocket_send(websocket, websocket->opcode, buffer, length);
+    }
+    return 0;
+}
+
+static const http_api_t httpd_channel_api = {"api/channel/:id", NULL, HTTP_API_CHUNKED, HTTP_GET, httpd_channel};
+static const http_api_t httpd_status_api = {"api/status", httpd_status, HTTP_API_CHUNKED, HTTP_GET, NULL};
+static const http_api_t httpd_echo_api = {"api/echo", NULL, HTTP_API_WEBSOCKET, HTTP_GET, NULL, httpd_echo};
+static const http_api_t* httpd_api[] = {&httpd_channel_api, &httpd_status_api, &httpd_echo_api, &http_metrics_api, NULL};
+
+int main(int argc, char** argv)
+{
+    static httpserver_t threaded;
+    static http_event_server_t event;
+    bool evented = argc > 1 && !strcmp(argv[1], "-e");
+    char* configfile = argc > (evented ? 2 : 1) ? argv[argc - 1] : HTTPD_DEFAULT_CONFIG;
+    int fdes;
+
+    // lwip returns an error on sending to a closed connection, Linux raises SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+
+    if(evented)
+    {
+        httpd = &event.http;
+        fdes = init_http_event_server(&event, configfile, httpd_api);
+        // the context and its poll entry
+        httpd_conn_bytes = httpd->conn_pool.size + sizeof(struct pollfd);
+    }
+    else
+    {
+        httpd = &threaded;
+        fdes = init_http_server(&threaded, configfile, httpd_api);
+        // the context and the stack of its worker task on the target, 32 bit words
+        httpd_conn_bytes = httpd->conn_pool.size + HTTP_SERVER_STACK_SIZE * 4;
+    }
+
+    if(fdes == -1)
+    {
+        fprintf(stderr, "failed to start the server, check %s\n", configfile);
+        return 1;
+    }
+
+    printf("%s server on port %d, %d connections of %d bytes\n", evented ? "event driven" : "threaded",
+            httpd->server.port, httpd->conn_pool.count, httpd_conn_bytes);
+    fflush(stdout);
+
+    while(1)
+        pause();
+
+    return 0;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+* @addtogroup http
+*
+* @{
+* @file loadgen.c
+*
+* a load generator for the http server, run against the host build, httpd, or a target.
+*
+* usage: loadgen [-c conns] [-d seconds] [-k] host:port path [path...]
+*
+* -c is the number of connections, each run by its own thread, 8 by default.
+* -d is the duration of the test in seconds, 10 by default.
+* -k keeps connections alive between requests, otherwise a connection is made for each request.
+*
+* the paths are requested in turn, by each connection. the results are the number of requests
+* per second, the latency percentiles, and the server connection counters from /api/status,
+* when the server has it.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define LOADGEN_BUFFER_LEN      16384
+#define LOADGEN_STATUS_PATH     "/api/status"
+
+typedef struct {
+    int fdes;
+    char buffer[LOADGEN_BUFFER_LEN];
+    int start;                      ///< the start of the unread data in buffer
+    int end;                        ///< the end of the data in buffer
+}loadgen_conn_t;
+
+typedef struct {
+    pthread_t thread;
+    int index;
+    unsigned long requests;
+    unsigned long errors;
+    unsigned long failed;           ///< responses with a status other than 2xx
+    unsigned long long bytes;
+    unsigned int* latency;          ///< the latency of each request in us
+    unsigned long latencies;
+    unsigned long size;
+    loadgen_conn_t conn;
+}loadgen_worker_t;
+
+static struct sockaddr_in loadgen_addr;
+static const char* loadgen_host;
+static char** loadgen_paths;
+static int loadgen_npaths;
+static bool loadgen_keepalive;
+static double loadgen_deadline;
+
+static double loadgen_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int loadgen_connect(void)
+{
+    int one = 1;
+    int fdes = socket(AF_INET, SOCK_STREAM, 0);
+
+    if(fdes == -1)
+        return -1;
+
+    if(connect(fdes, (struct sockaddr*)&loadgen_addr, sizeof(loadgen_addr)) == -1)
+    {
+        close(fdes);
+        return -1;
+    }
+
+    setsockopt(fdes, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fdes;
+}
+
+/**
+ * @retval  returns the next line of the response, without the line ending, or NULL if the connection closed.
+ */
+static char* loadgen_line(loadgen_conn_t* conn)
+{
+    char* eol;
+    char* line;
+    int n;
+
+    while(1)
+    {
+        conn->buffer[conn->end] = '\0';
+        eol = strstr(conn->buffer + conn->start, "\r\n");
+        if(eol)
+        {
+            *eol = '\0';
+            line = conn->buffer + conn->start;
+            conn->start = eol + 2 - conn->buffer;
+            return line;
+        }
+
+        // make room for the rest of the line
+        memmove(conn->buffer, conn->buffer + conn->start, conn->end - conn->start);
+        conn->end -= conn->start;
+        conn->start = 0;
+        if(conn->end >= LOADGEN_BUFFER_LEN - 1)
+            return NULL;
+
+        n = recv(conn->fdes, conn->buffer + conn->end, LOADGEN_BUFFER_LEN - 1 - conn->end, 0);
+        if(n <= 0)
+            return NULL;
+        conn->end += n;
+    }
+}
+
+/**
+ * skips length bytes of the response, or to the end of the connection if length is -1.
+ * @retval  returns the number of bytes skipped, or -1 if the connection closed early.
+ */
+static long loadgen_skip(loadgen_conn_t* conn, long length)
+{
+    long skipped = 0;
+    int n;
+
+    while(length < 0 || skipped < length)
+    {
+        if(conn->start == conn->end)
+        {
+            conn->start = conn->end = 0;
+            n = recv(conn->fdes, conn->buffer, LOADGEN_BUFFER_LEN - 1, 0);
+            if(n <= 0)
+                return length < 0 ? skipped : -1;
+            conn->end = n;
+        }
+
+        n = conn->end - conn->start;
+        if(length >= 0 && n > length - skipped)
+            n = length - skipped;
+        conn->start += n;
+        skipped += n;
+    }
+
+    return skipped;
+}
+
+/**
+ * sends a request and reads the whole response.
+ * @retval  returns the status, or -1 on error. keepalive is cleared if the server closes the connection.
+ */
+static int loadgen_request(loadgen_conn_t* conn, const char* path, bool* keepalive, unsigned long long* bytes, char* body, int size)
+{
+    char request[256];
+    char* line;
+    long length = -1;
+    long chunk;
+    long n;
+    bool chunked = false;
+    int status;
+
+    n = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: %s\r\n%s\r\n",
+            path, loadgen_host, *keepalive ? "" : "Connection: close\r\n");
+    if(send(conn->fdes, request, n, 0) != n)
+        return -1;
+
+    line = loadgen_line(conn);
+    if(!line || sscanf(line, "HTTP/1.%*d %d", &status) != 1)
+        return -1;
+    if(!strncmp(line, "HTTP/1.0", 8))
+        *keepalive = false;
+
+    while((line = loadgen_line(conn)) && *line)
+    {
+        if(!strncasecmp(line, "Content-Length:", 15))
+            length = atol(line + 15);
+        else if(!strncasecmp(line, "Transfer-Encoding:", 18) && strstr(line, "chunked"))
+            chunked = true;
+        else if(!strncasecmp(line, "Connection:", 11) && strstr(line, "close"))
+            *keepalive = false;
+    }
+    if(!line)
+        return -1;
+
+    if(body)
+        body[0] = '\0';
+
+    if(chunked)
+    {
+        while((line = loadgen_line(conn)) && (chunk = strtol(line, NULL, 16)) > 0)
+        {
+            // keep the start of the body, for /api/status
+            if(body && conn->end - conn->start >= chunk && chunk < size - (int)strlen(body))
+                strncat(body, conn->buffer + conn->start, chunk);
+            if(loadgen_skip(conn, chunk) != chunk || !loadgen_line(conn))
+                return -1;
+            *bytes += chunk;
+        }
+        if(!line)
+            return -1;
+        // the trailer ends with an empty line
+        do {
+            line = loadgen_line(conn);
+        } while(line && *line);
+        if(!line)
+            return -1;
+    }
+    else
+    {
+        if(length < 0)
+            *keepalive = false;
+        n = loadgen_skip(conn, length);
+        if(n < 0)
+            return -1;
+        *bytes += n;
+    }
+
+    return status;
+}
+
+static void loadgen_record(loadgen_worker_t* worker, double latency)
+{
+    if(worker->latencies == worker->size)
+    {
+        worker->size = worker->size ? worker->size * 2 : 4096;
+        worker->latency = realloc(worker->latency, worker->size * sizeof(unsigned int));
+    }
+    worker->latency[worker->latencies++] = (unsigned int)(latency * 1e6);
+}
+
+static void* loadgen_worker(void* param)
+{
+    loadgen_worker_t* worker = (loadgen_worker_t*)param;
+    loadgen_conn_t* conn = &worker->conn;
+    bool keepalive = false;
+    double start;
+    int next = worker->index;
+    int status;
+
+    conn->fdes = -1;
+
+    while(loadgen_now() < loadgen_deadline)
+    {
+        start = loadgen_now();
+
+        if(conn->fdes == -1)
+        {
+            conn->fdes = loadgen_connect();
+            conn->start = conn->end = 0;
+            keepalive = loadgen_keepalive;
+            if(conn->fdes == -1)
+            {
+                worker->errors++;
+                usleep(1000);
+                continue;
+            }
+        }
+
+        status = loadgen_request(conn, loadgen_paths[next++ % loadgen_npaths], &keepalive, &worker->bytes, NULL, 0);
+
+        if(status == -1)
+            worker->errors++;
+        else
+        {
+            worker->requests++;
+            if(status / 100 != 2)
+                worker->failed++;
+            loadgen_record(worker, loadgen_now() - start);
+        }
+
+        if(status == -1 || !keepalive)
+        {
+            close(conn->fdes);
+            conn->fdes = -1;
+        }
+    }
+
+    if(conn->fdes != -1)
+        close(conn->fdes);
+
+    return NULL;
+}
+
+static int loadgen_compare(const void* a, const void* b)
+{
+    unsigned int x = *(const unsigned int*)a;
+    unsigned int y = *(const unsigned int*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void loadgen_usage(void)
+{
+    fprintf(stderr, "usage: loadgen [-c conns] [-d seconds] [-k] host:port path [path...]\n");
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    static loadgen_conn_t statusconn;
+    int conns = 8;
+    int duration = 10;
+    loadgen_worker_t* workers;
+    struct addrinfo hints;
+    struct addrinfo* res;
+    unsigned long requests = 0, errors = 0, failed = 0, count = 0;
+    unsigned long long bytes = 0;
+    unsigned int* latency;
+    char host[64];
+    char body[512];
+    char* port;
+    double elapsed;
+    bool keepalive = false;
+    int opt;
+    int i;
+
+    while((opt = getopt(argc, argv, "c:d:k")) != -1)
+    {
+        if(opt == 'c')
+            conns = atoi(optarg);
+        else if(opt == 'd')
+            duration = atoi(optarg);
+        else if(opt == 'k')
+            loadgen_keepalive = true;
+        else
+            loadgen_usage();
+    }
+
+    if(argc - optind < 2 || conns <= 0 || duration <= 0)
+        loadgen_usage();
+
+    strncpy(host, argv[optind], sizeof(host) - 1);
+    host[sizeof(host) - 1] = '\0';
+    port = strchr(host, ':');
+    if(!port)
+        loadgen_usage();
+    *port++ = '\0';
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host, port, &hints, &res) != 0)
+    {
+        fprintf(stderr, "could not resolve %s\n", host);
+        return 1;
+    }
+    loadgen_addr = *(struct sockaddr_in*)res->ai_addr;
+    freeaddrinfo(res);
+
+    loadgen_host = host;
+    loadgen_paths = argv + optind + 1;
+    loadgen_npaths = argc - optind - 1;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    workers = calloc(conns, sizeof(loadgen_worker_t));
+    if(!workers)
+        return 1;
+
+    printf("%d connections for %ds, %s, %d paths\n", conns, duration,
+            loadgen_keepalive ? "keep-alive" : "a connection per request", loadgen_npaths);
+
+    elapsed = loadgen_now();
+    loadgen_deadline = elapsed + duration;
+    for(i = 0; i < conns; i++)
+    {
+        workers[i].index = i;
+        pthread_create(&workers[i].thread, NULL, loadgen_worker, &workers[i]);
+    }
+    for(i = 0; i < conns; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        requests += workers[i].requests;
+        errors += workers[i].errors;
+        failed += workers[i].failed;
+        bytes += workers[i].bytes;
+    }
+    elapsed = loadgen_now() - elapsed;
+
+    latency = malloc((requests + 1) * sizeof(unsigned int));
+    for(i = 0; latency && i < conns; i++)
+    {
+        memcpy(latency + count, workers[i].latency, workers[i].latencies * sizeof(unsigned int));
+        count += workers[i].latencies;
+    }
+
+    printf("requests:   %lu, %.0f/s, %.1fKB/s\n", requests, requests / elapsed, bytes / elapsed / 1024);
+    printf("errors:     %lu, not 2xx: %lu\n", errors, failed);
+    if(latency && count)
+    {
+        qsort(latency, count, sizeof(unsigned int), loadgen_compare);
+        printf("latency:    p50 %.2fms, p99 %.2fms, max %.2fms\n",
+                latency[count / 2] / 1000.0, latency[count * 99 / 100] / 1000.0, latency[count - 1] / 1000.0);
+    }
+
+    // the server side of the cost, from the host build
+    statusconn.fdes = loadgen_connect();
+    if(statusconn.fdes != -1)
+    {
+        bytes = 0;
+        if(loadgen_request(&statusconn, LOADGEN_STATUS_PATH, &keepalive, &bytes, body, sizeof(body)) / 100 == 2)
+            printf("server:     %s\n", body);
+        close(statusconn.fdes);
+    }
+
+    return 0;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+* @addtogroup http
+*
+* @{
+* @file posix_shim.h
+*
+* maps the like-posix and lwIP socket calls to Linux sockets, for the host build of the http server.
+* the shim is included ahead of every source file by the makefile, with -include.
+*
+* on the target, sys/socket.h from like-posix pulls in the lwIP socket API. on the host, the
+* same calls are made on Linux sockets, and the files are served from a local directory,
+* set by fsroot in the config file.
+*
+* the differences that matter are handled here:
+*  - closesocket() and ioctlsocket() are lwIP names.
+*  - lwIP takes the SO_RCVTIMEO tv_sec field as ms, setsockopt() converts it for Linux.
+*  - Linux raises SIGPIPE on sending to a closed connection, lwIP returns an error. the
+*    host programs must ignore SIGPIPE.
+*/
+
+#ifndef HOST_POSIX_SHIM_H_
+#define HOST_POSIX_SHIM_H_
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#define closesocket(s)          close(s)
+
+int ioctlsocket(int fdes, long cmd, void* argp);
+int host_setsockopt(int fdes, int level, int optname, const void* optval, socklen_t optlen);
+int host_bind(int fdes, const struct sockaddr* addr, socklen_t length);
+
+#define setsockopt(s, l, n, v, len)     host_setsockopt(s, l, n, v, len)
+#define bind(s, a, len)                 host_bind(s, a, len)
+
+#endif /* HOST_POSIX_SHIM_H_ */
+
+/**
+ * @}
+ */
@@ -0,0 +1,369 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+* @addtogroup http
+*
+* @{
+* @file shim.c
+*
+* the FreeRTOS and lwIP calls used by the http server, implemented with pthreads and
+* Linux sockets, for the host build. see posix_shim.h.
+*/
+
+#include <pthread.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "syscalls.h"
+#include "net.h"
+
+#undef setsockopt
+#undef bind
+
+struct _host_queue_t {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int length;
+    int itemsize;
+    int head;
+    int count;
+    char* items;
+};
+
+struct _host_semaphore_t {
+    pthread_mutex_t lock;
+};
+
+typedef struct {
+    TaskFunction_t func;
+    void* param;
+}host_task_t;
+
+/**
+ * the scheduler lock, taken by vTaskSuspendAll(). recursive, as the FreeRTOS calls nest.
+ */
+static pthread_mutex_t host_scheduler_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+/**
+ * the number of running tasks, main included.
+ */
+static unsigned long host_tasks = 1;
+
+static void host_task_exit(void* param)
+{
+    (void)param;
+    __atomic_fetch_sub(&host_tasks, 1, __ATOMIC_RELAXED);
+}
+
+static void* host_task(void* param)
+{
+    host_task_t task = *(host_task_t*)param;
+    free(param);
+    __atomic_fetch_add(&host_tasks, 1, __ATOMIC_RELAXED);
+    pthread_cleanup_push(host_task_exit, NULL);
+    task.func(task.param);
+    pthread_cleanup_pop(1);
+    return NULL;
+}
+
+/**
+ * @retval  returns the time at which a wait of ticks ms ends.
+ */
+static struct timespec host_deadline(portTickType ticks)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (ticks % 1000) * 1000000L;
+    if(ts.tv_nsec >= 1000000000L)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+/**
+ * waits on a queue condition, forever if ticks is portMAX_DELAY.
+ * @retval  returns false on timeout.
+ */
+static bool host_wait(struct _host_queue_t* queue, portTickType ticks)
+{
+    struct timespec ts;
+
+    if(ticks == portMAX_DELAY)
+        return pthread_cond_wait(&queue->changed, &queue->lock) == 0;
+
+    ts = host_deadline(ticks);
+    return pthread_cond_timedwait(&queue->changed, &queue->lock, &ts) != ETIMEDOUT;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t func, const char* name, int stackdepth, void* param, int prio, TaskHandle_t* handle)
+{
+    (void)name;
+    (void)stackdepth;
+    (void)prio;
+    pthread_t thread;
+    pthread_attr_t attr;
+    host_task_t* task = malloc(sizeof(host_task_t));
+    int res;
+
+    if(!task)
+        return pdFAIL;
+
+    task->func = func;
+    task->param = param;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, HOST_TASK_STACK_SIZE);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    res = pthread_create(&thread, &attr, host_task, task);
+    pthread_attr_destroy(&attr);
+
+    if(res != 0)
+    {
+        free(task);
+        return pdFAIL;
+    }
+
+    if(handle)
+        *handle = (TaskHandle_t)thread;
+
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t handle)
+{
+    if(!handle)
+        pthread_exit(NULL);
+    pthread_cancel((pthread_t)handle);
+}
+
+void vTaskDelay(portTickType ticks)
+{
+    usleep(ticks * 1000);
+}
+
+portTickType xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (portTickType)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+void vTaskSuspendAll(void)
+{
+    pthread_mutex_lock(&host_scheduler_lock);
+}
+
+BaseType_t xTaskResumeAll(void)
+{
+    pthread_mutex_unlock(&host_scheduler_lock);
+    return pdFALSE;
+}
+
+unsigned long uxTaskGetNumberOfTasks(void)
+{
+    return __atomic_load_n(&host_tasks, __ATOMIC_RELAXED);
+}
+
+/**
+ * the free memory held by malloc, the host has no fixed heap.
+ */
+size_t xPortGetFreeHeapSize(void)
+{
+    return mallinfo2().fordblks;
+}
+
+/**
+ * the host has no file table, or network driver counters.
+ */
+int file_table_hwm()
+{
+    return 0;
+}
+
+unsigned long net_ip_packets_sent()
+{
+    return 0;
+}
+
+unsigned long net_ip_packets_received()
+{
+    return 0;
+}
+
+unsigned long net_ip_packets_dropped()
+{
+    return 0;
+}
+
+unsigned long net_ip_errors()
+{
+    return 0;
+}
+
+QueueHandle_t xQueueCreate(int length, int itemsize)
+{
+    struct _host_queue_t* queue = calloc(1, sizeof(struct _host_queue_t));
+
+    if(queue)
+    {
+        queue->items = malloc(length * itemsize);
+        if(!queue->items)
+        {
+            free(queue);
+            return NULL;
+        }
+        queue->length = length;
+        queue->itemsize = itemsize;
+        pthread_mutex_init(&queue->lock, NULL);
+        pthread_cond_init(&queue->changed, NULL);
+    }
+
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, portTickType ticks)
+{
+    BaseType_t res = pdFALSE;
+
+    pthread_mutex_lock(&queue->lock);
+    while(queue->count == queue->length && ticks && host_wait(queue, ticks));
+    if(queue->count < queue->length)
+    {
+        memcpy(queue->items + ((queue->head + queue->count) % queue->length) * queue->itemsize, item, queue->itemsize);
+        queue->count++;
+        pthread_cond_broadcast(&queue->changed);
+        res = pdTRUE;
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return res;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, portTickType ticks)
+{
+    BaseType_t res = pdFALSE;
+
+    pthread_mutex_lock(&queue->lock);
+    while(queue->count == 0 && ticks && host_wait(queue, ticks));
+    if(queue->count > 0)
+    {
+        memcpy(item, queue->items + queue->head * queue->itemsize, queue->itemsize);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->changed);
+        res = pdTRUE;
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return res;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    free(queue->items);
+    free(queue);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    struct _host_semaphore_t* semaphore = malloc(sizeof(struct _host_semaphore_t));
+
+    if(semaphore)
+        pthread_mutex_init(&semaphore->lock, NULL);
+
+    return semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, portTickType ticks)
+{
+    struct timespec ts;
+
+    if(ticks == portMAX_DELAY)
+        return pthread_mutex_lock(&semaphore->lock) == 0 ? pdTRUE : pdFALSE;
+
+    ts = host_deadline(ticks);
+    return pthread_mutex_timedlock(&semaphore->lock, &ts) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    return pthread_mutex_unlock(&semaphore->lock) == 0 ? pdTRUE : pdFALSE;
+}
+
+int ioctlsocket(int fdes, long cmd, void* argp)
+{
+    return ioctl(fdes, cmd, argp);
+}
+
+/**
+ * as setsockopt(), but takes the SO_RCVTIMEO and SO_SNDTIMEO tv_sec field as ms, as lwIP does.
+ */
+int host_setsockopt(int fdes, int level, int optname, const void* optval, socklen_t optlen)
+{
+    struct timeval tv;
+
+    if(level == SOL_SOCKET && (optname == SO_RCVTIMEO || optname == SO_SNDTIMEO) && optlen == sizeof(struct timeval))
+    {
+        tv.tv_sec = ((const struct timeval*)optval)->tv_sec / 1000;
+        tv.tv_usec = (((const struct timeval*)optval)->tv_sec % 1000) * 1000;
+        optval = &tv;
+    }
+
+    return setsockopt(fdes, level, optname, optval, optlen);
+}
+
+/**
+ * as bind(), but allows the address to be reused while old connections are in TIME_WAIT.
+ */
+int host_bind(int fdes, const struct sockaddr* addr, socklen_t length)
+{
+    int one = 1;
+
+    setsockopt(fdes, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    return bind(fdes, addr, length);
+}
+
+/**
+ * @}
+ */
@@ -37,6 +37,7 @@
 * @file http_api.c
 */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
@@ -62,13 +63,331 @@ const http_api_t* http_api_check(const http_api_t** api, const char* url)
 	return NULL;
 }
 
-int http_api_process(const http_api_t* memb, int fdes, int content_length, char* buffer, int size)
+/**
+ * a node of the router tree, one path segment of one or more API members.
+ */
+struct _http_api_node_t {
+	http_api_node_t* child;         ///< the first child with a constant segment
+	http_api_node_t* next;          ///< the next sibling
+	http_api_node_t* param;         ///< the child that matches any segment
+	http_api_node_t* method;        ///< the next member with the same path, for another method
+	const http_api_t* memb;         ///< the member that ends at this node, or NULL
+	int length;                     ///< the length of the segment
+	char segment[];                 ///< the segment, empty for a parameter
+};
+
+/**
+ * the position of a parameter value in the url, while matching.
+ */
+typedef struct {
+	const char* start;
+	int length;
+}http_api_span_t;
+
+#define http_api_end_of_path(c)     ((c) == '\0' || (c) == '?')
+
+/**
+ * @retval  returns the length of the path segment at the start of path.
+ */
+static int http_api_segment(const char* path)
+{
+	int length = 0;
+	while(!http_api_end_of_path(path[length]) && path[length] != HTTP_SLASH_CHAR)
+		length++;
+	return length;
+}
+
+/**
+ * @retval  returns path with the leading slashes skipped.
+ */
+static const char* http_api_skip_slashes(const char* path)
+{
+	while(*path == HTTP_SLASH_CHAR)
+		path++;
+	return path;
+}
+
+static http_api_node_t* http_api_node(const char* segment, int length)
+{
+	http_api_node_t* node = calloc(1, sizeof(http_api_node_t) + length + 1);
+	if(node)
+	{
+		node->length = length;
+		memcpy(node->segment, segment, length);
+	}
+	return node;
+}
+
+/**
+ * @brief   adds an API member to the router tree.
+ * @retval  returns false if there was not enough memory.
+ */
+static bool http_api_insert(http_api_node_t* node, const http_api_t* memb)
+{
+	const char* path = http_api_skip_slashes(memb->name);
+	http_api_node_t** link;
+	int length;
+
+	while(!http_api_end_of_path(*path))
+	{
+		length = http_api_segment(path);
+
+		if(*path == HTTP_API_PARAM_CHAR)
+		{
+			// one parameter per level, the names are taken from the member matched, see http_api_route()
+			link = &node->param;
+			if(!*link)
+				*link = http_api_node(NULL, 0);
+		}
+		else
+		{
+			for(link = &node->child; *link; link = &(*link)->next)
+			{
+				if((*link)->length == length && !memcmp((*link)->segment, path, length))
+					break;
+			}
+			if(!*link)
+				*link = http_api_node(path, length);
+		}
+
+		node = *link;
+		if(!node)
+			return false;
+		path = http_api_skip_slashes(path + length);
+	}
+
+	// the first member for a path and method is used, as with the list
+	while(node->memb)
+	{
+		if(!node->method)
+			node->method = http_api_node(NULL, 0);
+		node = node->method;
+		if(!node)
+			return false;
+	}
+	node->memb = memb;
+
+	return true;
+}
+
+/**
+ * @brief   finds the next parameter in the name of an API member.
+ * @param   length is set to the length of the parameter segment, including the colon.
+ * @retval  returns the parameter segment, or NULL if there are no more.
+ */
+static const char* http_api_next_param(const char* path, int* length)
+{
+	path = http_api_skip_slashes(path);
+	while(!http_api_end_of_path(*path))
+	{
+		*length = http_api_segment(path);
+		if(*path == HTTP_API_PARAM_CHAR)
+			return path;
+		path = http_api_skip_slashes(path + *length);
+	}
+	return NULL;
+}
+
+/**
+ * @brief   finds the node that matches a url path.
+ *
+ * constant segments are matched first, the parameter is tried when they do not match the rest of the path.
+ */
+static const http_api_node_t* http_api_match(const http_api_node_t* node, const char* path, http_api_span_t* spans, int* count)
+{
+	const http_api_node_t* match;
+	const http_api_node_t* child;
+	int length;
+
+	path = http_api_skip_slashes(path);
+	if(http_api_end_of_path(*path))
+		return node->memb ? node : NULL;
+
+	length = http_api_segment(path);
+
+	for(child = node->child; child; child = child->next)
+	{
+		if(child->length == length && !memcmp(child->segment, path, length))
+		{
+			match = http_api_match(child, path + length, spans, count);
+			if(match)
+				return match;
+			break;
+		}
+	}
+
+	if(node->param && *count < HTTP_API_MAX_PARAMS)
+	{
+		spans[*count].start = path;
+		spans[*count].length = length;
+		(*count)++;
+		match = http_api_match(node->param, path + length, spans, count);
+		if(match)
+			return match;
+		(*count)--;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief   builds the router tree from a list of API members.
+ *
+ * the tree is built once, and lookups take time in proportion to the length of the url,
+ * rather than the number of members.
+ *
+ * @param   router is the router to initialise.
+ * @param   api is a NULL terminated list of API members, or NULL.
+ * @retval  returns false if there was not enough memory, the router holds the members added so far.
+ */
+bool http_api_router_init(http_api_router_t* router, const http_api_t** api)
+{
+	router->root = http_api_node(NULL, 0);
+	if(!router->root)
+		return false;
+
+	while(api && *api)
+	{
+		if(!http_api_insert(router->root, *api))
+			return false;
+		api++;
+	}
+
+	return true;
+}
+
+/**
+ * @brief   finds the API member that serves a request.
+ *
+ * @param   router is the router to search.
+ * @param   method is the request method, HTTP_GET or HTTP_POST.
+ * @param   url is the requested url, the query string is ignored.
+ * @param   params is set to the path parameters of the member found. params->allowed is
+ *          set to false if a member has the path, but none serves the method.
+ * @retval  returns the member, or NULL if there was no match.
+ */
+const http_api_t* http_api_route(const http_api_router_t* router, const char* method, const char* url, http_api_params_t* params)
 {
-	if(memb)
+	http_api_span_t spans[HTTP_API_MAX_PARAMS];
+	const http_api_node_t* node = NULL;
+	char* value = params->buffer;
+	const char* name;
+	int length;
+	int count = 0;
+	int i;
+
+	params->count = 0;
+	params->allowed = true;
+
+	if(router->root && url && url[0] == HTTP_SLASH_CHAR && url[1])
+		node = http_api_match(router->root, url, spans, &count);
+	if(!node)
+		return NULL;
+
+	for(; node; node = node->method)
+	{
+		if(!node->memb->method || (method && !strcmp(node->memb->method, method)))
+			break;
+	}
+	if(!node)
+	{
+		params->allowed = false;
+		return NULL;
+	}
+
+	// members that share a parameter level may name it differently, so the names are those of the member
+	name = node->memb->name;
+	for(i = 0; i < count; i++)
+	{
+		name = http_api_next_param(name, &length);
+		if(!name || value + spans[i].length + length + 1 > params->buffer + sizeof(params->buffer))
+			return NULL;
+		memcpy(value, spans[i].start, spans[i].length);
+		value[spans[i].length] = '\0';
+		params->value[i] = value;
+		value += spans[i].length + 1;
+		memcpy(value, name + 1, length - 1);
+		value[length - 1] = '\0';
+		params->name[i] = value;
+		value += length;
+		name += length;
+	}
+	params->count = count;
+
+	return node->memb;
+}
+
+/**
+ * @brief   gets the value of a path parameter.
+ * @param   params are the parameters set by http_api_route().
+ * @param   name is the name of the parameter, without the colon.
+ * @retval  returns the value, or NULL if there is no parameter of that name.
+ */
+const char* http_api_param(const http_api_params_t* params, const char* name)
+{
+	int i;
+	for(i = 0; i < params->count; i++)
+	{
+		if(!strcmp(params->name[i], name))
+			return params->value[i];
+	}
+	return NULL;
+}
+
+int http_api_process(const http_api_t* memb, const http_api_params_t* params, int fdes, int content_length, char* buffer, int size)
+{
+	if(memb && memb->route)
+		return memb->route(fdes, params, content_length, buffer, size);
+	if(memb && memb->func)
 		return memb->func(fdes, content_length, buffer, size);
 	return -1;
 }
 
+/**
+ * @brief   serves a websocket with an API member flagged with HTTP_API_WEBSOCKET.
+ * @param   websocket is the state of the connection, after http_websocket_handshake().
+ */
+int http_api_websocket(const http_api_t* memb, const http_api_params_t* params, http_websocket_t* websocket, char* buffer, int size)
+{
+	if(memb && memb->websocket)
+		return memb->websocket(websocket, params, buffer, size);
+	return -1;
+}
+
+/**
+ * sends data as one chunk of a chunked transfer encoded response.
+ *
+ * for use by api member functions flagged with HTTP_API_CHUNKED. the server ends the
+ * response when the member function returns. may be used as the output function of a json writer:
+ *
+\code
+json_writer_init(&writer, buffer, size, fdes);
+writer.output = http_api_write_chunk;
+\endcode
+ *
+ * @param   fdes - the connection socket.
+ * @param   data - the data to send.
+ * @param   length - the length of data. 0 sends the last chunk, that ends the response.
+ * @retval  returns length, or -1 on error.
+ */
+int http_api_write_chunk(int fdes, const void* data, int length)
+{
+	char size[12];
+	int count;
+
+	if(length < 0)
+		return -1;
+
+	count = snprintf(size, sizeof(size), "%x" HTTP_EOL, length);
+	if(send(fdes, size, count, 0) != count)
+		return -1;
+	if(length > 0 && send(fdes, data, length, 0) != length)
+		return -1;
+	if(send(fdes, HTTP_EOL, sizeof(HTTP_EOL)-1, 0) != sizeof(HTTP_EOL)-1)
+		return -1;
+
+	return length;
+}
 
 /**
  * @}
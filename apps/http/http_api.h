@@ -40,18 +40,76 @@
 #ifndef HTTP_HTTP_API_H_
 #define HTTP_HTTP_API_H_
 
+#include <stdbool.h>
 #include "http_defs.h"
+#include "http_websocket.h"
+
+#define HTTP_API_MAX_PARAMS     4       ///< the maximum number of path parameters in one route
+#define HTTP_API_PARAMS_LEN     64      ///< the space for the values of the path parameters of one request
+#define HTTP_API_PARAM_CHAR     ':'     ///< marks a path segment of an API member name as a parameter
+
+/**
+ * the path parameters of a request, matched by the router.
+ */
+typedef struct {
+	int count;                              ///< the number of parameters matched
+	const char* name[HTTP_API_MAX_PARAMS];  ///< the parameter names, from the member matched
+	const char* value[HTTP_API_MAX_PARAMS]; ///< the parameter values, from the url
+	bool allowed;                           ///< false if the path has a route, but not for the request method
+	char buffer[HTTP_API_PARAMS_LEN];       ///< holds the names and values
+}http_api_params_t;
 
 typedef int(*htp_api_function_t)(int fdes, int content_length, char* buffer, int size);
+typedef int(*htp_api_route_function_t)(int fdes, const http_api_params_t* params, int content_length, char* buffer, int size);
+typedef int(*htp_api_websocket_function_t)(http_websocket_t* websocket, const http_api_params_t* params, char* buffer, int size);
+
+/**
+ * http_api_t flag, set when the member function writes its response with http_api_write_chunk(),
+ * allowing the connection to be kept alive after the response.
+ */
+#define HTTP_API_CHUNKED    0x01
+/**
+ * http_api_t flag, set when the member serves a websocket, with its websocket function.
+ * it is called once the handshake is complete, see http_websocket_handshake(),
+ * and the connection is closed when it returns.
+ */
+#define HTTP_API_WEBSOCKET  0x02
 
+/**
+ * an API member.
+ *
+ * the name is the path of the member, without the leading slash. path segments that begin
+ * with a colon are parameters, that match any one segment of the url, "channel/:id".
+ * a member with a method only serves requests of that method.
+ * the member function is either func, or for members with parameters, route,
+ * or for members flagged with HTTP_API_WEBSOCKET, websocket.
+ */
 typedef struct {
 	const char* name;                       ///< name of the api member
 	const htp_api_function_t func;          ///< member function call
+	const int flags;                        ///< HTTP_API_CHUNKED, or 0
+	const char* method;                     ///< HTTP_GET, HTTP_POST, or NULL for any method
+	const htp_api_route_function_t route;   ///< member function call with path parameters, used instead of func
+	const htp_api_websocket_function_t websocket; ///< member function call for a websocket
 }http_api_t;
 
+typedef struct _http_api_node_t http_api_node_t;
+
+/**
+ * the API members, sorted into a tree of path segments.
+ */
+typedef struct {
+	http_api_node_t* root;
+}http_api_router_t;
+
 const http_api_t* http_api_check(const http_api_t** api, const char* url);
-int http_api_process(const http_api_t* memb, int fdes, int content_length, char* buffer, int size);
+bool http_api_router_init(http_api_router_t* router, const http_api_t** api);
+const http_api_t* http_api_route(const http_api_router_t* router, const char* method, const char* url, http_api_params_t* params);
+const char* http_api_param(const http_api_params_t* params, const char* name);
+int http_api_process(const http_api_t* memb, const http_api_params_t* params, int fdes, int content_length, char* buffer, int size);
+int http_api_websocket(const http_api_t* memb, const http_api_params_t* params, http_websocket_t* websocket, char* buffer, int size);
 int http_api_pull_one_frame(int fdes, const char* buffer, int size);
+int http_api_write_chunk(int fdes, const void* data, int length);
 
 #endif /* HTTP_HTTP_API_H_ */
 
@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+* @addtogroup http
+*
+* @{
+* @file http_cache.c
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "http_defs.h"
+#include "http_cache.h"
+
+#define lock_cache(cache)       (xSemaphoreTake((cache)->lock, HTTP_CACHE_LOCK_TIMEOUT/portTICK_RATE_MS) == pdTRUE)
+#define unlock_cache(cache)     xSemaphoreGive((cache)->lock)
+
+/**
+ * the response header held by a cache entry, formatted with the title, content type,
+ * content length and the gzip fields, followed by the ETag field.
+ */
+#define http_cache_header   http_response_header HTTP_CONTENT_LENGTH "%d" HTTP_EOL http_accept_ranges_field "%s"
+
+/**
+ * initialises a cache of small static files, for the http server.
+ *
+ * each entry holds a file's content, its response header and an ETag, so that
+ * a cached file is served without any filesystem access. the least recently used
+ * entries are removed to make space.
+ *
+ * the filesystem has no modification times, so entries are only refreshed when
+ * invalidated with http_cache_invalidate(), as the server does after a POST to the file.
+ *
+ * the cache also remembers which files have a gzip compressed variant, see http_cache_gzip_lookup().
+ *
+ * @param   cache - the cache to initialise.
+ * @param   size - the memory limit of the cache in bytes. 0 disables the cache.
+ * @param   file_size - the size limit of a cached file in bytes.
+ */
+void http_cache_init(http_cache_t* cache, int size, int file_size)
+{
+    cache->head = NULL;
+    cache->tail = NULL;
+    cache->size = size;
+    cache->file_size = file_size;
+    cache->used = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    memset(cache->gzip, 0, sizeof(cache->gzip));
+    cache->gzip_next = 0;
+    cache->lock = xSemaphoreCreateMutex();
+    if(!cache->lock)
+        cache->size = 0;
+}
+
+/**
+ * FNV-1a hash of length bytes of data. never returns 0.
+ */
+static uint32_t http_cache_hash(const char* data, int length)
+{
+    uint32_t hash = 2166136261u;
+
+    while(length-- > 0)
+    {
+        hash ^= (uint8_t)*data++;
+        hash *= 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+/**
+ * unlinks an entry from the list, freeing it if it is not in use.
+ * must be called with the cache locked.
+ */
+static void http_cache_remove(http_cache_t* cache, http_cache_entry_t* entry)
+{
+    if(entry->prev)
+        entry->prev->next = entry->next;
+    else
+        cache->head = entry->next;
+
+    if(entry->next)
+        entry->next->prev = entry->prev;
+    else
+        cache->tail = entry->prev;
+
+    cache->used -= entry->size;
+
+    if(entry->refs)
+        entry->evicted = true;
+    else
+        free(entry);
+}
+
+/**
+ * finds an entry by the first length characters of url. must be called with the cache locked.
+ */
+static http_cache_entry_t* http_cache_find(http_cache_t* cache, const char* url, int length, bool gzip)
+{
+    http_cache_entry_t* entry;
+
+    for(entry = cache->head; entry; entry = entry->next)
+    {
+        if(entry->gzip == gzip && !strncmp(entry->url, url, length) && entry->url[length] == '\0')
+            break;
+    }
+    return entry;
+}
+
+/**
+ * gets a cached file.
+ *
+ * @param   cache - the cache to look in.
+ * @param   url - the requested url.
+ * @param   gzip - true to get the gzip compressed variant of the file.
+ * @retval  returns the cache entry, which must be released with http_cache_release()
+ *          once the response is sent, or NULL if the url is not cached.
+ */
+http_cache_entry_t* http_cache_get(http_cache_t* cache, const char* url, bool gzip)
+{
+    http_cache_entry_t* entry = NULL;
+
+    if(cache->size > 0 && lock_cache(cache))
+    {
+        entry = http_cache_find(cache, url, strlen(url), gzip);
+        if(entry)
+        {
+            // move to the front of the list
+            if(entry->prev)
+            {
+                entry->prev->next = entry->next;
+                if(entry->next)
+                    entry->next->prev = entry->prev;
+                else
+                    cache->tail = entry->prev;
+                entry->prev = NULL;
+                entry->next = cache->head;
+                cache->head->prev = entry;
+                cache->head = entry;
+            }
+            entry->refs++;
+            cache->hits++;
+        }
+        unlock_cache(cache);
+    }
+
+    return entry;
+}
+
+/**
+ * reads a file into the cache.
+ *
+ * @param   cache - the cache to add to.
+ * @param   url - the requested url.
+ * @param   gzip - true if the file is the gzip compressed variant, sent with Content-Encoding: gzip.
+ * @param   file - the open file, at its start. if the file is not cached its position is left at the start.
+ * @param   length - the size of the file.
+ * @param   content_type - the content type of the file, eg http_header_content_type_html.
+ * @retval  returns the new cache entry, which must be released with http_cache_release()
+ *          once the response is sent, or NULL if the file was not cached.
+ */
+http_cache_entry_t* http_cache_add(http_cache_t* cache, const char* url, bool gzip, FILE* file, int length, const char* content_type)
+{
+    http_cache_entry_t* entry;
+    int url_length = strlen(url) + 1;
+    int header_length;
+    int size;
+
+    if(cache->size <= 0 || length > cache->file_size)
+        return NULL;
+
+    // the header is measured first, and formatted in place once the entry is allocated
+    header_length = snprintf(NULL, 0, http_cache_header, http_200_header_title, content_type, length, gzip ? http_gzip_fields : "");
+    if(header_length < 0)
+        return NULL;
+
+    // the header is followed by the ETag field and its terminator
+    size = sizeof(http_cache_entry_t) + url_length + length + header_length + HTTP_ETAG_LENGTH + 1;
+    if(size > cache->size)
+        return NULL;
+
+    entry = malloc(size);
+    if(!entry)
+        return NULL;
+
+    entry->content = entry->url + url_length;
+    if((int)fread((char*)entry->content, 1, length, file) != length)
+    {
+        // leave the file to be read again by the caller
+        fseek(file, 0, SEEK_SET);
+        free(entry);
+        return NULL;
+    }
+
+    entry->etag = http_cache_hash(entry->content, length);
+
+    memcpy(entry->url, url, url_length);
+    entry->header = entry->content + length;
+    snprintf((char*)entry->header, header_length + 1, http_cache_header, http_200_header_title, content_type, length, gzip ? http_gzip_fields : "");
+    entry->header_length = header_length;
+    entry->header_length += snprintf((char*)entry->header + header_length, HTTP_ETAG_LENGTH + 1, http_etag_field, (unsigned long)entry->etag);
+    entry->content_type = content_type;
+    entry->length = length;
+    entry->size = size;
+    entry->refs = 1;
+    entry->evicted = false;
+    entry->gzip = gzip;
+    entry->prev = NULL;
+
+    if(!lock_cache(cache))
+    {
+        entry->evicted = true;
+        return entry;
+    }
+
+    cache->misses++;
+
+    // another connection may have cached the same url meanwhile
+    entry->next = http_cache_find(cache, url, url_length - 1, gzip);
+    if(entry->next)
+        http_cache_remove(cache, entry->next);
+
+    while(cache->tail && cache->used + size > cache->size)
+        http_cache_remove(cache, cache->tail);
+
+    entry->next = cache->head;
+    if(cache->head)
+        cache->head->prev = entry;
+    else
+        cache->tail = entry;
+    cache->head = entry;
+    cache->used += size;
+
+    unlock_cache(cache);
+
+    return entry;
+}
+
+/**
+ * releases an entry obtained with http_cache_get() or http_cache_add().
+ * waits for the lock without a timeout, since giving up would leave the entry
+ * referenced forever, and an evicted entry would never be freed.
+ */
+void http_cache_release(http_cache_t* cache, http_cache_entry_t* entry)
+{
+    bool evicted = false;
+
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+
+    entry->refs--;
+    evicted = entry->evicted && entry->refs == 0;
+
+    unlock_cache(cache);
+
+    if(evicted)
+        free(entry);
+}
+
+/**
+ * finds the gzip lookup slot of a url. must be called with the cache locked.
+ */
+static http_gzip_lookup_t* http_cache_gzip_find(http_cache_t* cache, uint32_t hash)
+{
+    int i;
+
+    for(i = 0; i < HTTP_CACHE_GZIP_LOOKUPS; i++)
+    {
+        if(cache->gzip[i].hash == hash)
+            return &cache->gzip[i];
+    }
+    return NULL;
+}
+
+/**
+ * removes a url from the cache, to be used when the file is written.
+ * both the plain and gzip compressed variants are removed. if url is that of
+ * a compressed variant, name.gz, the variants of name are removed.
+ */
+void http_cache_invalidate(http_cache_t* cache, const char* url)
+{
+    http_cache_entry_t* entry;
+    http_gzip_lookup_t* lookup;
+    int length = strlen(url);
+
+    if(length > (int)sizeof(http_gz)-1 && !strcmp(url + length - (sizeof(http_gz)-1), http_gz))
+        length -= sizeof(http_gz)-1;
+
+    if(cache->lock && lock_cache(cache))
+    {
+        if((entry = http_cache_find(cache, url, length, false)))
+            http_cache_remove(cache, entry);
+        if((entry = http_cache_find(cache, url, length, true)))
+            http_cache_remove(cache, entry);
+        if((lookup = http_cache_gzip_find(cache, http_cache_hash(url, length))))
+            lookup->hash = 0;
+        unlock_cache(cache);
+    }
+}
+
+/**
+ * looks up whether a file has a gzip compressed variant, name.gz.
+ *
+ * @param   cache - the cache to look in.
+ * @param   url - the requested url.
+ * @retval  returns 1 if the variant exists, 0 if it does not, or -1 if it is not known.
+ *          use http_cache_gzip_store() to remember the result of looking for the file.
+ */
+int http_cache_gzip_lookup(http_cache_t* cache, const char* url)
+{
+    http_gzip_lookup_t* lookup;
+    int exists = -1;
+
+    if(cache->lock && lock_cache(cache))
+    {
+        lookup = http_cache_gzip_find(cache, http_cache_hash(url, strlen(url)));
+        if(lookup)
+            exists = lookup->exists;
+        unlock_cache(cache);
+    }
+
+    return exists;
+}
+
+/**
+ * remembers whether a file has a gzip compressed variant.
+ */
+void http_cache_gzip_store(http_cache_t* cache, const char* url, bool exists)
+{
+    http_gzip_lookup_t* lookup;
+    uint32_t hash = http_cache_hash(url, strlen(url));
+
+    if(cache->lock && lock_cache(cache))
+    {
+        lookup = http_cache_gzip_find(cache, hash);
+        if(!lookup)
+        {
+            lookup = &cache->gzip[cache->gzip_next];
+            cache->gzip_next = (cache->gzip_next + 1) % HTTP_CACHE_GZIP_LOOKUPS;
+        }
+        lookup->hash = hash;
+        lookup->exists = exists;
+        unlock_cache(cache);
+    }
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+* @addtogroup http
+*
+* @{
+* @file http_cache.h
+*/
+
+#ifndef HTTP_HTTP_CACHE_H_
+#define HTTP_HTTP_CACHE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#define HTTP_CACHE_SIZE_CONFIG_KEY          "cache_size"
+#define HTTP_CACHE_FILE_SIZE_CONFIG_KEY     "cache_file_size"
+
+#define HTTP_CACHE_SIZE             8192    ///< default cache memory limit in bytes, 0 disables the cache
+#define HTTP_CACHE_FILE_SIZE        2048    ///< default size limit in bytes of a cached file
+#define HTTP_CACHE_LOCK_TIMEOUT     1000    ///< time in ms to wait for the cache lock
+#define HTTP_CACHE_GZIP_LOOKUPS     16      ///< number of urls for which the existence of a .gz variant is remembered
+
+typedef struct _http_cache_entry_t http_cache_entry_t;
+
+struct _http_cache_entry_t {
+    http_cache_entry_t* prev;       ///< the more recently used entry
+    http_cache_entry_t* next;       ///< the less recently used entry
+    uint32_t etag;                  ///< hash of the content
+    int size;                       ///< memory used by the entry
+    int16_t refs;                   ///< number of connections using the entry
+    bool evicted;                   ///< set when the entry is removed while in use
+    bool gzip;                      ///< set when the content is the gzip compressed variant of the file
+    const char* content_type;       ///< the content type
+    const char* header;             ///< the response header, less the connection field
+    int header_length;              ///< length of the response header
+    const char* content;            ///< the file content
+    int length;                     ///< length of the file content
+    char url[];                     ///< the url the entry is cached for
+};
+
+typedef struct {
+    uint32_t hash;                  ///< hash of the url, 0 where unused
+    bool exists;                    ///< set if a .gz variant of the file exists
+}http_gzip_lookup_t;
+
+typedef struct {
+    http_cache_entry_t* head;       ///< the most recently used entry
+    http_cache_entry_t* tail;       ///< the least recently used entry
+    SemaphoreHandle_t lock;         ///< protects the entry list
+    int size;                       ///< memory limit in bytes
+    int file_size;                  ///< size limit in bytes of a cached file
+    int used;                       ///< memory used in bytes
+    unsigned int hits;              ///< number of requests served from the cache
+    unsigned int misses;            ///< number of cacheable requests read from file
+    http_gzip_lookup_t gzip[HTTP_CACHE_GZIP_LOOKUPS];   ///< results of .gz variant lookups
+    uint8_t gzip_next;              ///< the next gzip lookup to replace
+}http_cache_t;
+
+void http_cache_init(http_cache_t* cache, int size, int file_size);
+http_cache_entry_t* http_cache_get(http_cache_t* cache, const char* url, bool gzip);
+http_cache_entry_t* http_cache_add(http_cache_t* cache, const char* url, bool gzip, FILE* file, int length, const char* content_type);
+void http_cache_release(http_cache_t* cache, http_cache_entry_t* entry);
+void http_cache_invalidate(http_cache_t* cache, const char* url);
+int http_cache_gzip_lookup(http_cache_t* cache, const char* url);
+void http_cache_gzip_store(http_cache_t* cache, const char* url, bool exists);
+
+#endif /* HTTP_HTTP_CACHE_H_ */
+
+/**
+ * @}
+ */
@@ -37,13 +37,16 @@
 * @file http_client.c
 */
 
+#include <ctype.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include "http_client.h"
+#include "http_reader.h"
 #include "sock_utils.h"
 #include "logger.h"
 #include "strutils.h"
@@ -51,7 +54,8 @@
 
 static char* http_split_content(char* response);
 static int http_receive_response(int fd, http_response_t* resp);
-static int pack_header(http_request_t* request);
+static int http_receive_body(int fd, http_response_t* response, int size, http_body_function_t body, void* ctx);
+static int pack_header(http_request_t* request, unsigned long offset);
 static void unpack_url(char* url, http_request_t* request);
 
 const char* http_header_strings[] = HTTP_HEADER_DECODE;
@@ -153,8 +157,6 @@ http_response_t* http_request(http_request_t* request, http_response_t* response
 	{
         fd = sock_connect(request->remote, request->port, SOCK_STREAM, NULL);
 
-        usleep(10000);
-
     	if(fd >= 0)
     	{
         	// make HTTP request
@@ -243,87 +245,111 @@ char* http_split_content(char* response) {
 }
 
 /**
+ * copies a header value to the end of the response buffer, below any values already saved there.
+ * the reader buffer is shrunk so that the value is not overwritten by lines received later.
+ *
+ * @retval  returns a pointer to the saved value, or NULL if there was no space for it.
+ */
+static const char* http_save_value(http_reader_t* reader, char** save, const char* value)
+{
+    int length = strlen(value) + 1;
+
+    if(*save - length <= reader->buffer + reader->end)
+        return NULL;
+
+    *save -= length;
+    memcpy(*save, value, length);
+    reader->size = *save - reader->buffer;
+    return *save;
+}
+
+/**
+ * receives the response header, the body is left on the socket.
  * only decodes fields if found - the response structure should be initialized with default values that make sense.
+ *
+ * @retval  returns the length of the start of the response buffer that is free for the body,
+ *          the header values are saved after it. returns -1 if the header was not received.
  */
 int http_receive_response(int fd, http_response_t* response)
 {
-    // receive header and possibly part of body
-    int resplen = 0;
-    int length = 0;
+    http_reader_t reader;
     int field;
+    char* line;
     char* value;
     char* end;
 
     // use the end of the buffer to save values...
-    char* save = response->buffer + (response->size - 1);
+    char* save = response->buffer + response->size;
+
+    http_reader_init(&reader, fd, response->buffer, response->size);
 
-    while(resplen < response->size-1)
+    response->chunked = false;
+    response->keepalive = false;
+    response->range_first = -1;
+
+    while((line = http_reader_line(&reader)))
     {
-        length = recv(fd, response->buffer + resplen, 1, 0);
+        // EOH
+        if(!*line)
+            return save - response->buffer;
 
-        if(length != 1)
-            return -1;
+        value = strchr(line, HTTP_COLON_CHAR);
 
-        if(response->buffer[resplen] != '\n')
-            resplen++;
-        else
+        if(value)
         {
-            // EOH
-            if(resplen == 1)
-                return 0;
-
-            // terminate line at '\r'
-            response->buffer[resplen-1] = '\0';
-            resplen = 0;
+            *value = '\0';
+            value++;
+            while(*value == HTTP_SPACE_CHAR)
+                value++;
 
-            value = strchr(response->buffer, HTTP_COLON_CHAR);
+            // check for known header field
+            field = string_in_list(line, strlen(line), http_header_strings);
 
-            if(value)
+            switch(field)
             {
-                *value = '\0';
-                value += 2;
-
-                // check for known header field
-                field = string_in_list(response->buffer, strlen(response->buffer), http_header_strings);
-
-                switch(field)
-                {
-                    case HTTP_HEADER_FIELD_HOST:
-                        save -= strlen(value);
-                        strcpy(save, value);
-                        response->host = save;
-                        save--;
-                    break;
-                    case HTTP_HEADER_FIELD_SERVER:
-                        save -= strlen(value);
-                        strcpy(save, value);
-                        response->server = save;
-                        save--;
-                    break;
-                    case HTTP_HEADER_FIELD_CONTENT_LENGTH:
-                        response->content_length = atoi(value);
-                    break;
-                    case HTTP_HEADER_FIELD_CONTENT_TYPE:
-                        response->content_type = string_in_list(value, strlen(value), http_content_strings);
-                    break;
-                }
+                case HTTP_HEADER_FIELD_HOST:
+                    response->host = http_save_value(&reader, &save, value);
+                break;
+                case HTTP_HEADER_FIELD_SERVER:
+                    response->server = http_save_value(&reader, &save, value);
+                break;
+                case HTTP_HEADER_FIELD_CONTENT_LENGTH:
+                    response->content_length = atoi(value);
+                break;
+                case HTTP_HEADER_FIELD_CONTENT_TYPE:
+                    response->content_type = string_in_list(value, strlen(value), http_content_strings);
+                break;
+                case HTTP_HEADER_FIELD_TRANSFER_ENCODING:
+                    response->chunked = strstr(value, HTTP_CHUNKED) != NULL;
+                break;
+                case HTTP_HEADER_FIELD_CONNECTION:
+                    value = strtolower(value);
+                    if(strstr(value, HTTP_CLOSE))
+                        response->keepalive = false;
+                    else if(strstr(value, HTTP_KEEP_ALIVE))
+                        response->keepalive = true;
+                break;
+                case HTTP_HEADER_FIELD_CONTENT_RANGE:
+                    // "bytes first-last/size", or "bytes */size" when the range was not satisfied
+                    if(!strncmp(value, HTTP_BYTES " ", sizeof(HTTP_BYTES)) && isdigit((int)value[sizeof(HTTP_BYTES)]))
+                        response->range_first = strtol(value + sizeof(HTTP_BYTES), NULL, 10);
+                break;
             }
-            else
+        }
+        else
+        {
+            value = strchr(line, HTTP_SPACE_CHAR);
+            end = value ? strchr(++value, HTTP_SPACE_CHAR) : NULL;
+            if(end)
             {
-                value = strchr(response->buffer, HTTP_SPACE_CHAR);
-                value++;
-                end = strchr(value, HTTP_SPACE_CHAR);
+                // HTTP/1.1 connections are persistent by default
+                response->keepalive = !strncmp(line, HTTP_VERS_1_1, sizeof(HTTP_VERS_1_1)-1);
+                *end = '\0';
+                end++;
+                response->status = atoi(value);
+                end = (char*)http_save_value(&reader, &save, end);
                 if(end)
-                {
-                    *end = '\0';
-                    end++;
-                    response->status = atoi(value);
-
-                    save -= strlen(end);
-                    strcpy(save, (const char*)end);
-                    response->message = save;
-                    save--;
-                }
+                    response->message = end;
             }
         }
     }
@@ -331,11 +357,369 @@ int http_receive_response(int fd, http_response_t* response)
     return -1;
 }
 
-int pack_header(http_request_t* request)
+/**
+ * receives one line of a chunked body, the chunk size or the end of a chunk.
+ * data is peeked first, so that nothing after the line is consumed.
+ *
+ * @retval  returns the length of the line, which is cut short to fit size, or -1 if the connection failed.
+ */
+static int http_receive_line(int fd, char* line, int size)
 {
-    return snprintf(request->buffer, request->size - 1, HTTP_HEADER,
+    char data[32];
+    int length = 0;
+    int count;
+    int received;
+    int i;
+
+    while(1)
+    {
+        count = recv(fd, data, sizeof(data), MSG_PEEK);
+        if(count <= 0)
+            return -1;
+
+        for(i = 0; i < count && data[i] != HTTP_EOL_CHAR; i++);
+        if(i < count)
+            i++;
+
+        for(count = 0; count < i; count += received)
+        {
+            received = recv(fd, data + count, i - count, 0);
+            if(received <= 0)
+                return -1;
+        }
+
+        for(count = 0; count < i; count++)
+        {
+            if(data[count] == HTTP_EOL_CHAR)
+            {
+                line[length] = '\0';
+                return length;
+            }
+            if(data[count] != HTTP_CR_CHAR && length < size - 1)
+                line[length++] = data[count];
+        }
+    }
+}
+
+/**
+ * receives length bytes of body, or to the end of the connection if length is -1.
+ * the body is passed to the body function, or saved in the response buffer without one.
+ *
+ * @retval  returns the number of bytes saved in the response buffer, or -1 if the connection
+ *          failed or the body function aborted.
+ */
+static int http_receive_data(int fd, http_response_t* response, int size, int saved, int length, http_body_function_t body, void* ctx)
+{
+    char discard[32];
+    char* data;
+    int space;
+    int received;
+
+    while(length != 0)
+    {
+        // pass the body on in pieces, or save what fits and drop the rest
+        if(body)
+        {
+            data = response->buffer;
+            space = size;
+        }
+        else if(saved < size - 1)
+        {
+            data = response->buffer + saved;
+            space = size - 1 - saved;
+        }
+        else
+        {
+            data = discard;
+            space = sizeof(discard);
+        }
+        if(length > 0 && length < space)
+            space = length;
+
+        received = recv(fd, data, space, 0);
+        if(received <= 0)
+            return length < 0 ? saved : -1;
+
+        if(length > 0)
+            length -= received;
+        if(body && body(ctx, data, received) < 0)
+            return -1;
+        if(!body && data != discard)
+            saved += received;
+    }
+
+    return saved;
+}
+
+/**
+ * receives the response body, that follows a header received by http_receive_response().
+ *
+ * the body may have a Content-Length, be chunked, or end when the connection closes.
+ *
+ * @param   size is the length of the start of the response buffer free for the body.
+ * @param   body is a function to pass the body to, or NULL to save it in the response buffer,
+ *          as much as will fit, pointed to by response->body.
+ * @retval  returns 0 if the whole body was received, and the connection may be used again
+ *          if response->keepalive is set. returns -1 if the connection failed or the body function aborted.
+ */
+int http_receive_body(int fd, http_response_t* response, int size, http_body_function_t body, void* ctx)
+{
+    char line[16];
+    int saved = 0;
+    int length;
+
+    response->body = NULL;
+    if(size < 2)
+        return -1;
+
+    if(response->chunked)
+    {
+        while(saved >= 0)
+        {
+            if(http_receive_line(fd, line, sizeof(line)) < 0)
+                return -1;
+            length = strtol(line, NULL, 16);
+            if(length <= 0)
+                break;
+            saved = http_receive_data(fd, response, size, saved, length, body, ctx);
+            // the end of the chunk
+            if(saved >= 0 && http_receive_line(fd, line, sizeof(line)) < 0)
+                return -1;
+        }
+        // the trailer ends with an empty line
+        while(saved >= 0 && (length = http_receive_line(fd, line, sizeof(line))) > 0);
+        if(length < 0)
+            return -1;
+    }
+    else
+    {
+        // without a Content-Length the body ends when the connection closes
+        if(response->content_length < 0)
+            response->keepalive = false;
+        saved = http_receive_data(fd, response, size, saved, response->content_length, body, ctx);
+    }
+
+    if(saved < 0)
+        return -1;
+
+    if(!body)
+    {
+        response->buffer[saved] = '\0';
+        response->body = response->buffer;
+    }
+
+    return 0;
+}
+
+/**
+ * a body function that writes the body to a file descriptor.
+ *
+ * @param   ctx - a pointer to the file descriptor, an int.
+ */
+int http_body_to_fdes(void* ctx, const char* data, int length)
+{
+    return write(*(int*)ctx, data, length) == length ? length : -1;
+}
+
+/**
+ * initialises a client that keeps connections open between requests.
+ */
+void http_client_init(http_client_t* client)
+{
+    int i;
+
+    client->requests = 0;
+    for(i = 0; i < HTTP_CLIENT_CONNS; i++)
+    {
+        client->conns[i].remote[0] = '\0';
+        client->conns[i].fdes = -1;
+        client->conns[i].used = 0;
+    }
+}
+
+/**
+ * closes all the connections of a client.
+ */
+void http_client_close(http_client_t* client)
+{
+    int i;
+
+    for(i = 0; i < HTTP_CLIENT_CONNS; i++)
+    {
+        if(client->conns[i].fdes != -1)
+            closesocket(client->conns[i].fdes);
+        client->conns[i].fdes = -1;
+    }
+}
+
+/**
+ * @retval  returns the open connection to the remote host, or the connection to use for it,
+ *          the free or least recently used one.
+ */
+static http_client_conn_t* http_client_conn(http_client_t* client, const char* remote, int port)
+{
+    http_client_conn_t* conn = &client->conns[0];
+    int i;
+
+    for(i = 0; i < HTTP_CLIENT_CONNS; i++)
+    {
+        if(client->conns[i].fdes != -1 && client->conns[i].port == port && !strcmp(client->conns[i].remote, remote))
+            return &client->conns[i];
+        if(client->conns[i].fdes == -1 ? conn->fdes != -1 : (conn->fdes != -1 && client->conns[i].used < conn->used))
+            conn = &client->conns[i];
+    }
+
+    if(conn->fdes != -1)
+        closesocket(conn->fdes);
+    conn->fdes = -1;
+    strncpy(conn->remote, remote, sizeof(conn->remote)-1);
+    conn->remote[sizeof(conn->remote)-1] = '\0';
+    conn->port = port;
+
+    return conn;
+}
+
+/**
+ * sends a HTTP/1.1 request on a persistent connection, and receives the response.
+ *
+ * the connection to each remote host is kept open for the next request, as long as the server
+ * allows it. a connection the server has closed since the last request is opened again.
+ * the response body is received as it arrives, by the body function, or into the response buffer.
+ *
+\code
+
+http_client_t client;
+http_request_t request;
+http_response_t response;
+char buffer[256];
+int fdes;
+
+http_client_init(&client);
+
+// the request is configured as for http_request()
+request.remote = "remote-hostname";
+request.port = 80;
+request.page = "/api/telemetry";
+request.type = HTTP_POST;
+request.content_type = HTTP_CONTENT_FIELD_JSON;
+request.buffer = telemetry;
+request.content_length = strlen(telemetry);
+
+response.buffer = buffer;
+response.size = sizeof(buffer);
+
+// each post after the first reuses the connection
+while(1)
+{
+    if(http_client_request(&client, &request, &response, NULL, NULL))
+        printf("%d %s\n", response.status, response.body);
+    sleep(1);
+}
+
+// stream a large body to a file
+request.page = "/logs/today.csv";
+request.type = HTTP_GET;
+request.content_length = 0;
+fdes = open("/today.csv", O_WRONLY | O_CREAT | O_TRUNC);
+http_client_request(&client, &request, &response, http_body_to_fdes, &fdes);
+close(fdes);
+
+\endcode
+ *
+ * @param   client - the client, initialised by http_client_init().
+ * @param   request - the request, the local field is not used.
+ * @param   response - the response, the buffer holds the header, and the body if there is no body function.
+ * @param   body - a function to pass the body to as it is received, or NULL.
+ * @param   ctx - a pointer passed to the body function.
+ * @retval  returns the response, or NULL if the request failed.
+ */
+http_response_t* http_client_request(http_client_t* client, http_request_t* request, http_response_t* response, http_body_function_t body, void* ctx)
+{
+    http_client_conn_t* conn = http_client_conn(client, request->remote, request->port);
+    bool reused;
+    int length;
+    int size = -1;
+    int attempt;
+
+    // a reused connection may have been closed by the server since, then a new one is tried
+    for(attempt = 0; attempt < 2 && size < 0; attempt++)
+    {
+        reused = conn->fdes != -1;
+        if(!reused)
+        {
+            conn->fdes = sock_connect(request->remote, request->port, SOCK_STREAM, NULL);
+            if(conn->fdes == -1)
+                return NULL;
+        }
+
+        // the response buffer is free to format the header in, until the response arrives
+        length = snprintf(response->buffer, response->size, HTTP_HEADER_KEEP_ALIVE, request->type, request->page,
+                request->remote, request->content_length, http_content_strings[request->content_type]);
+
+        if(length < response->size &&
+           send(conn->fdes, response->buffer, length, 0) == length &&
+           (request->content_length <= 0 || send(conn->fdes, request->buffer, request->content_length, 0) == request->content_length))
+        {
+            response->content_length = -1;
+            size = http_receive_response(conn->fdes, response);
+        }
+
+        if(size < 0)
+        {
+            closesocket(conn->fdes);
+            conn->fdes = -1;
+            if(!reused)
+                return NULL;
+        }
+    }
+
+    if(size < 0)
+        return NULL;
+
+    conn->used = ++client->requests;
+
+    // no body in these responses
+    if(!strcmp(request->type, HTTP_HEAD) || response->status == 204 || response->status == 304 || response->status / 100 == 1)
+    {
+        response->content_length = 0;
+        response->chunked = false;
+    }
+
+    if(http_receive_body(conn->fdes, response, size, body, ctx) < 0)
+    {
+        closesocket(conn->fdes);
+        conn->fdes = -1;
+        return NULL;
+    }
+
+    if(!response->keepalive)
+    {
+        closesocket(conn->fdes);
+        conn->fdes = -1;
+    }
+
+    return response;
+}
+
+/**
+ * formats the request header into the request buffer.
+ *
+ * @param   offset - when not 0, a Range field asks for the content from this offset on.
+ * @retval  returns the length of the header, request->size or more if it did not fit.
+ */
+int pack_header(http_request_t* request, unsigned long offset)
+{
+    int length = snprintf(request->buffer, request->size - 1, HTTP_HEADER_FIELDS,
             request->type, request->page, request->local,
             request->content_length, http_content_strings[request->content_type]);
+
+    if(offset && length < request->size - 1)
+        length += snprintf(request->buffer + length, request->size - 1 - length, HTTP_RANGE_FROM, offset);
+
+    if(length < request->size - 1)
+        length += snprintf(request->buffer + length, request->size - 1 - length, HTTP_EOL);
+
+    return length;
 }
 
 /**
@@ -411,12 +795,16 @@ char url[] = "http://abc.com:80/index.html";
 char* output = "/tmp/index.html"
 mkdir("/tmp");
 
-if(http_get_file(url, &response, output, buffer, sizeof(buffer)))
+if(http_get_file(url, &response, output, buffer, sizeof(buffer), false))
 {
 
 }
 
 \endcode
+ *
+ * with resume set, an existing output file is taken to be the start of the url content,
+ * and only the rest is requested. if the server does not support range requests, the
+ * whole file is received again. a 416 status means the file was already complete.
  *
  * @param   url - the full URL to get eg http://host:port/path/to/file.html
  * @param   response - a pointer to an http response object.
@@ -425,11 +813,14 @@ if(http_get_file(url, &response, output, buffer, sizeof(buffer)))
  * @param   buffer - working area, used to store received header, response string
  *              fields will end up pointing to parts of this memory.
  * @param   size - the length of the buffer in bytes.
+ * @param   resume - set to continue a partial download into output.
  */
-http_response_t* http_get_file(char* url, http_response_t* response, const char* output, char* buffer, int size)
+http_response_t* http_get_file(char* url, http_response_t* response, const char* output, char* buffer, int size, bool resume)
 {
     http_response_t* resp = NULL;
     logger_t log;
+    struct stat st;
+    unsigned long offset = 0;
     int fd;
     int outfd;
     int length;
@@ -455,7 +846,10 @@ http_response_t* http_get_file(char* url, http_response_t* response, const char*
     response->size = size;
 	response->message = response->buffer;
 
-    outfd = open(output, O_WRONLY | O_TRUNC | O_CREAT);
+    if(resume && stat(output, &st) == 0)
+        offset = st.st_size;
+
+    outfd = open(output, offset ? O_WRONLY | O_CREAT : O_WRONLY | O_TRUNC | O_CREAT);
 
     if(outfd == -1)
     {
@@ -497,7 +891,7 @@ http_response_t* http_get_file(char* url, http_response_t* response, const char*
     }
 
     // make HTTP request
-    length = pack_header(&request);
+    length = pack_header(&request, offset);
 
     // send HTTP header
     if(length >= request.size)
@@ -519,8 +913,10 @@ http_response_t* http_get_file(char* url, http_response_t* response, const char*
         return NULL;
     }
 
-    // receive response
-    if(http_receive_response(fd, response) == 0)
+    // receive response, without a Content-Length the body ends when the connection closes
+    response->content_length = -1;
+    length = http_receive_response(fd, response);
+    if(length >= 0)
     {
         log_debug(&log, HTTP_SERVER"%s", response->server);
         log_debug(&log, HTTP_HOST"%s", response->host);
@@ -529,17 +925,40 @@ http_response_t* http_get_file(char* url, http_response_t* response, const char*
         log_debug(&log, HTTP_CONTENT_LENGTH"%d", response->content_length);
         log_debug(&log, HTTP_CONTENT_TYPE"%s", http_content_strings[response->content_type]);
 
-        // receive the body
-        for(length = 0; length < response->content_length;)
+        if(offset)
         {
-            transfer = recv(fd, buffer, size, 0);
-            if(transfer <= 0)
-                break;
-            length += transfer;
-            write(outfd, buffer, transfer);
+            // the rest of the file follows on from what was already received
+            if(response->status == 206 && response->range_first == (long)offset)
+                lseek(outfd, offset, SEEK_SET);
+            // any other part would be appended in the wrong place
+            else if(response->status == 206)
+            {
+                snprintf(response->buffer, response->size, "resume from %lub, got range from %ldb", offset, response->range_first);
+                log_error(&log, response->buffer);
+                closesocket(fd);
+                close(outfd);
+                return NULL;
+            }
+            // the server sent the whole file
+            else if(response->status == 200)
+            {
+                close(outfd);
+                outfd = open(output, O_WRONLY | O_TRUNC | O_CREAT);
+            }
+            // dont write an error page over the partial file
+            else
+            {
+                response->content_length = 0;
+                response->chunked = false;
+            }
+            log_info(&log, "resume from %lub, status %d", offset, response->status);
         }
 
-        resp = response;
+        // receive the body into the file, the start of the buffer is free while the header values are kept
+        if(http_receive_body(fd, response, length, http_body_to_fdes, &outfd) == 0)
+            resp = response;
+        else
+            log_error(&log, "failed to receive %s", output);
     }
 
     closesocket(fd);
@@ -40,9 +40,12 @@
 #ifndef HTTP_HTTP_CLIENT_H_
 #define HTTP_HTTP_CLIENT_H_
 
+#include <stdbool.h>
 #include "http_defs.h"
 
 #define HTTP_MAX_HEADER_LENGTH    256
+#define HTTP_CLIENT_CONNS         2       ///< the number of persistent connections held by a client
+#define HTTP_CLIENT_REMOTE_LEN    32      ///< the longest remote hostname of a persistent connection
 
 typedef struct {
     const char* remote;         ///< set the remote IP address or hostname
@@ -65,12 +68,47 @@ typedef struct {
     const char* server;           ///< not set by the user - holds the "Server" header field, of the response
     int content_type;           ///< not set by the user - holds the "Content-Type" header field, of the response
     int content_length;         ///< not set by the user - holds the "Content-Length" header field, of the response
+    bool chunked;               ///< not set by the user - set if the response body has chunked transfer encoding
+    long range_first;           ///< not set by the user - holds the first byte of the "Content-Range" header field, or -1
+    bool keepalive;             ///< not set by the user - set if the server keeps the connection open after the response
     char* buffer;               ///< set the buffer that will hold the response body data
     int size;                   ///< set to the the size of the buffer in bytes.
 }http_response_t;
 
+/**
+ * receives a piece of a response body, see http_client_request().
+ *
+ * @param   ctx is the pointer given to http_client_request().
+ * @retval  returns length, or -1 to abort the response.
+ */
+typedef int(*http_body_function_t)(void* ctx, const char* data, int length);
+
+/**
+ * a connection to a remote host, kept open between requests.
+ */
+typedef struct {
+    char remote[HTTP_CLIENT_REMOTE_LEN];    ///< the remote IP address or hostname
+    int port;                               ///< the remote port
+    int fdes;                               ///< the connection socket, or -1 when not connected
+    unsigned long used;                     ///< when the connection was last used, for reuse of the oldest
+}http_client_conn_t;
+
+/**
+ * a HTTP client that keeps connections open between requests, see http_client_request().
+ * it is not thread safe, each task should have its own.
+ */
+typedef struct {
+    http_client_conn_t conns[HTTP_CLIENT_CONNS];
+    unsigned long requests;                 ///< the number of requests made
+}http_client_t;
+
 http_response_t* http_request(http_request_t* request, http_response_t* response);
-http_response_t* http_get_file(char* url, http_response_t* response, const char* output, char* buffer, int size);
+http_response_t* http_get_file(char* url, http_response_t* response, const char* output, char* buffer, int size, bool resume);
+
+void http_client_init(http_client_t* client);
+http_response_t* http_client_request(http_client_t* client, http_request_t* request, http_response_t* response, http_body_function_t body, void* ctx);
+void http_client_close(http_client_t* client);
+int http_body_to_fdes(void* ctx, const char* data, int length);
 
 #endif /* HTTP_HTTP_CLIENT_H_ */
 
@@ -45,12 +45,38 @@ enum {
     HTTP_HEADER_FIELD_SERVER = 1,
     HTTP_HEADER_FIELD_CONTENT_LENGTH = 2,
     HTTP_HEADER_FIELD_CONTENT_TYPE = 3,
+    HTTP_HEADER_FIELD_TRANSFER_ENCODING = 4,
+    HTTP_HEADER_FIELD_CONNECTION = 5,
+    HTTP_HEADER_FIELD_CONTENT_RANGE = 6,
 };
 
 #define HTTP_HOST				"Host: "
 #define HTTP_SERVER             "Server: "
 #define HTTP_CONTENT_LENGTH		"Content-Length: "
 #define HTTP_CONTENT_TYPE		"Content-Type: "
+#define HTTP_CONNECTION         "Connection: "
+#define HTTP_TRANSFER_ENCODING  "Transfer-Encoding: "
+#define HTTP_ETAG               "ETag: "
+#define HTTP_IF_NONE_MATCH      "If-None-Match: "
+#define HTTP_ACCEPT_ENCODING    "Accept-Encoding: "
+#define HTTP_CONTENT_ENCODING   "Content-Encoding: "
+#define HTTP_VARY               "Vary: "
+#define HTTP_GZIP               "gzip"
+#define HTTP_RANGE              "Range: "
+#define HTTP_CONTENT_RANGE      "Content-Range: "
+#define HTTP_ACCEPT_RANGES      "Accept-Ranges: "
+#define HTTP_BYTES              "bytes"
+#define HTTP_CONTENT_CRC32      "X-Content-CRC32: "
+#define HTTP_UPGRADE            "Upgrade: "
+#define HTTP_WEBSOCKET          "websocket"
+#define HTTP_SEC_WEBSOCKET_KEY      "Sec-WebSocket-Key: "
+#define HTTP_SEC_WEBSOCKET_ACCEPT   "Sec-WebSocket-Accept: "
+#define HTTP_SEC_WEBSOCKET_VERSION  "Sec-WebSocket-Version: "
+#define HTTP_UPGRADE_TOKEN          "upgrade"
+
+#define HTTP_KEEP_ALIVE         "keep-alive"
+#define HTTP_CLOSE              "close"
+#define HTTP_CHUNKED            "chunked"
 
 #define HTTP_HEADER_DECODE \
 { \
@@ -58,6 +84,9 @@ enum {
     "Server",  \
     "Content-Length",  \
     "Content-Type",  \
+    "Transfer-Encoding",  \
+    "Connection",  \
+    "Content-Range",  \
     NULL \
 }
 
@@ -95,10 +124,22 @@ enum {
 
 #define HTTP_GET				"GET"
 #define HTTP_POST				"POST"
+#define HTTP_HEAD				"HEAD"
 #define HTTP_VERS				"HTTP/1.0"
+#define HTTP_VERS_1_1			"HTTP/1.1"
 #define HTTP_EOL				"\r\n"
 #define HTTP_EOH				HTTP_EOL HTTP_EOL
-#define HTTP_HEADER				"%s %s " HTTP_VERS HTTP_EOL HTTP_HOST "%s" HTTP_EOL HTTP_CONTENT_LENGTH "%d" HTTP_EOL HTTP_CONTENT_TYPE "%s" HTTP_EOH
+#define HTTP_HEADER_FIELDS		"%s %s " HTTP_VERS HTTP_EOL HTTP_HOST "%s" HTTP_EOL HTTP_CONTENT_LENGTH "%d" HTTP_EOL HTTP_CONTENT_TYPE "%s" HTTP_EOL
+#define HTTP_HEADER				HTTP_HEADER_FIELDS HTTP_EOL
+/**
+ * request header for a persistent connection, formatted as HTTP_HEADER, with the remote host.
+ */
+#define HTTP_HEADER_KEEP_ALIVE	"%s %s " HTTP_VERS_1_1 HTTP_EOL HTTP_HOST "%s" HTTP_EOL HTTP_CONTENT_LENGTH "%d" HTTP_EOL \
+								HTTP_CONTENT_TYPE "%s" HTTP_EOL HTTP_CONNECTION HTTP_KEEP_ALIVE HTTP_EOH
+/**
+ * request header field asking for the content from an offset to the end.
+ */
+#define HTTP_RANGE_FROM			HTTP_RANGE HTTP_BYTES "=%lu-" HTTP_EOL
 #define HTTP_SCHEMA				"http://"
 #define HTTP_BASE_PAGE          "/"
 
@@ -131,16 +172,68 @@ enum {
 #define http_cgi  ".cgi"
 #define http_json  ".json"
 #define http_xml  ".xml"
+#define http_js  ".js"
+#define http_gz  ".gz"
+
+/**
+ * server response header, formatted with the status title and the content type.
+ * the content length or transfer encoding field may follow, and http_response_connection must end it.
+ */
+#define http_response_header  HTTP_VERS_1_1 " %s" HTTP_EOL HTTP_SERVER "nutensils/FreeRTOS" HTTP_EOL HTTP_CONTENT_TYPE "%s" HTTP_EOL
+/**
+ * the last server response header field, formatted with HTTP_KEEP_ALIVE or HTTP_CLOSE.
+ */
+#define http_response_connection  HTTP_CONNECTION "%s" HTTP_EOH
+/**
+ * entity tag response header field, formatted with a 32 bit hash of the content.
+ */
+#define http_etag_field  HTTP_ETAG "\"%08lx\"" HTTP_EOL
+#define HTTP_ETAG_LENGTH  (sizeof(HTTP_ETAG)-1 + 12)
+/**
+ * response header field sent with files that have a gzip compressed variant.
+ */
+#define http_vary_field  HTTP_VARY "Accept-Encoding" HTTP_EOL
+/**
+ * response header fields sent with the gzip compressed variant of a file.
+ */
+#define http_gzip_fields  HTTP_CONTENT_ENCODING HTTP_GZIP HTTP_EOL http_vary_field
+/**
+ * response header field sent with files, which may be requested in parts.
+ */
+#define http_accept_ranges_field  HTTP_ACCEPT_RANGES HTTP_BYTES HTTP_EOL
+/**
+ * partial content response header field, formatted with the first and last byte sent, and the file size.
+ */
+#define http_content_range_field  HTTP_CONTENT_RANGE HTTP_BYTES " %lu-%lu/%lu" HTTP_EOL
+/**
+ * response header field sent with 416, formatted with the size of the content.
+ */
+#define http_unsatisfied_range_field  HTTP_CONTENT_RANGE HTTP_BYTES " */%lu" HTTP_EOL
 
-#define http_header1  HTTP_VERS " "
-#define http_header2  HTTP_EOL "Server: nutensils/FreeRTOS" HTTP_EOL "Connection: close" HTTP_EOL HTTP_CONTENT_TYPE
+/**
+ * websocket handshake response, formatted with the Sec-WebSocket-Accept value.
+ */
+#define http_websocket_response  HTTP_VERS_1_1 " " http_101_header_title HTTP_EOL HTTP_UPGRADE HTTP_WEBSOCKET HTTP_EOL \
+                                 HTTP_CONNECTION "Upgrade" HTTP_EOL HTTP_SEC_WEBSOCKET_ACCEPT "%s" HTTP_EOH
+/**
+ * response header field sent with 426, formatted with the websocket version supported.
+ */
+#define http_websocket_version_field  HTTP_SEC_WEBSOCKET_VERSION "%d" HTTP_EOL
 
+#define http_101_header_title  "101 Switching Protocols"
 #define http_200_header_title  "200 OK"
 #define http_201_header_title  "201 Created"
 #define http_202_header_title  "202 Accepted"
+#define http_206_header_title  "206 Partial Content"
+#define http_304_header_title  "304 Not Modified"
+#define http_400_header_title  "400 Bad Request"
 #define http_404_header_title  "404 Not found"
+#define http_405_header_title  "405 Method Not Allowed"
 #define http_408_header_title  "408 Request Timeout"
+#define http_411_header_title  "411 Length Required"
+#define http_416_header_title  "416 Range Not Satisfiable"
 #define http_423_header_title  "423 Locked"
+#define http_426_header_title  "426 Upgrade Required"
 #define http_500_header_title  "500 Internal Server Error"
 #define http_501_header_title  "501 Not Implemented"
 
@@ -154,6 +247,7 @@ enum {
 #define http_header_content_type_binary  "application/octet-stream"
 #define http_header_content_type_xml  "application/xml"
 #define http_header_content_type_json  "application/json"
+#define http_header_content_type_javascript  "application/javascript"
 
 #define text_page_header \
 "<!DOCTYPE html>\
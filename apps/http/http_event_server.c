@@ -0,0 +1,534 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+* @addtogroup http
+*
+* @{
+* @file http_event_server.c
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "logger.h"
+#include "http_event_server.h"
+
+static void http_event_server_task(void* parameters);
+static void http_event_accept(http_event_server_t* server);
+static void http_event_close(http_event_server_t* server, http_event_conn_t* conn);
+static void http_event_receive_header(http_event_server_t* server, http_event_conn_t* conn);
+static void http_event_receive_body(http_event_server_t* server, http_event_conn_t* conn);
+static void http_event_send(http_event_server_t* server, http_event_conn_t* conn);
+static void http_event_request(http_event_server_t* server, http_event_conn_t* conn);
+static void http_event_api(http_event_server_t* server, http_event_conn_t* conn);
+static void http_event_error(http_event_conn_t* conn);
+static bool http_event_header(http_event_conn_t* conn, int size, const char* field, uint32_t value);
+static void http_event_done(http_event_server_t* server, http_event_conn_t* conn);
+static void http_event_blocking(int fdes, bool blocking);
+
+/*
+ * the request type and header title strings are set in http_server.c, and are compared
+ * by content here, as a string constant may have a different address in each module.
+ */
+
+/**
+ * adds a piece of the response to send, empty pieces are skipped.
+ */
+#define http_event_segment(conn, d, l)  do { \
+    if((l) > 0) { \
+        (conn)->segment_list[(conn)->segments].data = (d); \
+        (conn)->segment_list[(conn)->segments].length = (l); \
+        (conn)->segments++; \
+    } \
+}while(0)
+
+/**
+ * @brief   An event driven HTTP server, serving all connections from a single task.
+ *
+ * it serves the same files and API calls as the threaded server started by init_http_server(),
+ * from the same config file. the sockets are non-blocking, and each connection is a small state
+ * machine, stepped by poll() events. rather than a task and stack per connection, one context
+ * per connection is allocated up front, "conns" of them.
+ *
+ * a connection costs sizeof(http_event_conn_t) plus a struct pollfd, around 0.7KB. in threaded
+ * mode a connection costs a task stack of HTTP_SERVER_STACK_SIZE words, a task control block
+ * and a http_server_conn_t, around 1.9KB.
+ *
+ * API calls are written to be blocking, and are run with the socket switched to blocking mode,
+ * so the other connections wait while an API call is processed.
+ *
+ * @param   server is the server to start, it must not go out of scope.
+ * @param   configfile is the path to the config file.
+ * @param   api is a NULL terminated list of API calls, or NULL.
+ * @retval  returns the listening socket, or -1 on error.
+ */
+int init_http_event_server(http_event_server_t* server, char* configfile, const http_api_t** api)
+{
+    config_store_t store;
+    sock_server_t* servinfo = &server->http.server;
+
+    // parse the config file once, for both the http and server settings
+    config_store_load(&store, configfile);
+    http_server_configure(&server->http, &store, api);
+    config_store_free(&store);
+
+    if(!servinfo->conns || !servinfo->port)
+    {
+        log_error(&servinfo->log, "port and/or conns settings invalid, %d and %d", servinfo->port, servinfo->conns);
+        return -1;
+    }
+
+    server->fds = malloc((servinfo->conns + 1) * sizeof(struct pollfd));
+    if(!server->fds || !sock_pool_init(&server->http.conn_pool, sizeof(http_event_conn_t), servinfo->conns))
+    {
+        log_error(&servinfo->log, "failed to allocate %d connections", servinfo->conns);
+        free(server->fds);
+        return -1;
+    }
+
+    // the pool is zeroed, so every context starts out HTTP_EVENT_FREE
+    server->conns = (http_event_conn_t*)server->http.conn_pool.objects;
+
+    log_info(&servinfo->log, "%d connections, %d bytes each",
+            servinfo->conns, (int)(sizeof(http_event_conn_t) + sizeof(struct pollfd)));
+
+    // only creates the listener, the connections are accepted by the event task
+    if(sock_server(servinfo->port, SOCK_STREAM, servinfo->conns, servinfo, NULL, NULL, server,
+            servinfo->name, servinfo->stacksize, servinfo->prio) == -1)
+        return -1;
+
+    http_event_blocking(servinfo->listenfd, false);
+
+    if(xTaskCreate(http_event_server_task, servinfo->name, servinfo->stacksize, server, servinfo->prio, NULL) != pdPASS)
+    {
+        log_error(&servinfo->log, "error staring server task");
+        sock_server_kill(servinfo);
+        return -1;
+    }
+
+    return servinfo->listenfd;
+}
+
+/**
+ * @brief   switches a socket between blocking and non-blocking mode.
+ * in blocking mode, receive times out after HTTP_REQUEST_TIMEOUT.
+ */
+void http_event_blocking(int fdes, bool blocking)
+{
+    struct timeval tv;
+    int nonblocking = blocking ? 0 : 1;
+
+    ioctlsocket(fdes, FIONBIO, &nonblocking);
+
+    tv.tv_sec = blocking ? HTTP_REQUEST_TIMEOUT : 0; // take care, lwip sets s as ms
+    tv.tv_usec = 0;
+    setsockopt(fdes, SOL_SOCKET, SO_RCVTIMEO, (char*)&tv, sizeof(struct timeval));
+}
+
+/**
+ * @brief   the event task, waits for socket events and steps the connection state machines.
+ */
+void http_event_server_task(void* parameters)
+{
+    http_event_server_t* server = (http_event_server_t*)parameters;
+    sock_server_t* servinfo = &server->http.server;
+    http_event_conn_t* conn;
+    int i;
+
+    while(1)
+    {
+        for(i = 0; i < servinfo->conns; i++)
+        {
+            conn = &server->conns[i];
+            server->fds[i + 1].fd = conn->state == HTTP_EVENT_FREE ? -1 : conn->fdes;
+            server->fds[i + 1].events = conn->state == HTTP_EVENT_SEND ? POLLOUT : POLLIN;
+        }
+
+        // with no free connection, new connections wait in the listen backlog
+        server->fds[0].fd = server->http.conn_pool.available > 0 ? servinfo->listenfd : -1;
+        server->fds[0].events = POLLIN;
+
+        if(poll(server->fds, servinfo->conns + 1, HTTP_EVENT_POLL_INTERVAL) < 0)
+        {
+            log_error(&servinfo->log, "poll failed");
+            vTaskDelay(HTTP_EVENT_POLL_INTERVAL/portTICK_RATE_MS);
+            continue;
+        }
+
+        for(i = 0; i < servinfo->conns; i++)
+        {
+            conn = &server->conns[i];
+            if(conn->state == HTTP_EVENT_FREE)
+                continue;
+
+            if(server->fds[i + 1].revents & (POLLERR|POLLHUP|POLLNVAL))
+                http_event_close(server, conn);
+            else if(server->fds[i + 1].revents)
+            {
+                conn->timer = xTaskGetTickCount();
+                if(conn->state == HTTP_EVENT_HEADER)
+                    http_event_receive_header(server, conn);
+                else if(conn->state == HTTP_EVENT_BODY)
+                    http_event_receive_body(server, conn);
+                else
+                    http_event_send(server, conn);
+            }
+            else if(xTaskGetTickCount() - conn->timer > (portTickType)(conn->timeout/portTICK_RATE_MS))
+            {
+                log_debug(&server->http.log, "connection timed out");
+                http_event_close(server, conn);
+            }
+        }
+
+        if(server->fds[0].revents & POLLIN)
+            http_event_accept(server);
+    }
+}
+
+/**
+ * @brief   accepts a connection into a free connection context.
+ */
+void http_event_accept(http_event_server_t* server)
+{
+    sock_server_t* servinfo = &server->http.server;
+    http_event_conn_t* conn = sock_pool_alloc(&server->http.conn_pool);
+    struct sockaddr_in cliaddr;
+    socklen_t clilen = sizeof(cliaddr);
+    int fdes;
+
+    if(!conn)
+        return;
+
+    fdes = accept(servinfo->listenfd, (struct sockaddr*)&cliaddr, &clilen);
+    if(fdes == -1)
+    {
+        sock_pool_free(&server->http.conn_pool, conn);
+        return;
+    }
+
+    log_debug(&servinfo->log, "%s accepted conn with %s", servinfo->name, inet_ntoa(cliaddr.sin_addr));
+
+    http_event_blocking(fdes, false);
+    http_server_nodelay(fdes);
+
+    conn->fdes = fdes;
+    conn->requests = 0;
+    conn->state = HTTP_EVENT_HEADER;
+    conn->timer = xTaskGetTickCount();
+    conn->accepted = conn->timer;
+    conn->timeout = HTTP_REQUEST_TIMEOUT;
+    http_exchange_init(&conn->exchange);
+    http_reader_init(&conn->reader, conn->fdes, conn->buffer, sizeof(conn->buffer));
+}
+
+/**
+ * @brief   closes the connection and frees its context.
+ */
+void http_event_close(http_event_server_t* server, http_event_conn_t* conn)
+{
+    log_debug(&server->http.log, "done, %d requests", conn->requests);
+    http_exchange_finish(&server->http, &conn->exchange, conn->buffer);
+    closesocket(conn->fdes);
+    conn->state = HTTP_EVENT_FREE;
+    sock_pool_free(&server->http.conn_pool, conn);
+}
+
+/**
+ * @brief   receives what is available of the request header, and responds once it is complete.
+ */
+void http_event_receive_header(http_event_server_t* server, http_event_conn_t* conn)
+{
+    char* line;
+
+    if(http_reader_receive(&conn->reader) <= 0)
+    {
+        http_event_close(server, conn);
+        return;
+    }
+
+    while((line = http_reader_next(&conn->reader)))
+    {
+        if(!*line || !http_exchange_parse(&conn->exchange, line))
+        {
+            http_event_request(server, conn);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief   works out the response to a received request header, and sets up to send it.
+ */
+void http_event_request(http_event_server_t* server, http_event_conn_t* conn)
+{
+    http_exchange_t* exchange = &conn->exchange;
+
+    // the first request is timed from when the connection was accepted
+    if(conn->requests == 0)
+        exchange->start = conn->accepted;
+
+    conn->requests++;
+    if(conn->requests >= server->http.keepalive_requests)
+        exchange->keepalive = false;
+
+    // the header lines are done with, the buffer is used for the response from here on
+    http_exchange_respond(&server->http, exchange, http_reader_complete(&conn->reader), conn->buffer);
+
+    // a websocket would hold the only task, they are served by the threaded server
+    if(exchange->api_call && (exchange->api_call->flags & HTTP_API_WEBSOCKET))
+    {
+        http_exchange_status(exchange, 501);
+        exchange->keepalive = false;
+    }
+
+    conn->state = HTTP_EVENT_SEND;
+    conn->timeout = HTTP_REQUEST_TIMEOUT;
+    conn->segment = 0;
+    conn->segments = 0;
+
+    // serve error message
+    if(http_exchange_error(exchange))
+        http_event_error(conn);
+    // not modified
+    else if(exchange->status == 304)
+        http_event_header(conn, sizeof(conn->buffer), HTTP_ETAG, exchange->cached->etag);
+    // GET cached file response, the cache entry is held until the response is sent
+    else if(exchange->cached)
+    {
+        if(http_event_header(conn, sizeof(conn->buffer), HTTP_CONTENT_LENGTH, exchange->length))
+            http_event_segment(conn, exchange->cached->content + exchange->offset, exchange->length);
+    }
+    // POST or GET, RPC response
+    else if(exchange->api_call)
+    {
+        http_event_api(server, conn);
+        return;
+    }
+    // POST file response, sent once the body is written
+    else if(exchange->file && !strcmp(exchange->req_type, HTTP_POST))
+    {
+        log_debug(&server->http.log, "write %s %ub", exchange->url, exchange->content_length);
+        if(exchange->content_length > 0)
+        {
+            conn->state = HTTP_EVENT_BODY;
+            return;
+        }
+        http_event_header(conn, sizeof(conn->buffer), HTTP_CONTENT_LENGTH, 0);
+    }
+    // GET file response, the file is read into the buffer as it is sent
+    else if(exchange->file && !strcmp(exchange->req_type, HTTP_GET))
+    {
+        log_debug(&server->http.log, "read %s", exchange->url);
+        if(exchange->keepalive || exchange->size)
+            http_event_header(conn, sizeof(conn->buffer), HTTP_CONTENT_LENGTH, exchange->length);
+        else
+            http_event_header(conn, sizeof(conn->buffer), NULL, 0);
+    }
+}
+
+/**
+ * @brief   sets up to send the response header.
+ * @retval  returns false if the header did not fit in size bytes of the buffer, a 500
+ *          response is sent instead and the body must not follow.
+ */
+bool http_event_header(http_event_conn_t* conn, int size, const char* field, uint32_t value)
+{
+    http_exchange_t* exchange = &conn->exchange;
+    bool fits = true;
+    int length;
+
+    length = http_exchange_header(exchange, conn->buffer, size, field, value);
+    if(length < 0)
+    {
+        length = http_exchange_overflow(exchange, conn->buffer, size);
+        fits = false;
+    }
+    if(length > 0)
+        http_event_segment(conn, conn->buffer, length);
+
+    return fits;
+}
+
+/**
+ * @brief   sets up to send the error page for the response header title.
+ */
+void http_event_error(http_event_conn_t* conn)
+{
+    http_exchange_t* exchange = &conn->exchange;
+    char* message = conn->buffer + HTTP_SCRATCH_LEN;
+
+    snprintf(message, sizeof(conn->buffer) - HTTP_SCRATCH_LEN, HTTP_ERROR_MESSAGE, exchange->header, exchange->url);
+    if(!http_event_header(conn, HTTP_SCRATCH_LEN, HTTP_CONTENT_LENGTH, message_response_length(message)))
+        return;
+    http_event_segment(conn, text_page_header, sizeof(text_page_header)-1);
+    http_event_segment(conn, message, strlen(message));
+    http_event_segment(conn, text_page_footer, sizeof(text_page_footer)-1);
+}
+
+/**
+ * @brief   the non-blocking adapter for API calls.
+ *
+ * API calls read the request body and write the response with blocking socket calls,
+ * so the socket is made blocking for the call, and the call completes before
+ * other connections are served.
+ */
+void http_event_api(http_event_server_t* server, http_event_conn_t* conn)
+{
+    http_exchange_t* exchange = &conn->exchange;
+    int length;
+
+    log_debug(&server->http.log, "process API call");
+
+    // the response length is only known by closing the connection, unless it is chunked
+    if(!(exchange->api_call->flags & HTTP_API_CHUNKED))
+        exchange->keepalive = false;
+
+    http_event_blocking(conn->fdes, true);
+
+    length = http_exchange_header(exchange, conn->buffer, sizeof(conn->buffer),
+            exchange->api_call->flags & HTTP_API_CHUNKED ? HTTP_TRANSFER_ENCODING : NULL, 0);
+    if(length >= 0)
+    {
+        http_exchange_sent(exchange, send(conn->fdes, conn->buffer, length, 0));
+        http_api_process(exchange->api_call, &exchange->params, conn->fdes, exchange->content_length, conn->buffer, sizeof(conn->buffer));
+        if(exchange->api_call->flags & HTTP_API_CHUNKED)
+            http_api_write_chunk(conn->fdes, NULL, 0);
+    }
+    else
+    {
+        // the header did not fit, the API call is not made
+        length = http_exchange_overflow(exchange, conn->buffer, sizeof(conn->buffer));
+        if(length > 0)
+            http_exchange_sent(exchange, send(conn->fdes, conn->buffer, length, 0));
+    }
+
+    http_event_blocking(conn->fdes, false);
+
+    http_event_done(server, conn);
+}
+
+/**
+ * @brief   receives what is available of a POST body into the file.
+ */
+void http_event_receive_body(http_event_server_t* server, http_event_conn_t* conn)
+{
+    http_exchange_t* exchange = &conn->exchange;
+    int length;
+
+    length = http_exchange_receive(exchange, conn->fdes, conn->buffer, sizeof(conn->buffer));
+
+    // the connection failed, the incomplete file is removed as it closes
+    if(length <= 0 && exchange->status == 201)
+    {
+        http_event_close(server, conn);
+        return;
+    }
+    // the file could not be written, the rest of the body is not read
+    if(length <= 0)
+        exchange->keepalive = false;
+
+    if(length <= 0 || exchange->content_length == 0)
+    {
+        conn->state = HTTP_EVENT_SEND;
+        if(http_exchange_error(exchange))
+            http_event_error(conn);
+        else
+            http_event_header(conn, sizeof(conn->buffer), HTTP_CONTENT_LENGTH, 0);
+    }
+}
+
+/**
+ * @brief   sends what the socket will take of the response.
+ */
+void http_event_send(http_event_server_t* server, http_event_conn_t* conn)
+{
+    http_exchange_t* exchange = &conn->exchange;
+    http_event_segment_t* segment;
+    int length;
+
+    // the segments are sent, stream the rest of a file, unless the response failed
+    if(conn->segment == conn->segments)
+    {
+        length = 0;
+        if(exchange->file && !strcmp(exchange->req_type, HTTP_GET) && !http_exchange_error(exchange))
+            length = http_exchange_read(exchange, conn->buffer, sizeof(conn->buffer));
+
+        if(length <= 0)
+        {
+            http_event_done(server, conn);
+            return;
+        }
+
+        conn->segment = 0;
+        conn->segments = 0;
+        http_event_segment(conn, conn->buffer, length);
+    }
+
+    segment = &conn->segment_list[conn->segment];
+
+    length = send(conn->fdes, segment->data, segment->length, 0);
+    if(length <= 0)
+    {
+        http_event_close(server, conn);
+        return;
+    }
+
+    http_exchange_sent(exchange, length);
+    segment->data += length;
+    segment->length -= length;
+    if(segment->length == 0)
+        conn->segment++;
+}
+
+/**
+ * @brief   ends the response, and waits for the next request or closes the connection.
+ */
+void http_event_done(http_event_server_t* server, http_event_conn_t* conn)
+{
+    if(!conn->exchange.keepalive)
+    {
+        http_event_close(server, conn);
+        return;
+    }
+
+    http_exchange_finish(&server->http, &conn->exchange, conn->buffer);
+    http_exchange_init(&conn->exchange);
+    http_reader_init(&conn->reader, conn->fdes, conn->buffer, sizeof(conn->buffer));
+    conn->state = HTTP_EVENT_HEADER;
+    conn->timeout = server->http.keepalive_timeout;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+* @addtogroup http
+*
+* @{
+* @file http_event_server.h
+*/
+
+#ifndef HTTP_HTTP_EVENT_SERVER_H_
+#define HTTP_HTTP_EVENT_SERVER_H_
+
+#include <sys/socket.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "http_server.h"
+#include "http_reader.h"
+
+#define HTTP_EVENT_BUFFER_LEN       (HTTP_SCRATCH_LEN + 128)    ///< per connection buffer, for the header and a message
+#define HTTP_EVENT_POLL_INTERVAL    500     ///< time in ms between checks for timed out connections
+#define HTTP_EVENT_SEGMENTS         4       ///< the most pieces a response is sent in
+
+typedef enum {
+    HTTP_EVENT_FREE,                ///< the connection context is unused
+    HTTP_EVENT_HEADER,              ///< receiving the request header
+    HTTP_EVENT_BODY,                ///< receiving a POST body into a file
+    HTTP_EVENT_SEND                 ///< sending the response
+}http_event_state_t;
+
+typedef struct {
+    const char* data;
+    int length;
+}http_event_segment_t;
+
+typedef struct {
+    int fdes;                       ///< the connected socket
+    http_event_state_t state;       ///< what the connection waits for
+    int requests;                   ///< the number of requests served
+    portTickType timer;             ///< the tick count at the last activity
+    portTickType accepted;          ///< the tick count when the connection was accepted
+    int timeout;                    ///< time in ms the connection may be inactive
+    int segment;                    ///< the segment being sent
+    int segments;                   ///< the number of segments to send
+    http_event_segment_t segment_list[HTTP_EVENT_SEGMENTS];
+    http_exchange_t exchange;
+    http_reader_t reader;
+    char buffer[HTTP_EVENT_BUFFER_LEN];
+}http_event_conn_t;
+
+typedef struct {
+    httpserver_t http;              ///< settings and cache shared with the threaded server
+    http_event_conn_t* conns;       ///< the objects of http.conn_pool, server.conns long
+    struct pollfd* fds;             ///< the poll set, the listener then the connections
+}http_event_server_t;
+
+int init_http_event_server(http_event_server_t* server, char* configfile, const http_api_t** api);
+
+#endif /* HTTP_HTTP_EVENT_SERVER_H_ */
+
+/**
+ * @}
+ */
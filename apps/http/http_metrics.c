@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+* @addtogroup http
+*
+* @{
+* @file http_metrics.c
+*/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "syscalls.h"
+#include "net.h"
+#include "http_metrics.h"
+
+/**
+ * the upper bounds of the latency histogram buckets, in ms.
+ */
+static const uint16_t http_metrics_bounds[HTTP_METRICS_BUCKETS] = {1, 2, 5, 10, 25, 50, 100, 250, 500, 1000};
+
+static const char* const http_metrics_classes[HTTP_METRICS_CLASSES] = {"1xx", "2xx", "3xx", "4xx", "5xx"};
+
+/**
+ * the servers that have metrics, the newest first.
+ */
+static http_metrics_t* http_metrics_list;
+
+/**
+ * the lowest free heap size seen while serving requests. heap_2 does not track it.
+ */
+static uint32_t http_metrics_heap_min = UINT32_MAX;
+
+/**
+ * writes the metrics text into a buffer, sent as one chunk of the response when full.
+ */
+typedef struct {
+    int fdes;
+    char* buffer;
+    int size;
+    int length;
+}http_metrics_writer_t;
+
+/**
+ * initialises the metrics of a server, and adds them to those served by http_metrics_api.
+ *
+ * @param   metrics - the metrics to initialise.
+ * @param   name - the server name, the server label of the metrics.
+ * @param   api - the API members of the server. the first HTTP_METRICS_ROUTES are counted
+ *          separately, the files are counted together, and the rest are counted as other.
+ * @param   pool - the connection contexts of the server, or NULL.
+ */
+void http_metrics_init(http_metrics_t* metrics, const char* name, const http_api_t** api, sock_pool_t* pool)
+{
+    memset(metrics->routes, 0, sizeof(metrics->routes));
+    metrics->name = name;
+    metrics->api = api;
+    metrics->pool = pool;
+
+    vTaskSuspendAll();
+    metrics->next = http_metrics_list;
+    http_metrics_list = metrics;
+    xTaskResumeAll();
+}
+
+/**
+ * @param   metrics - the metrics of the server.
+ * @param   api_call - the API call that served the request, or NULL.
+ * @param   file - true if the request was served from a file or the cache.
+ * @retval  returns the counters of the route that served a request.
+ */
+http_metrics_route_t* http_metrics_route(http_metrics_t* metrics, const http_api_t* api_call, bool file)
+{
+    int i;
+
+    if(api_call)
+    {
+        for(i = 0; metrics->api && i < HTTP_METRICS_ROUTES && metrics->api[i]; i++)
+        {
+            if(metrics->api[i] == api_call)
+                return &metrics->routes[i];
+        }
+    }
+    else if(file)
+        return &metrics->routes[HTTP_METRICS_ROUTES];
+
+    return &metrics->routes[HTTP_METRICS_ROUTES + 1];
+}
+
+/**
+ * adds a latency to a histogram.
+ */
+static void http_metrics_observe(uint32_t* histogram, uint32_t* sum, uint32_t ms)
+{
+    int i;
+
+    for(i = 0; i < HTTP_METRICS_BUCKETS && ms > http_metrics_bounds[i]; i++);
+
+    http_metrics_add(histogram[i], 1);
+    http_metrics_add(*sum, ms);
+}
+
+/**
+ * counts a served request.
+ *
+ * the counters are added to without a lock, so any task may count requests at any time.
+ * the free heap size is sampled too, for the lowest seen.
+ *
+ * @param   route - the counters of the route that served the request, see http_metrics_route().
+ * @param   status - the response status code.
+ * @param   bytes_in - the number of bytes received.
+ * @param   bytes_out - the number of bytes sent.
+ * @param   first_byte - the time in ms from the request to the first byte of the response.
+ * @param   duration - the time in ms from the request to the end of the response.
+ */
+void http_metrics_count(http_metrics_route_t* route, int status, uint32_t bytes_in, uint32_t bytes_out, uint32_t first_byte, uint32_t duration)
+{
+    uint32_t heap = xPortGetFreeHeapSize();
+    uint32_t heap_min = __atomic_load_n(&http_metrics_heap_min, __ATOMIC_RELAXED);
+    int class = status / 100 - 1;
+
+    if(class < 0 || class >= HTTP_METRICS_CLASSES)
+        class = HTTP_METRICS_CLASSES - 1;
+
+    http_metrics_add(route->requests[class], 1);
+    http_metrics_add(route->bytes_in, bytes_in);
+    http_metrics_add(route->bytes_out, bytes_out);
+    http_metrics_observe(route->first_byte, &route->first_byte_sum, first_byte);
+    http_metrics_observe(route->duration, &route->duration_sum, duration);
+
+    while(heap < heap_min && !__atomic_compare_exchange_n(&http_metrics_heap_min, &heap_min, heap, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/**
+ * sends the buffered text as one chunk.
+ */
+static int http_metrics_flush(http_metrics_writer_t* writer)
+{
+    int length = writer->length;
+
+    writer->length = 0;
+    if(length > 0 && http_api_write_chunk(writer->fdes, writer->buffer, length) != length)
+        return -1;
+    return length;
+}
+
+/**
+ * formats one line of text into the buffer, sending the buffer first if the line does not fit.
+ */
+static int http_metrics_printf(http_metrics_writer_t* writer, const char* format, ...)
+{
+    va_list args;
+    int length;
+    int tries;
+
+    for(tries = 0; tries < 2; tries++)
+    {
+        va_start(args, format);
+        length = vsnprintf(writer->buffer + writer->length, writer->size - writer->length, format, args);
+        va_end(args);
+
+        if(length >= 0 && length < writer->size - writer->length)
+        {
+            writer->length += length;
+            return length;
+        }
+
+        // a line longer than the buffer is dropped
+        if(http_metrics_flush(writer) < 0)
+            return -1;
+    }
+    return -1;
+}
+
+/**
+ * @retval  returns the name of a route.
+ */
+static const char* http_metrics_route_name(http_metrics_t* metrics, int route)
+{
+    if(route == HTTP_METRICS_ROUTES)
+        return "files";
+    if(route == HTTP_METRICS_ROUTES + 1 || !metrics->api || !metrics->api[route])
+        return "other";
+    return metrics->api[route]->name;
+}
+
+/**
+ * @retval  returns the number of requests served by a route.
+ */
+static uint32_t http_metrics_requests(http_metrics_route_t* route)
+{
+    uint32_t requests = 0;
+    int i;
+
+    for(i = 0; i < HTTP_METRICS_CLASSES; i++)
+        requests += route->requests[i];
+    return requests;
+}
+
+/**
+ * writes a histogram of the routes that have served requests.
+ * the counters are read once each, as requests may be counted while they are written.
+ */
+static void http_metrics_histogram(http_metrics_writer_t* writer, const char* name, const char* help, size_t offset, size_t sum_offset)
+{
+    http_metrics_t* metrics;
+    uint32_t* histogram;
+    uint32_t count;
+    uint32_t sum;
+    int route;
+    int i;
+
+    http_metrics_printf(writer, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+
+    for(metrics = http_metrics_list; metrics; metrics = metrics->next)
+    {
+        for(route = 0; route < HTTP_METRICS_ROUTES + 2; route++)
+        {
+            histogram = (uint32_t*)((char*)&metrics->routes[route] + offset);
+            sum = *(uint32_t*)((char*)&metrics->routes[route] + sum_offset);
+            if(!http_metrics_requests(&metrics->routes[route]))
+                continue;
+
+            count = 0;
+            for(i = 0; i <= HTTP_METRICS_BUCKETS; i++)
+            {
+                count += histogram[i];
+                if(i < HTTP_METRICS_BUCKETS)
+                    http_metrics_printf(writer, "%s_bucket{server=\"%s\",route=\"%s\",le=\"%u.%03u\"} %u\n",
+                            name, metrics->name, http_metrics_route_name(metrics, route),
+                            http_metrics_bounds[i] / 1000, http_metrics_bounds[i] % 1000, (unsigned int)count);
+                else
+                    http_metrics_printf(writer, "%s_bucket{server=\"%s\",route=\"%s\",le=\"+Inf\"} %u\n",
+                            name, metrics->name, http_metrics_route_name(metrics, route), (unsigned int)count);
+            }
+            http_metrics_printf(writer, "%s_sum{server=\"%s\",route=\"%s\"} %u.%03u\n",
+                    name, metrics->name, http_metrics_route_name(metrics, route),
+                    (unsigned int)(sum / 1000), (unsigned int)(sum % 1000));
+            http_metrics_printf(writer, "%s_count{server=\"%s\",route=\"%s\"} %u\n",
+                    name, metrics->name, http_metrics_route_name(metrics, route), (unsigned int)count);
+        }
+    }
+}
+
+/**
+ * writes a counter of each route that has served requests.
+ */
+static void http_metrics_route_counter(http_metrics_writer_t* writer, const char* name, const char* help, size_t offset)
+{
+    http_metrics_t* metrics;
+    int route;
+
+    http_metrics_printf(writer, "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+
+    for(metrics = http_metrics_list; metrics; metrics = metrics->next)
+    {
+        for(route = 0; route < HTTP_METRICS_ROUTES + 2; route++)
+        {
+            if(http_metrics_requests(&metrics->routes[route]))
+                http_metrics_printf(writer, "%s{server=\"%s\",route=\"%s\"} %u\n",
+                        name, metrics->name, http_metrics_route_name(metrics, route),
+                        (unsigned int)*(uint32_t*)((char*)&metrics->routes[route] + offset));
+        }
+    }
+}
+
+/**
+ * writes a connection pool value of each server. the contexts in use are worked out from those available.
+ */
+static void http_metrics_pool(http_metrics_writer_t* writer, const char* name, const char* type, const char* help, size_t offset)
+{
+    http_metrics_t* metrics;
+    unsigned long value;
+
+    http_metrics_printf(writer, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+
+    for(metrics = http_metrics_list; metrics; metrics = metrics->next)
+    {
+        if(!metrics->pool)
+            continue;
+        if(offset == offsetof(sock_pool_t, exhausted))
+            value = metrics->pool->exhausted;
+        else if(offset == offsetof(sock_pool_t, available))
+            value = metrics->pool->count - metrics->pool->available;
+        else
+            value = *(int*)((char*)metrics->pool + offset);
+        http_metrics_printf(writer, "%s{server=\"%s\"} %lu\n", name, metrics->name, value);
+    }
+}
+
+/**
+ * writes a system wide value.
+ */
+static void http_metrics_value(http_metrics_writer_t* writer, const char* name, const char* type, const char* help, unsigned long value)
+{
+    http_metrics_printf(writer, "# HELP %s %s\n# TYPE %s %s\n%s %lu\n", name, help, name, type, name, value);
+}
+
+/**
+ * the API call that serves the metrics of all servers in the Prometheus text format.
+ *
+ * per route of each server, the requests by status class, the bytes received and sent,
+ * and histograms of the time to the first byte of the response and to the end of the response.
+ * the body of an API response is written by the API call, and is not counted in the bytes sent.
+ *
+ * then the connection contexts in use of each server, and the heap, file, task and network counters.
+ *
+ * add &http_metrics_api to the API members of a server to serve them, at /metrics.
+ */
+int http_metrics_process(int fdes, int content_length, char* buffer, int size)
+{
+    http_metrics_writer_t writer = {fdes, buffer, size, 0};
+    http_metrics_t* metrics;
+    int route;
+    int i;
+
+    (void)content_length;
+
+    http_metrics_printf(&writer, "# HELP http_requests_total HTTP requests served.\n# TYPE http_requests_total counter\n");
+    for(metrics = http_metrics_list; metrics; metrics = metrics->next)
+    {
+        for(route = 0; route < HTTP_METRICS_ROUTES + 2; route++)
+        {
+            for(i = 0; i < HTTP_METRICS_CLASSES; i++)
+            {
+                if(metrics->routes[route].requests[i])
+                    http_metrics_printf(&writer, "http_requests_total{server=\"%s\",route=\"%s\",code=\"%s\"} %u\n",
+                            metrics->name, http_metrics_route_name(metrics, route), http_metrics_classes[i],
+                            (unsigned int)metrics->routes[route].requests[i]);
+            }
+        }
+    }
+
+    http_metrics_route_counter(&writer, "http_request_bytes_total", "Bytes received in HTTP requests.",
+            offsetof(http_metrics_route_t, bytes_in));
+    http_metrics_route_counter(&writer, "http_response_bytes_total", "Bytes sent in HTTP responses, except API response bodies.",
+            offsetof(http_metrics_route_t, bytes_out));
+    http_metrics_histogram(&writer, "http_first_byte_seconds", "Time from the request to the first byte of the response.",
+            offsetof(http_metrics_route_t, first_byte), offsetof(http_metrics_route_t, first_byte_sum));
+    http_metrics_histogram(&writer, "http_request_duration_seconds", "Time from the request to the end of the response.",
+            offsetof(http_metrics_route_t, duration), offsetof(http_metrics_route_t, duration_sum));
+
+    http_metrics_pool(&writer, "http_connections", "gauge", "HTTP connection contexts in use.", offsetof(sock_pool_t, available));
+    http_metrics_pool(&writer, "http_connections_max", "gauge", "HTTP connection contexts.", offsetof(sock_pool_t, count));
+    http_metrics_pool(&writer, "http_connections_peak", "gauge", "Most HTTP connection contexts in use at once.", offsetof(sock_pool_t, peak));
+    http_metrics_pool(&writer, "http_connections_refused_total", "counter", "HTTP connections refused for want of a context.", offsetof(sock_pool_t, exhausted));
+
+    http_metrics_value(&writer, "heap_free_bytes", "gauge", "Free heap.", xPortGetFreeHeapSize());
+    http_metrics_value(&writer, "heap_min_free_bytes", "gauge", "Lowest free heap seen while serving HTTP requests.",
+            http_metrics_heap_min == UINT32_MAX ? xPortGetFreeHeapSize() : http_metrics_heap_min);
+    http_metrics_value(&writer, "files_open_max", "gauge", "Most files open at once since boot.", file_table_hwm());
+    http_metrics_value(&writer, "tasks", "gauge", "Tasks.", uxTaskGetNumberOfTasks());
+    http_metrics_value(&writer, "net_ip_packets_sent_total", "counter", "IP packets sent.", net_ip_packets_sent());
+    http_metrics_value(&writer, "net_ip_packets_received_total", "counter", "IP packets received.", net_ip_packets_received());
+    http_metrics_value(&writer, "net_ip_packets_dropped_total", "counter", "IP packets dropped.", net_ip_packets_dropped());
+    http_metrics_value(&writer, "net_ip_errors_total", "counter", "IP errors.", net_ip_errors());
+
+    return http_metrics_flush(&writer);
+}
+
+const http_api_t http_metrics_api = {"metrics", http_metrics_process, HTTP_API_CHUNKED, HTTP_GET, NULL};
+
+/**
+ * @}
+ */
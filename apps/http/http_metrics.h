@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+* @addtogroup http
+*
+* @{
+* @file http_metrics.h
+*/
+
+#ifndef HTTP_HTTP_METRICS_H_
+#define HTTP_HTTP_METRICS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "http_api.h"
+#include "sock_utils.h"
+
+#define HTTP_METRICS_ROUTES         8       ///< the number of API members counted separately, the rest are counted as other
+#define HTTP_METRICS_BUCKETS        10      ///< the number of latency histogram buckets, less the +Inf bucket
+#define HTTP_METRICS_CLASSES        5       ///< the number of status classes counted, 1xx to 5xx
+
+/**
+ * adds to a counter without a lock. counters are only ever added to, and are read while being added to.
+ */
+#define http_metrics_add(counter, n)    __atomic_fetch_add(&(counter), (n), __ATOMIC_RELAXED)
+
+/**
+ * the counters of one route.
+ */
+typedef struct {
+    uint32_t requests[HTTP_METRICS_CLASSES];            ///< requests served, by status class
+    uint32_t bytes_in;                                  ///< bytes received, the header and body of the requests
+    uint32_t bytes_out;                                 ///< bytes sent, except those written by API calls
+    uint32_t first_byte[HTTP_METRICS_BUCKETS + 1];      ///< histogram of the time from the request to the first byte of the response
+    uint32_t first_byte_sum;                            ///< the sum of the first byte times in ms
+    uint32_t duration[HTTP_METRICS_BUCKETS + 1];        ///< histogram of the time from the request to the end of the response
+    uint32_t duration_sum;                              ///< the sum of the durations in ms
+}http_metrics_route_t;
+
+typedef struct _http_metrics_t http_metrics_t;
+
+/**
+ * the metrics of one server.
+ *
+ * the routes are the first HTTP_METRICS_ROUTES API members, then the files, then everything else.
+ */
+struct _http_metrics_t {
+    const char* name;                                   ///< the server name, the server label of the metrics
+    const http_api_t** api;                             ///< the API members, routes[i] counts api[i]
+    sock_pool_t* pool;                                  ///< the connection contexts of the server
+    http_metrics_route_t routes[HTTP_METRICS_ROUTES + 2];
+    http_metrics_t* next;                               ///< the next server with metrics
+};
+
+void http_metrics_init(http_metrics_t* metrics, const char* name, const http_api_t** api, sock_pool_t* pool);
+http_metrics_route_t* http_metrics_route(http_metrics_t* metrics, const http_api_t* api_call, bool file);
+void http_metrics_count(http_metrics_route_t* route, int status, uint32_t bytes_in, uint32_t bytes_out, uint32_t first_byte, uint32_t duration);
+int http_metrics_process(int fdes, int content_length, char* buffer, int size);
+
+extern const http_api_t http_metrics_api;
+
+#endif /* HTTP_HTTP_METRICS_H_ */
+
+/**
+ * @}
+ */
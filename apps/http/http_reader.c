@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+* @addtogroup http
+*
+* @{
+* @file http_reader.c
+*/
+
+#include <string.h>
+#include <sys/socket.h>
+#include "http_defs.h"
+#include "http_reader.h"
+
+/**
+ * initialises a buffered reader of HTTP header lines.
+ *
+ * the header is received in chunks rather than a byte at a time. socket data is first peeked,
+ * and then only the part up to the end of the header is consumed, so that the message body
+ * remains on the socket for the caller to read as before.
+ *
+\code
+
+http_reader_t reader;
+char* line;
+
+http_reader_init(&reader, fdes, buffer, size);
+
+// the empty line that ends the header returns ""
+while((line = http_reader_line(&reader)) && *line)
+	printf("%s\n", line);
+
+\endcode
+ *
+ * @param   reader - the reader to initialise.
+ * @param   fdes - the socket to read from.
+ * @param   buffer - memory to hold received lines. lines longer than size-1 bytes are discarded.
+ * @param   size - the size of buffer in bytes.
+ */
+void http_reader_init(http_reader_t* reader, int fdes, char* buffer, int size)
+{
+	reader->fdes = fdes;
+	reader->buffer = buffer;
+	reader->size = size;
+	reader->start = 0;
+	reader->end = 0;
+	reader->newlines = 0;
+	reader->discard = false;
+}
+
+/**
+ * receives more of the header into the buffer, without consuming any of the body.
+ *
+ * blocks until some data is received, unless the socket is non-blocking. an event driven
+ * caller should call it once each time the socket is readable, then take the lines
+ * received with http_reader_next().
+ *
+ * @param   reader - the initialised reader.
+ * @retval  returns the number of bytes received, or -1 on error or if the connection closed.
+ */
+int http_reader_receive(http_reader_t* reader)
+{
+	char* data;
+	int space;
+	int length;
+	int count;
+	int received;
+	int newlines;
+
+	if(reader->start > 0)
+	{
+		// move the partial line to the start of the buffer
+		memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+		reader->end -= reader->start;
+		reader->start = 0;
+	}
+	else if(reader->end == reader->size - 1)
+	{
+		// no end of line in a full buffer, drop the line
+		reader->discard = true;
+		reader->end = 0;
+	}
+
+	data = reader->buffer + reader->end;
+	space = reader->size - 1 - reader->end;
+
+	length = recv(reader->fdes, data, space, MSG_PEEK);
+	if(length <= 0)
+		return -1;
+
+	// find the end of header in the peeked data, to consume no more than that
+	newlines = reader->newlines;
+	for(count = 0; count < length && newlines < 2; count++)
+	{
+		if(data[count] == HTTP_EOL_CHAR)
+			newlines++;
+		else if(data[count] != HTTP_CR_CHAR)
+			newlines = 0;
+	}
+
+	// consume the peeked data, which is received again over the top of itself
+	for(length = 0; length < count; length += received)
+	{
+		received = recv(reader->fdes, data + length, count - length, 0);
+		if(received <= 0)
+			return -1;
+	}
+
+	reader->newlines = newlines;
+	reader->end += count;
+	return count;
+}
+
+/**
+ * gets the next header line already in the buffer, without receiving.
+ *
+ * @param   reader - the initialised reader.
+ * @retval  returns a pointer to the line as for http_reader_line(), or NULL if no
+ *          whole line has been received yet.
+ */
+char* http_reader_next(http_reader_t* reader)
+{
+	char* line;
+	char* eol;
+
+	while(1)
+	{
+		line = reader->buffer + reader->start;
+		eol = memchr(line, HTTP_EOL_CHAR, reader->end - reader->start);
+
+		if(!eol)
+			return NULL;
+
+		reader->start = eol - reader->buffer + 1;
+		if(reader->discard)
+		{
+			reader->discard = false;
+			continue;
+		}
+		if(eol > line && *(eol - 1) == HTTP_CR_CHAR)
+			eol--;
+		*eol = '\0';
+		return line;
+	}
+}
+
+/**
+ * gets the next header line.
+ *
+ * @param   reader - the initialised reader.
+ * @retval  returns a pointer to the line in the reader buffer, with the line ending removed.
+ *          it remains valid until the next call. the empty line that ends the header is returned as "".
+ *          returns NULL if the header is already complete, on socket error or timeout,
+ *          or if the connection closed.
+ */
+char* http_reader_line(http_reader_t* reader)
+{
+	char* line;
+
+	while(1)
+	{
+		line = http_reader_next(reader);
+		if(line)
+			return line;
+
+		if(reader->newlines >= 2 || http_reader_receive(reader) <= 0)
+			return NULL;
+	}
+}
+
+/**
+ * @retval  returns true once the empty line that ends the header has been received.
+ */
+bool http_reader_complete(http_reader_t* reader)
+{
+	return reader->newlines >= 2;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+* @addtogroup http
+*
+* @{
+* @file http_reader.h
+*/
+
+#ifndef HTTP_HTTP_READER_H_
+#define HTTP_HTTP_READER_H_
+
+#include <stdbool.h>
+
+typedef struct {
+	int fdes;                   ///< the socket to read from
+	char* buffer;               ///< the line buffer
+	int size;                   ///< size of the line buffer
+	int start;                  ///< offset of the next line in buffer
+	int end;                    ///< offset of the end of the received data in buffer
+	int newlines;               ///< count of consecutive newlines received, 2 marks the end of header
+	bool discard;               ///< set while discarding a line too long for the buffer
+}http_reader_t;
+
+void http_reader_init(http_reader_t* reader, int fdes, char* buffer, int size);
+int http_reader_receive(http_reader_t* reader);
+char* http_reader_next(http_reader_t* reader);
+char* http_reader_line(http_reader_t* reader);
+bool http_reader_complete(http_reader_t* reader);
+
+#endif /* HTTP_HTTP_READER_H_ */
+
+/**
+ * @}
+ */
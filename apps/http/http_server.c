@@ -40,32 +40,41 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
+#include <stdarg.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include "FreeRTOS.h"
+#include "task.h"
 #include "sock_utils.h"
 #include "logger.h"
 #include "http_server.h"
 #include "http_api.h"
-#include "confparse.h"
+#include "http_reader.h"
+#include "http_cache.h"
+#include "confstore.h"
+#include "strutils.h"
 
 
 typedef struct {
 	int length;
-	const http_api_t* api_call;
-	const char* fsroot;
-	const char* req_type;
-	const char* header;
-	const char* content_type;
-	int content_length;
+	int requests;
+	http_exchange_t exchange;
 	char scratch[HTTP_SCRATCH_LEN];
-	char url[HTTP_URL_LEN];
-	FILE* file;
-	struct stat stat;
+	http_reader_t reader;
+	http_websocket_t websocket;
 }http_server_conn_t;
 
 static void http_server_connection(sock_conn_t* conn);
+static bool http_server_request(httpserver_t* httpserver, sock_conn_t* conn, http_server_conn_t* httpconn);
+static void http_server_timeout(int fdes, int timeout);
+static bool http_send_header(int fdes, http_server_conn_t* httpconn, const char* field, uint32_t value);
 static void message_response(int fdes, const char* message);
+static bool http_exchange_range(http_exchange_t* exchange);
+static void http_exchange_path(httpserver_t* httpserver, http_exchange_t* exchange, char* path);
+static uint32_t http_crc32(uint32_t crc, const char* data, int length);
+static bool http_accept_gzip(const char* value);
+static int http_header_field(char* buffer, int size, int length, const char* format, ...);
 
 /**
  * compare string to a constant string.
@@ -73,31 +82,61 @@ static void message_response(int fdes, const char* message);
 #define compare_string(str, const_comp) (strncmp(const_comp, str, (int)sizeof(const_comp)-1) == 0)
 
 /**
- * @brief   A simple HTTP server with support for GET and POST requests.
+ * reads the settings shared by the threaded and event driven servers.
  */
-int init_http_server(httpserver_t* httpserver, char* configfile, const http_api_t** api)
+void http_server_configure(httpserver_t* httpserver, config_store_t* store, const http_api_t** api)
 {
-	char buffer[sizeof(httpserver->fsroot) + sizeof(HTTP_FS_ROOT_CONFIG_KEY) + 2];
-	const char* fsroot = (const char*)get_config_value_by_key((uint8_t*)buffer, sizeof(buffer), (const uint8_t*)configfile, (const uint8_t*)HTTP_FS_ROOT_CONFIG_KEY);
-
 	httpserver->api = api;
 
 	log_init(&httpserver->log, "http_server");
 
-	if(fsroot == NULL)
-		strncpy(httpserver->fsroot, DEFAULT_HTTPD_FS_ROOT, sizeof(httpserver->fsroot)-1);
-	else
-		strncpy(httpserver->fsroot, fsroot, sizeof(httpserver->fsroot)-1);
+	if(!http_api_router_init(&httpserver->router, api))
+		log_error(&httpserver->log, "failed to build API router");
+
+	strncpy(httpserver->fsroot, config_store_get_string(store, HTTP_FS_ROOT_CONFIG_KEY, DEFAULT_HTTPD_FS_ROOT), sizeof(httpserver->fsroot)-1);
+	httpserver->keepalive_timeout = config_store_get_int(store, HTTP_KEEPALIVE_TIMEOUT_CONFIG_KEY, HTTP_KEEPALIVE_TIMEOUT);
+	httpserver->keepalive_requests = config_store_get_int(store, HTTP_KEEPALIVE_REQUESTS_CONFIG_KEY, HTTP_KEEPALIVE_REQUESTS);
+	http_cache_init(&httpserver->cache,
+			config_store_get_int(store, HTTP_CACHE_SIZE_CONFIG_KEY, HTTP_CACHE_SIZE),
+			config_store_get_int(store, HTTP_CACHE_FILE_SIZE_CONFIG_KEY, HTTP_CACHE_FILE_SIZE));
 
 	log_debug(&httpserver->log, "fsroot: %s", httpserver->fsroot);
+	log_debug(&httpserver->log, "keepalive: %dms, %d requests", httpserver->keepalive_timeout, httpserver->keepalive_requests);
 
 	httpserver->server.conns = 0;
+	httpserver->server.workers = 0;
+	httpserver->server.queue = 0;
 	httpserver->server.port = 0;
 	httpserver->server.stacksize = HTTP_SERVER_STACK_SIZE;
 	httpserver->server.prio = HTTP_SERVER_TASK_PRIO;
 	httpserver->server.name = "httpd";
 
-	get_server_configuration(configfile, &httpserver->server);
+	log_init(&httpserver->server.log, httpserver->server.name);
+	get_server_configuration_from_store(store, &httpserver->server);
+
+	http_metrics_init(&httpserver->metrics, httpserver->server.name, api, &httpserver->conn_pool);
+}
+
+/**
+ * @brief   A simple HTTP server with support for GET and POST requests.
+ */
+int init_http_server(httpserver_t* httpserver, char* configfile, const http_api_t** api)
+{
+	config_store_t store;
+
+	// parse the config file once, for both the http and server settings
+	config_store_load(&store, configfile);
+	http_server_configure(httpserver, &store, api);
+	config_store_free(&store);
+
+	// a connection context for each worker, workers defaults to conns
+	if(!sock_pool_init(&httpserver->conn_pool, sizeof(http_server_conn_t),
+			httpserver->server.workers > 0 ? httpserver->server.workers : httpserver->server.conns))
+	{
+		log_error(&httpserver->log, "failed to allocate connections");
+		return -1;
+	}
+
 	return start_threaded_server(&httpserver->server, http_server_connection, httpserver);
 }
 
@@ -113,251 +152,997 @@ void message_response(int fdes, const char* message)
 }
 
 /**
- * @brief   the HTTP server thread.
- * Processes requests on a per connection, per request basis.
+ * @brief   sets the socket receive timeout.
+ * @param   timeout is the timeout in ms.
  */
-void http_server_connection(sock_conn_t* conn)
+void http_server_timeout(int fdes, int timeout)
 {
-	httpserver_t* httpserver = (httpserver_t*)conn->ctx;
-	http_server_conn_t* httpconn = malloc(sizeof(http_server_conn_t));
+	struct timeval tv;
+	tv.tv_sec = timeout; // take care, lwip sets s as ms
+	tv.tv_usec = 0;
+	setsockopt(fdes, SOL_SOCKET, SO_RCVTIMEO, (char*)&tv, sizeof(struct timeval));
+}
 
-	if(!httpconn)
+/**
+ * @brief   sends small segments as soon as they are ready.
+ *
+ * a response is sent as the header and then the body, in separate sends. on a kept alive
+ * connection, the Nagle algorithm would hold back the body until the client acknowledges
+ * the header, which a client with delayed acknowledgements does only after a timeout.
+ */
+void http_server_nodelay(int fdes)
+{
+	int nodelay = 1;
+	setsockopt(fdes, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+}
+
+/**
+ * @brief   sends the response header in one piece.
+ * @retval  returns false if the header did not fit in scratch, a 500 response was sent
+ *          instead and the body must not follow.
+ */
+bool http_send_header(int fdes, http_server_conn_t* httpconn, const char* field, uint32_t value)
+{
+	bool fits = true;
+	int size = http_exchange_header(&httpconn->exchange, httpconn->scratch, sizeof(httpconn->scratch), field, value);
+
+	if(size < 0)
 	{
-		log_error(&httpserver->log, "failed to allocate memory");
-		return;
+		size = http_exchange_overflow(&httpconn->exchange, httpconn->scratch, sizeof(httpconn->scratch));
+		fits = false;
 	}
+	if(size > 0)
+		http_exchange_sent(&httpconn->exchange, send(fdes, httpconn->scratch, size, 0));
 
-	struct timeval tv;
-	tv.tv_sec = 2000; // take care, lwip sets s as ms
-	tv.tv_usec = 0;
-	setsockopt(conn->connfd, SOL_SOCKET, SO_RCVTIMEO, (char*)&tv, sizeof(struct timeval));
+	return fits;
+}
 
-	httpconn->req_type = NULL;
-	httpconn->content_length = 0;
-	httpconn->content_type = NULL;
-	httpconn->api_call = NULL;
-	httpconn->url[0] = '\0';
-	httpconn->file = NULL;
+/**
+ * @brief   works out the content type from the file extension.
+ */
+const char* http_content_type(const char* path)
+{
+	const char* extension = strrchr(path, HTTP_DOT_CHAR);
 
-	//*********************************
-	//  receive request
-	//********************************
-	/**
-	 * After receiving a whole request header:
-	 *  - if a whole HTTP POST or GET is received, url contains the received url.
-     *  - if a whole HTTP POST is received, content_length holds the length of the outstanding message data.
-	 */
-	while(1)
+	if(!extension)
+		return http_header_content_type_binary;
+	if(!strncmp(http_html, extension, sizeof(http_html)) ||
+			!strncmp(http_shtml, extension, sizeof(http_shtml)))
+		return http_header_content_type_html;
+	if(!strncmp(http_css, extension, sizeof(http_css)))
+		return http_header_content_type_css;
+	if(!strncmp(http_png, extension, sizeof(http_png)))
+		return http_header_content_type_png;
+	if(!strncmp(http_gif, extension, sizeof(http_gif)))
+		return http_header_content_type_gif;
+	if(!strncmp(http_jpg, extension, sizeof(http_jpg)))
+		return http_header_content_type_jpg;
+	if(!strncmp(http_json, extension, sizeof(http_json)))
+		return http_header_content_type_json;
+	if(!strncmp(http_xml, extension, sizeof(http_xml)))
+		return http_header_content_type_xml;
+	if(!strncmp(http_js, extension, sizeof(http_js)))
+		return http_header_content_type_javascript;
+	return http_header_content_type_plain;
+}
+
+/**
+ * @brief   sets the response status code, and the header title sent with it.
+ *          the code is what the response is tested by, the title is only sent.
+ */
+void http_exchange_status(http_exchange_t* exchange, int status)
+{
+	exchange->status = status;
+	switch(status)
 	{
-		httpconn->length = 0;
-		httpconn->scratch[0] = '\0';
-        // receive up to the HTTP_EOL
-        do
-        {
-        	if(recv(conn->connfd, &httpconn->scratch[httpconn->length], 1, 0) < 1)
-        	{
-        	    free(httpconn);
-        	    log_error(&httpserver->log, "aborting");
-        	    return;
-        	}
-            httpconn->length++;
-        }
-        while(httpconn->scratch[httpconn->length-1] != HTTP_EOL_CHAR);
+		case 101: exchange->header = http_101_header_title; break;
+		case 200: exchange->header = http_200_header_title; break;
+		case 201: exchange->header = http_201_header_title; break;
+		case 202: exchange->header = http_202_header_title; break;
+		case 206: exchange->header = http_206_header_title; break;
+		case 304: exchange->header = http_304_header_title; break;
+		case 400: exchange->header = http_400_header_title; break;
+		case 404: exchange->header = http_404_header_title; break;
+		case 405: exchange->header = http_405_header_title; break;
+		case 408: exchange->header = http_408_header_title; break;
+		case 411: exchange->header = http_411_header_title; break;
+		case 416: exchange->header = http_416_header_title; break;
+		case 423: exchange->header = http_423_header_title; break;
+		case 426: exchange->header = http_426_header_title; break;
+		case 501: exchange->header = http_501_header_title; break;
+		default:
+			exchange->status = 500;
+			exchange->header = http_500_header_title;
+		break;
+	}
+}
+
+/**
+ * @brief   resets an exchange, ready to parse a new request.
+ */
+void http_exchange_init(http_exchange_t* exchange)
+{
+	exchange->req_type = NULL;
+	exchange->content_length = 0;
+	exchange->sized = false;
+	http_exchange_status(exchange, 500);
+	exchange->content_type = http_header_content_type_html;
+	exchange->api_call = NULL;
+	exchange->params.count = 0;
+	exchange->params.allowed = true;
+	exchange->url[0] = '\0';
+	exchange->file = NULL;
+	exchange->keepalive = false;
+	exchange->conditional = false;
+	exchange->if_none_match = 0;
+	exchange->accept_gzip = false;
+	exchange->gzip = false;
+	exchange->vary = false;
+	exchange->cached = NULL;
+	exchange->range = false;
+	exchange->offset = 0;
+	exchange->length = 0;
+	exchange->size = 0;
+	exchange->verify = false;
+	exchange->crc = 0;
+	exchange->upload = NULL;
+	exchange->uploaded = 0;
+	exchange->upgrade = false;
+	exchange->connection_upgrade = false;
+	exchange->websocket_version = 0;
+	exchange->websocket_key[0] = '\0';
+	exchange->responded = false;
+	exchange->bytes_in = 0;
+	exchange->bytes_out = 0;
+}
+
+/**
+ * @brief   the file path of the requested url.
+ * @param   path is memory for the file path, HTTP_PATH_LEN bytes long.
+ */
+static void http_exchange_path(httpserver_t* httpserver, http_exchange_t* exchange, char* path)
+{
+	strcpy(path, httpserver->fsroot);
+
+	// if the URL is just a "/" then change it to "/index.html"
+	if(exchange->url[0] == HTTP_SLASH_CHAR && exchange->url[1] == '\0')
+		strcat(path, HTTP_INDEX_STR);
+	// prepend HTTPD_FS_ROOT path
+	else
+		strcat(path, exchange->url);
+}
+
+/**
+ * @brief   updates a CRC32 (as used by zlib and ethernet) with more data.
+ * @param   crc is 0 to start, or the result of the previous update.
+ */
+static uint32_t http_crc32(uint32_t crc, const char* data, int length)
+{
+	// a table per nibble, rather than per byte, keeps it small
+	static const uint32_t table[16] = {
+		0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+		0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+	};
+
+	crc = ~crc;
+	while(length-- > 0)
+	{
+		crc ^= (uint8_t)*data++;
+		crc = (crc >> 4) ^ table[crc & 0x0F];
+		crc = (crc >> 4) ^ table[crc & 0x0F];
+	}
+	return ~crc;
+}
+
+/**
+ * @brief   checks an Accept-Encoding value for gzip.
+ * @retval  returns true if gzip is listed, and not refused with a quality of zero, "gzip;q=0".
+ */
+static bool http_accept_gzip(const char* value)
+{
+	value = strstr(value, HTTP_GZIP);
+	if(!value)
+		return false;
+
+	value += sizeof(HTTP_GZIP)-1;
+	while(*value == HTTP_SPACE_CHAR)
+		value++;
+	if(*value != ';')
+		return true;
+	value++;
+	while(*value == HTTP_SPACE_CHAR)
+		value++;
+	if(strncmp(value, "q=", 2))
+		return true;
 
-        httpconn->scratch[httpconn->length] = '\0';
+	// q=0, q=0.0, q=0.00 and q=0.000 are all zero
+	value += 2;
+	if(*value++ != '0')
+		return true;
+	if(*value == '.')
+		value++;
+	while(*value == '0')
+		value++;
+	return *value >= '1' && *value <= '9';
+}
+
+/**
+ * @brief   parses one request header line.
+ * @param   line is the header line, with the line ending removed. it is modified.
+ * @retval  returns false if the request line is not a supported request.
+ */
+bool http_exchange_parse(http_exchange_t* exchange, char* line)
+{
+	char* value;
+
+	// the request arrives with its first line
+	if(!exchange->bytes_in)
+		exchange->start = xTaskGetTickCount();
+	exchange->bytes_in += strlen(line) + sizeof(HTTP_EOL)-1;
 
-        // check for end of header
-        if(!strcmp(httpconn->scratch, HTTP_EOL))
-            break;
+	// find the GET or POST line
+	if(!exchange->req_type)
+	{
+
+		// look for the "POST " in the header line
+		if(compare_string(line, HTTP_POST))
+			exchange->req_type = HTTP_POST;
+		// look for the "GET " in the header line
+		else if(compare_string(line, HTTP_GET))
+			exchange->req_type = HTTP_GET;
+		else
+			return false;
 
-		// find the GET or POST line
-		if(!httpconn->req_type)
+		// extract url part, occurs after the "GET " part of the header line
+		// find the first space in the line AFTER the URL part of the line
+		char* urlstart = line + strlen(exchange->req_type) + 1;
+		char* urlend = strchr(urlstart, HTTP_SPACE_CHAR);
+		if(urlend)
 		{
-			// look for the "POST " in the header line
-			if(compare_string(httpconn->scratch, HTTP_POST))
-				httpconn->req_type = HTTP_POST;
-			// look for the "GET " in the header line
-			else if(compare_string(httpconn->scratch, HTTP_GET))
-				httpconn->req_type = HTTP_GET;
-			else
-				break;
+			// change that space to a 0
+			*urlend = '\0';
+			strncpy(exchange->url, urlstart, sizeof(exchange->url)-1);
+			exchange->url[sizeof(exchange->url)-1] = '\0';
 
-			if(httpconn->req_type)
-			{
-				// extract url part, occurs after the "GET " part of the header line
-				// find the first space in the line AFTER the URL part of the line
-				char* urlstart = httpconn->scratch + strlen(httpconn->req_type) + 1;
-				char* urlend = strchr(urlstart, HTTP_SPACE_CHAR);
-				if(urlend)
-				{
-					// change that space to a 0
-					*urlend = '\0';
-					strcpy(httpconn->url, urlstart);
-				}
-			}
+			// HTTP/1.1 connections are persistent by default
+			exchange->keepalive = compare_string(urlend + 1, HTTP_VERS_1_1);
 		}
-		// find content length if it is included in header
-		else if(compare_string(httpconn->scratch, HTTP_CONTENT_LENGTH))
+	}
+	// find content length if it is included in header
+	else if(compare_string(line, HTTP_CONTENT_LENGTH))
+	{
+		exchange->content_length = atoi(line + (sizeof(HTTP_CONTENT_LENGTH)-1));
+		exchange->sized = true;
+	}
+	// the client has a copy of the file with this entity tag
+	else if(compare_string(line, HTTP_IF_NONE_MATCH))
+	{
+		value = strchr(line, '"');
+		if(value)
+		{
+			exchange->if_none_match = strtoul(value + 1, NULL, 16);
+			exchange->conditional = true;
+		}
+	}
+	// the client may accept gzip compressed content
+	else if(compare_string(line, HTTP_ACCEPT_ENCODING))
+		exchange->accept_gzip = http_accept_gzip(line + (sizeof(HTTP_ACCEPT_ENCODING)-1));
+	// a single byte range, "bytes=first-last", "bytes=first-" or "bytes=-suffix".
+	// a list of ranges is not supported, and is answered with the whole content.
+	else if(compare_string(line, HTTP_RANGE))
+	{
+		value = strstr(line, HTTP_BYTES "=");
+		if(value && !strchr(value, ','))
 		{
-			char* clstart = httpconn->scratch + (sizeof(HTTP_CONTENT_LENGTH)-1);
-			char* clend = strchr(clstart, HTTP_CR_CHAR);
-			if(clend)
+			value += sizeof(HTTP_BYTES "=")-1;
+			exchange->range_first = *value == '-' ? -1 : strtol(value, &value, 10);
+			if(*value == '-')
 			{
-				*clend = '\0';
-				httpconn->content_length = atoi(clstart);
+				value++;
+				exchange->range_last = (*value >= '0' && *value <= '9') ? strtol(value, NULL, 10) : -1;
+				exchange->range = exchange->range_first >= 0 || exchange->range_last >= 0;
 			}
 		}
 	}
+	// the client has the checksum of the POST body
+	else if(compare_string(line, HTTP_CONTENT_CRC32))
+	{
+		exchange->content_crc = strtoul(line + (sizeof(HTTP_CONTENT_CRC32)-1), NULL, 16);
+		exchange->verify = true;
+	}
+	// the client may ask for a websocket
+	else if(compare_string(line, HTTP_UPGRADE))
+		exchange->upgrade = strstr(strtolower(line + (sizeof(HTTP_UPGRADE)-1)), HTTP_WEBSOCKET) != NULL;
+	else if(compare_string(line, HTTP_SEC_WEBSOCKET_VERSION))
+		exchange->websocket_version = atoi(line + (sizeof(HTTP_SEC_WEBSOCKET_VERSION)-1));
+	else if(compare_string(line, HTTP_SEC_WEBSOCKET_KEY))
+	{
+		strncpy(exchange->websocket_key, line + (sizeof(HTTP_SEC_WEBSOCKET_KEY)-1), sizeof(exchange->websocket_key)-1);
+		exchange->websocket_key[sizeof(exchange->websocket_key)-1] = '\0';
+		value = strchr(exchange->websocket_key, HTTP_SPACE_CHAR);
+		if(value)
+			*value = '\0';
+	}
+	// the client may ask to close, or with HTTP/1.0 to keep alive
+	else if(compare_string(line, HTTP_CONNECTION))
+	{
+		value = strtolower(line + (sizeof(HTTP_CONNECTION)-1));
+		if(strstr(value, HTTP_CLOSE))
+			exchange->keepalive = false;
+		else if(strstr(value, HTTP_KEEP_ALIVE))
+			exchange->keepalive = true;
+		exchange->connection_upgrade = strstr(value, HTTP_UPGRADE_TOKEN) != NULL;
+	}
+
+	return true;
+}
+
+/**
+ * @brief   works out the response to a parsed request.
+ *
+ * sets the response header title and content type, and finds the API call, cached file,
+ * or opens the file that the response is made from.
+ *
+ * @param   complete should be false if the request header was not received in full.
+ * @param   path is memory for the file path, HTTP_PATH_LEN bytes long.
+ */
+void http_exchange_respond(httpserver_t* httpserver, http_exchange_t* exchange, bool complete, char* path)
+{
+	int length;
+	int variant = -1;
+	const char* content_type;
 
-    log_debug(&httpserver->log, "url %s", httpconn->url);
+    log_debug(&httpserver->log, "url %s", exchange->url);
 
 	// test for RPC
-	httpconn->api_call = http_api_check(httpserver->api, httpconn->url);
+	exchange->api_call = http_api_route(&httpserver->router, exchange->req_type, exchange->url, &exchange->params);
 	// set default response
-	httpconn->header = http_500_header_title;
-	httpconn->content_type = http_header_content_type_html;
+	http_exchange_status(exchange, 500);
+	exchange->content_type = http_header_content_type_html;
 
 	//*********************************
 	//*  determine response type
 	//*********************************
-	if(!httpconn->req_type)
+	if(!exchange->req_type || !complete)
 	{
 		log_error(&httpserver->log, http_501_header_title);
-		httpconn->header = http_501_header_title;
-		httpconn->content_type = http_header_content_type_html;
+		http_exchange_status(exchange, 501);
+		exchange->content_type = http_header_content_type_html;
+		// the rest of the request was not read
+		exchange->keepalive = false;
+	}
+	// the url is an API call, for other methods
+	else if(!exchange->params.allowed)
+	{
+		http_exchange_status(exchange, 405);
+		exchange->content_type = http_header_content_type_html;
 	}
 	// POST or GET response
-	else if((httpconn->req_type == (char*)HTTP_POST) || (httpconn->req_type == (char*)HTTP_GET))
+	else if((exchange->req_type == (char*)HTTP_POST) || (exchange->req_type == (char*)HTTP_GET))
 	{
 	    log_debug(&httpserver->log, "processing");
 		// change default response
-		httpconn->header = http_404_header_title;
-		httpconn->content_type = http_header_content_type_html;
+		http_exchange_status(exchange, 404);
+		exchange->content_type = http_header_content_type_html;
 
+		// prefer the precompressed variant of a file, unless it is known not to exist
+		if(!exchange->api_call && exchange->req_type == (char*)HTTP_GET)
+		{
+			variant = http_cache_gzip_lookup(&httpserver->cache, exchange->url);
+			exchange->gzip = exchange->accept_gzip && variant != 0;
+			exchange->vary = variant == 1;
+		}
+
+		// the websocket is served by the API call, once the handshake is complete
+		if(exchange->api_call && (exchange->api_call->flags & HTTP_API_WEBSOCKET))
+		{
+			exchange->keepalive = false;
+			if(exchange->req_type != (char*)HTTP_GET || !exchange->upgrade ||
+				!exchange->connection_upgrade || !exchange->websocket_key[0])
+				http_exchange_status(exchange, 400);
+			else if(exchange->websocket_version != HTTP_WEBSOCKET_VERSION)
+				http_exchange_status(exchange, 426);
+			else
+				http_exchange_status(exchange, 101);
+		}
 		// no file io needed for RPC
-		if(httpconn->api_call)
+		else if(exchange->api_call)
+		{
+			http_exchange_status(exchange, 202);
+			exchange->content_type = http_header_content_type_json;
+		}
+		// serve hot files from the cache, without any file io
+		else if(exchange->req_type == (char*)HTTP_GET &&
+				(exchange->cached = http_cache_get(&httpserver->cache, exchange->url, exchange->gzip)))
+		{
+			http_exchange_status(exchange, 200);
+			exchange->content_type = exchange->cached->content_type;
+			exchange->size = exchange->cached->length;
+		}
+		// without the length, the end of the body is not known, the file is left as it is
+		else if(exchange->req_type == (char*)HTTP_POST && !exchange->sized)
 		{
-			httpconn->header = http_202_header_title;
-			httpconn->content_type = http_header_content_type_json;
+			http_exchange_status(exchange, 411);
+			exchange->keepalive = false;
 		}
 		else
 		{
-			strcpy(httpconn->scratch, httpserver->fsroot);
+			http_exchange_path(httpserver, exchange, path);
 
-			// if the URL is just a "/" then change it to "/index.html"
-			if(httpconn->url[0] == HTTP_SLASH_CHAR && httpconn->url[1] == '\0')
-				strcat(httpconn->scratch, HTTP_INDEX_STR);
-			// prepend HTTPD_FS_ROOT path
-			else
-				strcat(httpconn->scratch, httpconn->url);
+			log_debug(&httpserver->log, "path: %s", path);
+
+			content_type = http_content_type(path);
 
-			log_debug(&httpserver->log, "path: %s", httpconn->scratch);
+			// look for the precompressed variant, name.gz
+			if(exchange->gzip)
+			{
+				length = strlen(path);
+				strcat(path, http_gz);
+				exchange->file = fopen(path, "r");
+				exchange->vary = exchange->file != NULL;
+				if(variant == -1)
+					http_cache_gzip_store(&httpserver->cache, exchange->url, exchange->vary);
+				if(!exchange->file)
+				{
+					path[length] = '\0';
+					exchange->gzip = false;
+				}
+			}
+			// the plain file is sent with Vary: Accept-Encoding when the variant exists
+			else if(variant == -1 && exchange->req_type == (char*)HTTP_GET)
+			{
+				length = strlen(path);
+				strcat(path, http_gz);
+				exchange->vary = stat(path, &exchange->stat) == 0;
+				http_cache_gzip_store(&httpserver->cache, exchange->url, exchange->vary);
+				path[length] = '\0';
+			}
 
-			httpconn->file = fopen(httpconn->scratch, httpconn->req_type == (char*)HTTP_POST ? "w" : "r");
+			if(!exchange->file)
+				exchange->file = fopen(path, exchange->req_type == (char*)HTTP_POST ? "w" : "r");
 
-			if(httpconn->file)
+			if(exchange->file)
 			{
-			    if(httpconn->req_type == (char*)HTTP_POST)
-			        httpconn->header = http_201_header_title;
+				exchange->content_type = content_type;
+			    if(exchange->req_type == (char*)HTTP_POST)
+			    {
+			        http_exchange_status(exchange, 201);
+			        if(exchange->content_length > 0)
+			        {
+			            // one contiguous block on the disk, rather than a cluster at a time as the file grows
+			            posix_fallocate(fileno(exchange->file), 0, exchange->content_length);
+			            // without the buffer, the body is written through the smaller connection buffer
+			            exchange->upload = malloc(HTTP_UPLOAD_LEN);
+			        }
+			    }
 			    else
-			        httpconn->header = http_200_header_title;
-
-				// find the file extension
-				httpconn->content_type = strrchr(httpconn->scratch, HTTP_DOT_CHAR);
-				if(!httpconn->content_type)
-					httpconn->content_type = http_header_content_type_binary;
-				else if(!strncmp(http_html, httpconn->content_type, sizeof(http_html)) ||
-						!strncmp(http_shtml, httpconn->content_type, sizeof(http_shtml)))
-					httpconn->content_type = http_header_content_type_html;
-				else if(!strncmp(http_css, httpconn->content_type, sizeof(http_css)))
-					httpconn->content_type = http_header_content_type_css;
-				else if(!strncmp(http_png, httpconn->content_type, sizeof(http_png)))
-					httpconn->content_type = http_header_content_type_png;
-				else if(!strncmp(http_gif, httpconn->content_type, sizeof(http_gif)))
-					httpconn->content_type = http_header_content_type_gif;
-				else if(!strncmp(http_jpg, httpconn->content_type, sizeof(http_jpg)))
-					httpconn->content_type = http_header_content_type_jpg;
-				else if(!strncmp(http_json, httpconn->content_type, sizeof(http_json)))
-					httpconn->content_type = http_header_content_type_json;
-				else if(!strncmp(http_xml, httpconn->content_type, sizeof(http_xml)))
-					httpconn->content_type = http_header_content_type_xml;
-				else
-					httpconn->content_type = http_header_content_type_plain;
+			    {
+			        http_exchange_status(exchange, 200);
+			        // the file size is sent as the content length, fstat avoids opening the file again
+			        if(fstat(fileno(exchange->file), &exchange->stat) == -1)
+			            exchange->keepalive = false;
+			        else
+			        {
+			            exchange->size = exchange->stat.st_size;
+			            exchange->cached = http_cache_add(&httpserver->cache, exchange->url, exchange->gzip,
+			            		exchange->file, exchange->stat.st_size, exchange->content_type);
+			        }
+			    }
 			}
-			else if(httpconn->req_type == (char*)HTTP_POST)
+			else if(exchange->req_type == (char*)HTTP_POST)
 			{
-		        httpconn->header = http_500_header_title;
+		        http_exchange_status(exchange, 500);
 			}
 		}
 	}
 
+	// the client copy is current
+	if(exchange->cached && exchange->conditional && exchange->if_none_match == exchange->cached->etag)
+		http_exchange_status(exchange, 304);
+
+	exchange->length = exchange->size;
+
+	// serve part of a file
+	if(exchange->range && exchange->status == 200)
+	{
+		if(!http_exchange_range(exchange))
+			http_exchange_status(exchange, 416);
+		else
+		{
+			http_exchange_status(exchange, 206);
+			if(!exchange->cached && exchange->file && fseek(exchange->file, exchange->offset, SEEK_SET) != 0)
+				http_exchange_status(exchange, 500);
+		}
+	}
+
+	// an unread POST body would be taken as the next request
+	if(exchange->req_type == (char*)HTTP_POST && exchange->content_length > 0 && !exchange->file && !exchange->api_call)
+		exchange->keepalive = false;
+
+	// the file may have opened before the response failed, the error page is plain html
+	if(http_exchange_error(exchange))
+	{
+		exchange->content_type = http_header_content_type_html;
+		exchange->gzip = false;
+		log_error(&httpserver->log, (char*)exchange->header);
+	}
+
+    log_debug(&httpserver->log, "responding to %s request", exchange->req_type);
+}
+
+/**
+ * @retval  returns true if the response is an error page.
+ */
+bool http_exchange_error(http_exchange_t* exchange)
+{
+	return exchange->status >= 400;
+}
+
+/**
+ * @brief   applies the requested byte range to the content size.
+ * @retval  returns false if the range can not be satisfied.
+ */
+static bool http_exchange_range(http_exchange_t* exchange)
+{
+	long size = exchange->size;
+	long first = exchange->range_first;
+	long last = exchange->range_last;
+
+	// the last bytes of the content
+	if(first < 0)
+	{
+		if(last <= 0)
+			return false;
+		first = last < size ? size - last : 0;
+		last = size - 1;
+	}
+	else if(last < 0 || last >= size)
+		last = size - 1;
+
+	if(first > last)
+		return false;
+
+	exchange->offset = first;
+	exchange->length = last - first + 1;
+	return true;
+}
+
+/**
+ * @brief   appends a formatted field to the response header.
+ *
+ * once the header has overflowed the buffer nothing more is written.
+ *
+ * @retval  returns the new length of the header, size or more if it has overflowed.
+ */
+static int http_header_field(char* buffer, int size, int length, const char* format, ...)
+{
+	va_list args;
+
+	if(length < 0 || length >= size)
+		return size;
+
+	va_start(args, format);
+	length += vsnprintf(buffer + length, size - length, format, args);
+	va_end(args);
+
+	return length;
+}
+
+/**
+ * @brief   formats the response header.
+ *
+ * a cached file is sent with its precomputed header, and field is ignored.
+ *
+ * @param   buffer is where the header is formatted, at least HTTP_SCRATCH_LEN bytes long.
+ * @param   field is HTTP_CONTENT_LENGTH, HTTP_TRANSFER_ENCODING, HTTP_ETAG, or NULL when the
+ *          body is delimited by closing the connection.
+ * @param   value is the content length for HTTP_CONTENT_LENGTH, or the entity tag for HTTP_ETAG.
+ * @retval  returns the length of the header, or -1 if it did not fit in size bytes,
+ *          see http_exchange_overflow().
+ */
+int http_exchange_header(http_exchange_t* exchange, char* buffer, int size, const char* field, uint32_t value)
+{
+	int length;
+
+	if(exchange->cached && exchange->status == 200)
+	{
+		if(exchange->cached->header_length >= size)
+			return -1;
+		memcpy(buffer, exchange->cached->header, exchange->cached->header_length);
+		length = exchange->cached->header_length;
+		// the gzip variant may be found after the plain file was cached
+		if(!exchange->gzip && exchange->vary)
+			length = http_header_field(buffer, size, length, http_vary_field);
+	}
+	else
+	{
+		length = http_header_field(buffer, size, 0, http_response_header, exchange->header, exchange->content_type);
+
+		// the field string may be a copy from another module, so compare its content
+		if(field && !strcmp(field, HTTP_CONTENT_LENGTH))
+			length = http_header_field(buffer, size, length, HTTP_CONTENT_LENGTH "%lu" HTTP_EOL, (unsigned long)value);
+		else if(field && !strcmp(field, HTTP_TRANSFER_ENCODING))
+			length = http_header_field(buffer, size, length, HTTP_TRANSFER_ENCODING HTTP_CHUNKED HTTP_EOL);
+		else if(field && !strcmp(field, HTTP_ETAG))
+			length = http_header_field(buffer, size, length, http_etag_field, (unsigned long)value);
+
+		if(exchange->status == 206)
+			length = http_header_field(buffer, size, length, http_content_range_field,
+					(unsigned long)exchange->offset, (unsigned long)(exchange->offset + exchange->length - 1), (unsigned long)exchange->size);
+		else if(exchange->status == 416)
+			length = http_header_field(buffer, size, length, http_unsatisfied_range_field, (unsigned long)exchange->size);
+		else if(exchange->status == 426)
+			length = http_header_field(buffer, size, length, http_websocket_version_field, HTTP_WEBSOCKET_VERSION);
+
+		if(exchange->status == 206 ||
+			(exchange->status == 200 && exchange->file && exchange->req_type == (char*)HTTP_GET))
+			length = http_header_field(buffer, size, length, http_accept_ranges_field);
+
+		if(exchange->gzip)
+			length = http_header_field(buffer, size, length, http_gzip_fields);
+		else if(exchange->vary)
+			length = http_header_field(buffer, size, length, http_vary_field);
+	}
+
+	length = http_header_field(buffer, size, length, http_response_connection,
+			exchange->keepalive ? HTTP_KEEP_ALIVE : HTTP_CLOSE);
+
+	return length < size ? length : -1;
+}
+
+/**
+ * @brief   fails the response when its header did not fit in the buffer.
+ *
+ * the response is changed to a 500 error with no body, that closes the connection.
+ *
+ * @param   buffer is where the header is formatted, at least HTTP_SCRATCH_LEN bytes long.
+ * @retval  returns the length of the 500 response header, or -1 if even that did not fit.
+ */
+int http_exchange_overflow(http_exchange_t* exchange, char* buffer, int size)
+{
+	http_exchange_status(exchange, 500);
+	exchange->content_type = http_header_content_type_html;
+	exchange->keepalive = false;
+	exchange->gzip = false;
+	exchange->vary = false;
+
+	return http_exchange_header(exchange, buffer, size, HTTP_CONTENT_LENGTH, 0);
+}
+
+/**
+ * @brief   reads the next piece of the file served, up to the end of the requested range.
+ * @retval  returns the number of bytes read, 0 at the end.
+ */
+int http_exchange_read(http_exchange_t* exchange, char* buffer, int size)
+{
+	// without the file size, read to the end of the file
+	if(exchange->size && exchange->length < (uint32_t)size)
+		size = exchange->length;
+
+	size = fread(buffer, 1, size, exchange->file);
+	if(size > 0)
+		exchange->length -= size;
+
+	return size;
+}
+
+/**
+ * @brief   receives the next piece of a POST body, and writes it to the file.
+ *
+ * the body is gathered in the upload buffer, and written in whole sectors, so that the file system
+ * writes straight to the disk. the CRC32 of the body is worked out as it arrives, and checked at
+ * the end if the request has an X-Content-CRC32 field. when the whole body is received,
+ * the response header title is set to 201, or to an error if the file was not written in full.
+ *
+ * @param   fdes is the connection socket.
+ * @param   buffer is used instead of the upload buffer, if it could not be allocated.
+ * @param   size is the size of buffer.
+ * @retval  returns the number of bytes received, or 0 or -1 if the connection closed, timed out,
+ *          or the file could not be written.
+ */
+int http_exchange_receive(http_exchange_t* exchange, int fdes, char* buffer, int size)
+{
+	int length;
+
+	if(exchange->upload)
+	{
+		buffer = exchange->upload;
+		size = HTTP_UPLOAD_LEN;
+	}
+
+	// do not read beyond the body, into the next request
+	length = size - exchange->uploaded;
+	if(exchange->content_length < length)
+		length = exchange->content_length;
+
+	length = recv(fdes, buffer + exchange->uploaded, length, 0);
+	if(length <= 0)
+		return length;
+
+	exchange->crc = http_crc32(exchange->crc, buffer + exchange->uploaded, length);
+	exchange->uploaded += length;
+	exchange->bytes_in += length;
+	exchange->content_length -= length;
+
+	if(exchange->uploaded == size || exchange->content_length == 0)
+	{
+		if((int)fwrite(buffer, 1, exchange->uploaded, exchange->file) != exchange->uploaded)
+		{
+			http_exchange_status(exchange, 500);
+			return -1;
+		}
+		exchange->uploaded = 0;
+	}
+
+	if(exchange->content_length == 0 && exchange->verify && exchange->crc != exchange->content_crc)
+		http_exchange_status(exchange, 400);
+
+	return length;
+}
+
+/**
+ * @brief   counts the bytes of the response sent, and notes when the response started.
+ * @param   length is the number of bytes sent, or the result of send().
+ */
+void http_exchange_sent(http_exchange_t* exchange, int length)
+{
+	if(!exchange->responded)
+	{
+		exchange->first_byte = xTaskGetTickCount();
+		exchange->responded = true;
+	}
+	if(length > 0)
+		exchange->bytes_out += length;
+}
+
+/**
+ * @brief   releases the cached file or closes the file served by the exchange.
+ *
+ * a POST file that was not received in full is removed. an exchange that was responded to
+ * is counted in the server metrics.
+ *
+ * @param   path is memory for the file path, HTTP_PATH_LEN bytes long.
+ */
+void http_exchange_finish(httpserver_t* httpserver, http_exchange_t* exchange, char* path)
+{
+	portTickType now;
+
+	if(exchange->responded)
+	{
+		// the API call reads the request body itself
+		if(exchange->api_call)
+			exchange->bytes_in += exchange->content_length;
+
+		now = xTaskGetTickCount();
+		http_metrics_count(http_metrics_route(&httpserver->metrics, exchange->api_call, exchange->file || exchange->cached),
+				exchange->status, exchange->bytes_in, exchange->bytes_out,
+				(exchange->first_byte - exchange->start) * portTICK_RATE_MS, (now - exchange->start) * portTICK_RATE_MS);
+		exchange->responded = false;
+	}
+
+	if(exchange->cached)
+	{
+		http_cache_release(&httpserver->cache, exchange->cached);
+		exchange->cached = NULL;
+	}
+
+	if(exchange->upload)
+	{
+		free(exchange->upload);
+		exchange->upload = NULL;
+	}
+
+	if(exchange->file)
+	{
+		fclose(exchange->file);
+		exchange->file = NULL;
+
+		// the cached copy of a written file is out of date
+		if(exchange->req_type == (char*)HTTP_POST)
+		{
+			if(exchange->content_length > 0 || exchange->status != 201)
+			{
+				http_exchange_path(httpserver, exchange, path);
+				log_error(&httpserver->log, "removing incomplete %s", path);
+				remove(path);
+			}
+
+			http_cache_invalidate(&httpserver->cache, exchange->url);
+			if(!strcmp(exchange->url, HTTP_INDEX_STR))
+				http_cache_invalidate(&httpserver->cache, HTTP_BASE_PAGE);
+		}
+	}
+}
+
+/**
+ * @brief   the HTTP server thread.
+ * Processes requests on a per connection basis. with HTTP/1.1 keep-alive,
+ * several requests may be served before the connection is closed.
+ */
+void http_server_connection(sock_conn_t* conn)
+{
+	httpserver_t* httpserver = (httpserver_t*)conn->ctx;
+	http_server_conn_t* httpconn = sock_pool_alloc(&httpserver->conn_pool);
+
+	if(!httpconn)
+	{
+		log_error(&httpserver->log, "no free connection, %lu refused", httpserver->conn_pool.exhausted);
+		return;
+	}
+
+	http_server_timeout(conn->connfd, HTTP_REQUEST_TIMEOUT);
+	http_server_nodelay(conn->connfd);
+
+	httpconn->requests = 0;
+
+	while(http_server_request(httpserver, conn, httpconn))
+	{
+		// wait for the next request on the idle connection
+		http_server_timeout(conn->connfd, httpserver->keepalive_timeout);
+	}
+
+	log_debug(&httpserver->log, "done, %d requests", httpconn->requests);
+
+	sock_pool_free(&httpserver->conn_pool, httpconn);
+}
+
+/**
+ * @brief   receives one request and sends the response.
+ * @retval  returns true if the connection should be kept open for another request.
+ */
+bool http_server_request(httpserver_t* httpserver, sock_conn_t* conn, http_server_conn_t* httpconn)
+{
+	http_exchange_t* exchange = &httpconn->exchange;
+	char* line;
+	int length;
+
+	http_exchange_init(exchange);
+
 	//*********************************
-	//  send response header
-	//*********************************
-	send(conn->connfd, http_header1, sizeof(http_header1)-1, 0);
-	send(conn->connfd, httpconn->header, strlen(httpconn->header), 0);
-	send(conn->connfd, http_header2, sizeof(http_header2)-1, 0);
-	send(conn->connfd, httpconn->content_type, strlen(httpconn->content_type), 0);
-	send(conn->connfd, HTTP_EOH, sizeof(HTTP_EOH)-1, 0);
+	//  receive request
+	//********************************
+	/**
+	 * After receiving a whole request header:
+	 *  - if a whole HTTP POST or GET is received, url contains the received url.
+     *  - if a whole HTTP POST is received, content_length holds the length of the outstanding message data.
+	 */
+	http_reader_init(&httpconn->reader, conn->connfd, httpconn->scratch, sizeof(httpconn->scratch));
+
+	while(1)
+	{
+		// receive up to the HTTP_EOL
+		line = http_reader_line(&httpconn->reader);
+		if(!line)
+		{
+			if(httpconn->requests == 0)
+				log_error(&httpserver->log, "aborting");
+			return false;
+		}
+
+		// check for end of header
+		if(!*line || !http_exchange_parse(exchange, line))
+			break;
+	}
 
-    log_debug(&httpserver->log, "sent header");
-    log_debug(&httpserver->log, "responding to %s request", httpconn->req_type);
+	// the first request is timed from when the connection was accepted
+	if(httpconn->requests == 0)
+		exchange->start = conn->accepted;
 
+	httpconn->requests++;
+	if(httpconn->requests >= httpserver->keepalive_requests)
+		exchange->keepalive = false;
+
+	http_exchange_respond(httpserver, exchange, http_reader_complete(&httpconn->reader), httpconn->scratch);
+
+	// the response to a POST file is known once the body is written
+	if(exchange->file && exchange->req_type == (char*)HTTP_POST)
+	{
+		log_debug(&httpserver->log, "write %s %ub", exchange->url, exchange->content_length);
+		while(exchange->content_length > 0)
+		{
+			if(http_exchange_receive(exchange, conn->connfd, httpconn->scratch, sizeof(httpconn->scratch)) <= 0)
+			{
+				if(exchange->status == 201)
+					http_exchange_status(exchange, 408);
+				exchange->keepalive = false;
+				break;
+			}
+		}
+	}
 
 	//*********************************
-	//  send response body
+	//  send response
 	//*********************************
 
 	// serve error message
-	if(httpconn->header != (char*)http_200_header_title &&
-	   httpconn->header != (char*)http_201_header_title &&
-       httpconn->header != (char*)http_202_header_title)
+	if(http_exchange_error(exchange))
 	{
-		log_error(&httpserver->log, (char*)httpconn->header);
-		snprintf(httpconn->scratch, sizeof(httpconn->scratch)-1, "oops...<br>%s: %s", httpconn->header, httpconn->url);
-		message_response(conn->connfd, httpconn->scratch);
+		snprintf(httpconn->scratch, sizeof(httpconn->scratch)-1, HTTP_ERROR_MESSAGE, exchange->header, exchange->url);
+		// the header is formatted in scratch too, so format the message again after it is sent
+		if(http_send_header(conn->connfd, httpconn, HTTP_CONTENT_LENGTH, message_response_length(httpconn->scratch)))
+		{
+			snprintf(httpconn->scratch, sizeof(httpconn->scratch)-1, HTTP_ERROR_MESSAGE, exchange->header, exchange->url);
+			message_response(conn->connfd, httpconn->scratch);
+			http_exchange_sent(exchange, message_response_length(httpconn->scratch));
+		}
 	}
-	// POST or GET, RPC response
-	else if(httpconn->api_call)
+	// not modified
+	else if(exchange->status == 304)
 	{
-        log_debug(&httpserver->log, "process API call");
-		http_api_process(httpconn->api_call, conn->connfd, httpconn->content_length, httpconn->scratch, sizeof(httpconn->scratch));
+		log_debug(&httpserver->log, "not modified %s", exchange->url);
+		http_send_header(conn->connfd, httpconn, HTTP_ETAG, exchange->cached->etag);
 	}
-	// POST file response
-	else if(httpconn->file && httpconn->req_type == (char*)HTTP_POST)
+	// GET cached file response
+	else if(exchange->cached)
 	{
-		log_debug(&httpserver->log, "write %s %ub", httpconn->scratch, httpconn->content_length);
-		while(httpconn->content_length)
+		log_debug(&httpserver->log, "cached %s", exchange->url);
+		if(http_send_header(conn->connfd, httpconn, HTTP_CONTENT_LENGTH, exchange->length))
 		{
-			httpconn->length = recv(conn->connfd, httpconn->scratch, sizeof(httpconn->scratch), 0);
-			if(httpconn->length)
-			{
-				fwrite(httpconn->scratch, 1, httpconn->length, httpconn->file);
-				httpconn->content_length -= httpconn->length;
-			}
+			length = send(conn->connfd, exchange->cached->content + exchange->offset, exchange->length, 0);
+			http_exchange_sent(exchange, length);
+			if(length != (int)exchange->length)
+				exchange->keepalive = false;
 		}
 	}
+	// websocket, served by the API call for as long as it likes
+	else if(exchange->status == 101)
+	{
+		log_debug(&httpserver->log, "websocket %s", exchange->url);
+		http_exchange_sent(exchange, 0);
+		if(http_websocket_handshake(&httpconn->websocket, conn->connfd, exchange->websocket_key, httpconn->scratch, sizeof(httpconn->scratch)))
+			http_api_websocket(exchange->api_call, &exchange->params, &httpconn->websocket, httpconn->scratch, sizeof(httpconn->scratch));
+	}
+	// POST or GET, RPC response
+	else if(exchange->api_call)
+	{
+        log_debug(&httpserver->log, "process API call");
+        if(exchange->api_call->flags & HTTP_API_CHUNKED)
+        {
+        	if(http_send_header(conn->connfd, httpconn, HTTP_TRANSFER_ENCODING, 0))
+        	{
+        		http_api_process(exchange->api_call, &exchange->params, conn->connfd, exchange->content_length, httpconn->scratch, sizeof(httpconn->scratch));
+        		http_api_write_chunk(conn->connfd, NULL, 0);
+        	}
+        }
+        else
+        {
+        	// the response length is only known by closing the connection
+        	exchange->keepalive = false;
+        	if(http_send_header(conn->connfd, httpconn, NULL, 0))
+        		http_api_process(exchange->api_call, &exchange->params, conn->connfd, exchange->content_length, httpconn->scratch, sizeof(httpconn->scratch));
+        }
+	}
+	// POST file response
+	else if(exchange->file && exchange->req_type == (char*)HTTP_POST)
+		http_send_header(conn->connfd, httpconn, HTTP_CONTENT_LENGTH, 0);
 	// GET file response
-	else if(httpconn->file && httpconn->req_type == (char*)HTTP_GET)
+	else if(exchange->file && exchange->req_type == (char*)HTTP_GET)
 	{
-		log_debug(&httpserver->log, "read %s", httpconn->scratch);
-		httpconn->length = sizeof(httpconn->scratch);
+		// without the content length, the body is delimited by closing the connection
+		httpconn->length = 0;
+		if(http_send_header(conn->connfd, httpconn,
+				exchange->keepalive || exchange->size ? HTTP_CONTENT_LENGTH : NULL, exchange->length))
+			httpconn->length = sizeof(httpconn->scratch);
+
+		log_debug(&httpserver->log, "read %s", exchange->url);
 		while(httpconn->length > 0)
 		{
-			httpconn->length = fread(httpconn->scratch, 1, sizeof(httpconn->scratch), httpconn->file);
-			if(httpconn->length > 0)
-				send(conn->connfd, httpconn->scratch, httpconn->length, 0);
+			httpconn->length = http_exchange_read(exchange, httpconn->scratch, sizeof(httpconn->scratch));
+			if(httpconn->length <= 0)
+				break;
+			length = send(conn->connfd, httpconn->scratch, httpconn->length, 0);
+			http_exchange_sent(exchange, length);
+			if(length != httpconn->length)
+			{
+				exchange->keepalive = false;
+				break;
+			}
 		}
 	}
 
-	if(httpconn->file)
-	{
-		fclose(httpconn->file);
-	}
-
-    log_debug(&httpserver->log, "done");
+	http_exchange_finish(httpserver, exchange, httpconn->scratch);
 
-	free(httpconn);
+	return exchange->keepalive;
 }
 
 /**
@@ -40,30 +40,117 @@
 #ifndef HTTP_HTTP_SERVER_H_
 #define HTTP_HTTP_SERVER_H_
 
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/stat.h>
 #include "threaded_server.h"
 #include "http_defs.h"
 #include "http_api.h"
+#include "http_websocket.h"
+#include "http_cache.h"
+#include "http_metrics.h"
 
 #define DEFAULT_HTTPSERVER_CONF_PATH		"/etc/http/httpd_config"
 #define DEFAULT_HTTPD_FS_ROOT				"/var/lib/httpd"
 #define HTTP_FS_ROOT_CONFIG_KEY				"fsroot"
+#define HTTP_KEEPALIVE_TIMEOUT_CONFIG_KEY   "keepalive_timeout"
+#define HTTP_KEEPALIVE_REQUESTS_CONFIG_KEY  "keepalive_requests"
 
 #define HTTP_FS_ROOT_LENGTH         32
 #define HTTP_URL_LEN                64
-#define HTTP_SCRATCH_LEN            256
+#define HTTP_SCRATCH_LEN            320     ///< holds the longest response header, about 280 bytes for a gzip range kept alive
+#define HTTP_UPLOAD_LEN             2048    ///< the POST file buffer, a multiple of the 512 byte sector size
+#define HTTP_PATH_LEN               (HTTP_FS_ROOT_LENGTH + HTTP_URL_LEN + sizeof(http_gz))
+
+#define HTTP_REQUEST_TIMEOUT        2000    ///< time in ms to wait for the first request on a new connection
+#define HTTP_KEEPALIVE_TIMEOUT      5000    ///< default time in ms to wait for another request on an idle connection
+#define HTTP_KEEPALIVE_REQUESTS     32      ///< default maximum number of requests served per connection
 
 #define HTTP_SERVER_STACK_SIZE      325
 #define HTTP_SERVER_TASK_PRIO       1
 
 typedef struct {
 	char fsroot[HTTP_FS_ROOT_LENGTH];
+	int keepalive_timeout;
+	int keepalive_requests;
+	http_cache_t cache;
 	sock_server_t server;
 	logger_t log;
 	const http_api_t** api;
+	http_api_router_t router;
+	sock_pool_t conn_pool;          ///< the connection contexts, one for each connection served at once
+	http_metrics_t metrics;         ///< the request counters, served by http_metrics_api
 }httpserver_t;
 
+/**
+ * the state of one request and its response, shared by the threaded and event driven servers.
+ */
+typedef struct {
+	const http_api_t* api_call;     ///< the API call that serves the url, or NULL
+	http_api_params_t params;       ///< the path parameters of the API call
+	const char* req_type;           ///< HTTP_GET, HTTP_POST, or NULL if not supported
+	int status;                     ///< the response status code, see http_exchange_status()
+	const char* header;             ///< the response header title
+	const char* content_type;       ///< the response content type
+	int content_length;             ///< the length of the request body
+	bool sized;                     ///< set if the request has a Content-Length field
+	bool keepalive;                 ///< set if the connection is kept open after the response
+	bool accept_gzip;               ///< set if the client accepts gzip content encoding
+	bool gzip;                      ///< set if the gzip compressed variant of a file is served
+	bool vary;                      ///< set if the file has a gzip compressed variant
+	bool conditional;               ///< set if the request has an If-None-Match field
+	uint32_t if_none_match;         ///< the entity tag of the client copy
+	bool range;                     ///< set if the request has a single byte range
+	long range_first;               ///< the first byte of the range, or -1 for the last range_last bytes
+	long range_last;                ///< the last byte of the range, or -1 for the rest of the content
+	uint32_t offset;                ///< the offset of the response body in the content
+	uint32_t length;                ///< the length of the response body
+	uint32_t size;                  ///< the size of the content served
+	http_cache_entry_t* cached;     ///< the cache entry served, or NULL
+	FILE* file;                     ///< the file served or written, or NULL
+	struct stat stat;               ///< the size of the file served
+	bool verify;                    ///< set if the request has an X-Content-CRC32 field
+	uint32_t content_crc;           ///< the CRC32 of the POST body, from the request
+	uint32_t crc;                   ///< the CRC32 of the POST body received so far
+	char* upload;                   ///< the POST file buffer, or NULL
+	int uploaded;                   ///< the length of the data in the POST file buffer
+	bool upgrade;                   ///< set if the client asks to upgrade to a websocket
+	bool connection_upgrade;        ///< set if the Connection field has the upgrade option
+	int websocket_version;          ///< the Sec-WebSocket-Version of the handshake, or 0
+	char websocket_key[HTTP_WEBSOCKET_KEY_LEN]; ///< the Sec-WebSocket-Key of the handshake
+	char url[HTTP_URL_LEN];         ///< the requested url
+	portTickType start;             ///< the tick count when the request arrived, or the connection was accepted
+	portTickType first_byte;        ///< the tick count when the first byte of the response was sent
+	bool responded;                 ///< set once the response is started
+	uint32_t bytes_in;              ///< the number of bytes of the request received
+	uint32_t bytes_out;             ///< the number of bytes of the response sent, except an API response body
+}http_exchange_t;
+
+/**
+ * the length of the page sent for an error message.
+ */
+#define message_response_length(message) (sizeof(text_page_header)-1 + strlen(message) + sizeof(text_page_footer)-1)
+
+#define HTTP_ERROR_MESSAGE "oops...<br>%s: %s"
+
 
 int init_http_server(httpserver_t* httpserver, char* configfile, const http_api_t** api);
+void http_server_configure(httpserver_t* httpserver, config_store_t* store, const http_api_t** api);
+const char* http_content_type(const char* path);
+void http_server_nodelay(int fdes);
+
+void http_exchange_init(http_exchange_t* exchange);
+void http_exchange_status(http_exchange_t* exchange, int status);
+bool http_exchange_parse(http_exchange_t* exchange, char* line);
+void http_exchange_respond(httpserver_t* httpserver, http_exchange_t* exchange, bool complete, char* path);
+bool http_exchange_error(http_exchange_t* exchange);
+int http_exchange_header(http_exchange_t* exchange, char* buffer, int size, const char* field, uint32_t value);
+int http_exchange_overflow(http_exchange_t* exchange, char* buffer, int size);
+int http_exchange_read(http_exchange_t* exchange, char* buffer, int size);
+int http_exchange_receive(http_exchange_t* exchange, int fdes, char* buffer, int size);
+void http_exchange_sent(http_exchange_t* exchange, int length);
+void http_exchange_finish(httpserver_t* httpserver, http_exchange_t* exchange, char* path);
 
 void split_hostname_and_port(const char* hostnameandport, char* hostname, unsigned short* port);
 
@@ -0,0 +1,472 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+* @addtogroup http
+*
+* @{
+* @file http_websocket.c
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include "http_defs.h"
+#include "http_websocket.h"
+
+#define HTTP_WEBSOCKET_GUID         "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+#define HTTP_WEBSOCKET_FIN          0x80
+#define HTTP_WEBSOCKET_MASK         0x80
+#define HTTP_WEBSOCKET_OPCODE       0x0F
+#define http_websocket_is_control(opcode)   ((opcode) & 0x08)
+
+#define sha1_rol(value, bits)   (((value) << (bits)) | ((value) >> (32 - (bits))))
+
+/**
+ * @brief   runs the SHA-1 compression function over the current block.
+ */
+static void http_websocket_sha1_block(http_websocket_sha1_t* sha1)
+{
+    // the message schedule is made in place of the block
+    uint32_t* w = sha1->block.words;
+    uint32_t a = sha1->state[0];
+    uint32_t b = sha1->state[1];
+    uint32_t c = sha1->state[2];
+    uint32_t d = sha1->state[3];
+    uint32_t e = sha1->state[4];
+    uint32_t f, k, t;
+    int i;
+
+    for(i = 0; i < 16; i++)
+        w[i] = (uint32_t)sha1->block.bytes[i*4] << 24 | (uint32_t)sha1->block.bytes[i*4+1] << 16 |
+               (uint32_t)sha1->block.bytes[i*4+2] << 8 | sha1->block.bytes[i*4+3];
+
+    for(i = 0; i < 80; i++)
+    {
+        // the message schedule is kept in a circular buffer of 16 words
+        if(i >= 16)
+            w[i & 15] = sha1_rol(w[(i+13) & 15] ^ w[(i+8) & 15] ^ w[(i+2) & 15] ^ w[i & 15], 1);
+
+        if(i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if(i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if(i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        t = sha1_rol(a, 5) + f + e + k + w[i & 15];
+        e = d;
+        d = c;
+        c = sha1_rol(b, 30);
+        b = a;
+        a = t;
+    }
+
+    sha1->state[0] += a;
+    sha1->state[1] += b;
+    sha1->state[2] += c;
+    sha1->state[3] += d;
+    sha1->state[4] += e;
+}
+
+static void http_websocket_sha1_update(http_websocket_sha1_t* sha1, const void* data, int length)
+{
+    const uint8_t* bytes = data;
+
+    while(length-- > 0)
+    {
+        sha1->block.bytes[sha1->length++ & 63] = *bytes++;
+        if((sha1->length & 63) == 0)
+            http_websocket_sha1_block(sha1);
+    }
+}
+
+/**
+ * @brief   the SHA-1 digest of the websocket key and the websocket GUID.
+ */
+static void http_websocket_sha1(http_websocket_sha1_t* sha1, const char* key, uint8_t* digest)
+{
+    static const uint32_t initial[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    uint32_t bits;
+    int i;
+
+    memcpy(sha1->state, initial, sizeof(sha1->state));
+    sha1->length = 0;
+
+    http_websocket_sha1_update(sha1, key, strlen(key));
+    http_websocket_sha1_update(sha1, HTTP_WEBSOCKET_GUID, sizeof(HTTP_WEBSOCKET_GUID)-1);
+
+    // pad with 0x80, zeros, and the 64 bit message length in bits
+    bits = sha1->length * 8;
+    http_websocket_sha1_update(sha1, "\x80", 1);
+    while((sha1->length & 63) != 56)
+        http_websocket_sha1_update(sha1, "", 1);
+    for(i = 0; i < 4; i++)
+        http_websocket_sha1_update(sha1, "", 1);
+    for(i = 3; i >= 0; i--)
+    {
+        uint8_t byte = bits >> (i * 8);
+        http_websocket_sha1_update(sha1, &byte, 1);
+    }
+
+    for(i = 0; i < 20; i++)
+        digest[i] = sha1->state[i/4] >> (24 - (i & 3) * 8);
+}
+
+/**
+ * @brief   base64 encodes data.
+ * @param   output must have space for 4 characters for every 3 bytes of data, plus the 0 terminator.
+ */
+static void http_websocket_base64(const uint8_t* data, int length, char* output)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uint32_t triple;
+    int i;
+
+    for(i = 0; i < length; i += 3)
+    {
+        triple = (uint32_t)data[i] << 16;
+        if(i + 1 < length)
+            triple |= (uint32_t)data[i+1] << 8;
+        if(i + 2 < length)
+            triple |= data[i+2];
+
+        *output++ = alphabet[(triple >> 18) & 0x3F];
+        *output++ = alphabet[(triple >> 12) & 0x3F];
+        *output++ = i + 1 < length ? alphabet[(triple >> 6) & 0x3F] : '=';
+        *output++ = i + 2 < length ? alphabet[triple & 0x3F] : '=';
+    }
+    *output = '\0';
+}
+
+/**
+ * @brief   receives exactly length bytes.
+ * @retval  returns false if the connection failed first.
+ */
+static bool http_websocket_recv_all(int fdes, void* buffer, int length)
+{
+    uint8_t* data = buffer;
+    int received;
+
+    while(length > 0)
+    {
+        received = recv(fdes, data, length, 0);
+        if(received <= 0)
+            return false;
+        data += received;
+        length -= received;
+    }
+    return true;
+}
+
+/**
+ * @brief   receives a frame payload and removes the mask.
+ */
+static bool http_websocket_recv_payload(int fdes, void* buffer, int length, const uint8_t* mask)
+{
+    uint8_t* data = buffer;
+    int i;
+
+    if(!http_websocket_recv_all(fdes, buffer, length))
+        return false;
+    for(i = 0; i < length; i++)
+        data[i] ^= mask[i & 3];
+    return true;
+}
+
+/**
+ * @brief   completes the websocket handshake, by sending the 101 response.
+ *
+ * the websocket state is initialised, ready for the API member flagged with HTTP_API_WEBSOCKET.
+ * it is called once the handshake is complete, and may keep the connection open for as long
+ * as it likes, pushing frames as data is ready:
+ *
+\code
+int live_data(http_websocket_t* websocket, const http_api_params_t* params, char* buffer, int size)
+{
+    while(!websocket->closed)
+    {
+        // wait up to 10ms for a message from the client, pings are answered in here
+        if(http_websocket_receive(websocket, buffer, size, 10) > 0)
+            ... handle the message
+        if(samples_ready())
+            http_websocket_send(websocket, HTTP_WEBSOCKET_BINARY, samples, sizeof(samples));
+    }
+    return 0;
+}
+\endcode
+ *
+ * @param   websocket is the state to initialise, kept with the connection.
+ * @param   fdes is the connection socket.
+ * @param   key is the value of the Sec-WebSocket-Key request header field.
+ * @param   buffer is some memory to format the response in.
+ * @param   size is the size of buffer.
+ * @retval  returns true if the response was sent.
+ */
+bool http_websocket_handshake(http_websocket_t* websocket, int fdes, const char* key, char* buffer, int size)
+{
+    uint8_t digest[20];
+    char accept[29];
+    int length;
+
+    http_websocket_init(websocket, fdes);
+    http_websocket_sha1(&websocket->work.sha1, key, digest);
+    http_websocket_base64(digest, sizeof(digest), accept);
+
+    length = snprintf(buffer, size, http_websocket_response, accept);
+    if(length >= size)
+        return false;
+
+    return send(fdes, buffer, length, 0) == length;
+}
+
+/**
+ * @brief   initialises the websocket state, see http_websocket_handshake().
+ *
+ * @param   websocket is the state to initialise.
+ * @param   fdes is the connection socket.
+ */
+void http_websocket_init(http_websocket_t* websocket, int fdes)
+{
+    int nodelay = 1;
+
+    websocket->fdes = fdes;
+    websocket->opcode = HTTP_WEBSOCKET_TEXT;
+    websocket->fin = true;
+    websocket->closed = false;
+
+    // small frames are sent as they are ready, rather than waiting for the last to be acknowledged
+    setsockopt(fdes, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+}
+
+/**
+ * @brief   sends one complete, unmasked frame.
+ *
+ * @param   websocket is the connection.
+ * @param   opcode is HTTP_WEBSOCKET_TEXT, HTTP_WEBSOCKET_BINARY, or a control frame opcode.
+ * @param   data is the payload.
+ * @param   length is the length of the payload.
+ * @retval  returns length, or -1 if the connection is closed or failed.
+ */
+int http_websocket_send(http_websocket_t* websocket, int opcode, const void* data, int length)
+{
+    uint8_t* frame = websocket->work.frame;
+    int header;
+
+    if(websocket->closed || length < 0)
+        return -1;
+
+    frame[0] = HTTP_WEBSOCKET_FIN | (opcode & HTTP_WEBSOCKET_OPCODE);
+    if(length < 126)
+    {
+        frame[1] = length;
+        header = 2;
+    }
+    else if(length < 65536)
+    {
+        frame[1] = 126;
+        frame[2] = length >> 8;
+        frame[3] = length;
+        header = 4;
+    }
+    else
+    {
+        frame[1] = 127;
+        memset(frame + 2, 0, 4);
+        frame[6] = length >> 24;
+        frame[7] = length >> 16;
+        frame[8] = length >> 8;
+        frame[9] = length;
+        header = 10;
+    }
+
+    // small frames go in one segment with their header, a pong payload is already in place
+    if(header + length <= HTTP_WEBSOCKET_FRAME_LEN)
+    {
+        if(length && data != frame + header)
+            memcpy(frame + header, data, length);
+        if(send(websocket->fdes, frame, header + length, 0) != header + length)
+            websocket->closed = true;
+    }
+    else if(send(websocket->fdes, frame, header, MSG_MORE) != header ||
+            send(websocket->fdes, data, length, 0) != length)
+        websocket->closed = true;
+
+    return websocket->closed ? -1 : length;
+}
+
+/**
+ * @brief   receives the next data frame.
+ *
+ * ping frames are answered with a pong, and a close frame is answered and closes the connection.
+ * the opcode of a data frame is left in websocket->opcode, and websocket->fin is set
+ * on the last frame of a message.
+ *
+ * @param   websocket is the connection.
+ * @param   buffer is memory for the frame payload.
+ * @param   size is the size of buffer. larger frames close the connection.
+ * @param   timeout is the time in ms to wait for a frame to start, 0 to take only a frame that
+ *          has started to arrive, or -1 to wait forever.
+ * @retval  returns the length of the data frame, 0 if none arrived in time,
+ *          or -1 if the connection is closed.
+ */
+int http_websocket_receive(http_websocket_t* websocket, void* buffer, int size, int timeout)
+{
+    struct pollfd pollfd = {.fd = websocket->fdes, .events = POLLIN};
+    // a control payload is received where the payload of the reply is sent from, after its 2 byte header
+    uint8_t* control = websocket->work.frame + 2;
+    uint8_t header[HTTP_WEBSOCKET_HEADER_LEN];
+    uint8_t* mask;
+    uint32_t length;
+    int opcode;
+
+    while(!websocket->closed)
+    {
+        if(poll(&pollfd, 1, timeout) <= 0)
+            return 0;
+        // take only frames that are waiting, once a control frame has been handled
+        timeout = 0;
+
+        if(!http_websocket_recv_all(websocket->fdes, header, 2))
+            break;
+
+        opcode = header[0] & HTTP_WEBSOCKET_OPCODE;
+        length = header[1] & 0x7F;
+        mask = header + 2;
+
+        // client frames must be masked
+        if(!(header[1] & HTTP_WEBSOCKET_MASK))
+        {
+            http_websocket_close(websocket, HTTP_WEBSOCKET_CLOSE_PROTOCOL);
+            break;
+        }
+
+        if(length == 126)
+        {
+            if(!http_websocket_recv_all(websocket->fdes, header + 2, 2))
+                break;
+            length = (uint32_t)header[2] << 8 | header[3];
+            mask = header + 4;
+        }
+        else if(length == 127)
+        {
+            if(!http_websocket_recv_all(websocket->fdes, header + 2, 8))
+                break;
+            length = (uint32_t)header[6] << 24 | (uint32_t)header[7] << 16 | (uint32_t)header[8] << 8 | header[9];
+            mask = header + 10;
+            if(header[2] | header[3] | header[4] | header[5])
+                length = UINT32_MAX;
+        }
+
+        if(!http_websocket_recv_all(websocket->fdes, mask, 4))
+            break;
+
+        if(http_websocket_is_control(opcode))
+        {
+            if(length > HTTP_WEBSOCKET_CONTROL_LEN)
+            {
+                http_websocket_close(websocket, HTTP_WEBSOCKET_CLOSE_PROTOCOL);
+                break;
+            }
+            if(!http_websocket_recv_payload(websocket->fdes, control, length, mask))
+                break;
+
+            if(opcode == HTTP_WEBSOCKET_PING)
+                http_websocket_send(websocket, HTTP_WEBSOCKET_PONG, control, length);
+            else if(opcode == HTTP_WEBSOCKET_CLOSE)
+            {
+                // echo the status of the client
+                http_websocket_send(websocket, HTTP_WEBSOCKET_CLOSE, control, length < 2 ? length : 2);
+                websocket->closed = true;
+            }
+            continue;
+        }
+
+        if(length > (uint32_t)size)
+        {
+            http_websocket_close(websocket, HTTP_WEBSOCKET_CLOSE_TOO_BIG);
+            break;
+        }
+        if(!http_websocket_recv_payload(websocket->fdes, buffer, length, mask))
+            break;
+
+        // continuation frames keep the opcode of the message
+        if(opcode != HTTP_WEBSOCKET_CONTINUATION)
+            websocket->opcode = opcode;
+        websocket->fin = (header[0] & HTTP_WEBSOCKET_FIN) != 0;
+
+        return length;
+    }
+
+    websocket->closed = true;
+    return -1;
+}
+
+/**
+ * @brief   sends a ping, the pong is taken by http_websocket_receive().
+ * @retval  returns 0, or -1 if the connection is closed or failed.
+ */
+int http_websocket_ping(http_websocket_t* websocket)
+{
+    return http_websocket_send(websocket, HTTP_WEBSOCKET_PING, NULL, 0);
+}
+
+/**
+ * @brief   sends a close frame, after which nothing more may be sent.
+ * @param   status is the close status, HTTP_WEBSOCKET_CLOSE_NORMAL for example.
+ */
+void http_websocket_close(http_websocket_t* websocket, int status)
+{
+    uint8_t payload[2] = {status >> 8, status};
+
+    http_websocket_send(websocket, HTTP_WEBSOCKET_CLOSE, payload, sizeof(payload));
+    websocket->closed = true;
+}
+
+/**
+ * @}
+ */
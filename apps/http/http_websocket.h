@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+* @addtogroup http
+*
+* @{
+* @file http_websocket.h
+*/
+
+#ifndef HTTP_HTTP_WEBSOCKET_H_
+#define HTTP_HTTP_WEBSOCKET_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HTTP_WEBSOCKET_CONTINUATION     0x0
+#define HTTP_WEBSOCKET_TEXT             0x1
+#define HTTP_WEBSOCKET_BINARY           0x2
+#define HTTP_WEBSOCKET_CLOSE            0x8
+#define HTTP_WEBSOCKET_PING             0x9
+#define HTTP_WEBSOCKET_PONG             0xA
+
+#define HTTP_WEBSOCKET_CLOSE_NORMAL     1000    ///< close status, the endpoint is done
+#define HTTP_WEBSOCKET_CLOSE_GOING_AWAY 1001    ///< close status, the server is going away
+#define HTTP_WEBSOCKET_CLOSE_PROTOCOL   1002    ///< close status, a protocol error was received
+#define HTTP_WEBSOCKET_CLOSE_TOO_BIG    1009    ///< close status, a message was too big to receive
+
+#define HTTP_WEBSOCKET_KEY_LEN          32      ///< space for the Sec-WebSocket-Key value, 24 characters
+#define HTTP_WEBSOCKET_VERSION          13      ///< the Sec-WebSocket-Version supported
+#define HTTP_WEBSOCKET_HEADER_LEN       14      ///< the longest frame header, with a 64 bit length and mask
+#define HTTP_WEBSOCKET_CONTROL_LEN      125     ///< the longest control frame payload
+#define HTTP_WEBSOCKET_FRAME_LEN        (HTTP_WEBSOCKET_HEADER_LEN + HTTP_WEBSOCKET_CONTROL_LEN) ///< frames up to this size, with their header, are sent in one segment
+
+/**
+ * the SHA-1 state of the handshake.
+ */
+typedef struct {
+    uint32_t state[5];
+    uint32_t length;
+    union {
+        uint8_t bytes[64];
+        uint32_t words[16];     ///< the block as big endian words, then the message schedule
+    }block;
+}http_websocket_sha1_t;
+
+/**
+ * the state of one websocket connection, see http_websocket_handshake().
+ * it holds the buffers for control frames and small frames, so belongs with the
+ * connection rather than on the stack of the task serving it.
+ */
+typedef struct {
+    int fdes;           ///< the connection socket
+    int opcode;         ///< the opcode of the last data frame received, HTTP_WEBSOCKET_TEXT or HTTP_WEBSOCKET_BINARY
+    bool fin;           ///< set if the last data frame received ended its message
+    bool closed;        ///< set when the connection is closed, nothing more may be sent
+    union {
+        uint8_t frame[HTTP_WEBSOCKET_FRAME_LEN];    ///< a control frame, or a small frame with its header
+        http_websocket_sha1_t sha1;                 ///< the digest of the handshake key
+    }work;
+}http_websocket_t;
+
+bool http_websocket_handshake(http_websocket_t* websocket, int fdes, const char* key, char* buffer, int size);
+void http_websocket_init(http_websocket_t* websocket, int fdes);
+int http_websocket_send(http_websocket_t* websocket, int opcode, const void* data, int length);
+int http_websocket_receive(http_websocket_t* websocket, void* buffer, int size, int timeout);
+int http_websocket_ping(http_websocket_t* websocket);
+void http_websocket_close(http_websocket_t* websocket, int status);
+
+#endif /* HTTP_HTTP_WEBSOCKET_H_ */
+
+/**
+ * @}
+ */
@@ -34,6 +34,7 @@
 #include "net_cmds.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <libgen.h>
 #include <stdio.h>
 #include <fcntl.h>
@@ -48,6 +49,7 @@
 #include "lwip/inet.h"
 #include "net.h"
 #include "http_client.h"
+#include "sock_utils.h"
 
 
 #define HTTP_STATUS_ERROR               "http status: %d"SHELL_NEWLINE
@@ -55,12 +57,14 @@
 #define URL_ERROR                       "url not specified"SHELL_NEWLINE
 #define MEMORY_ERROR                    "error allocating memory for command"SHELL_NEWLINE
 #define NETSTAT_HEADER                  "Proto\tLocal Address\t\tForeign Address\t\tState"SHELL_NEWLINE
+#define DNS_HEADER                      "Host\t\t\t\tAddress\t\tTTL(ms)\tHits"SHELL_NEWLINE
 
 
 shell_cmd_t* install_net_cmds(shellserver_t* sh)
 {
     register_command(sh, &sh_netstat_cmd, NULL, NULL, NULL);
     register_command(sh, &sh_ifconfig_cmd, NULL, NULL, NULL);
+    register_command(sh, &sh_dns_cmd, NULL, NULL, NULL);
     return register_command(sh, &sh_wget_cmd, NULL, NULL, NULL);
 }
 
@@ -68,7 +72,8 @@ int sh_wget(int fdes, const char** args, unsigned char nargs)
 {
     logger_t log;
     char* buffer = malloc(128);
-    char* url = (char*)arg_by_index(1, args, nargs);
+    char* url = (char*)final_arg(args, nargs);
+    bool resume = has_switch("-c", args, nargs);
     char* file;
     http_response_t resp;
     int status;
@@ -77,20 +82,22 @@ int sh_wget(int fdes, const char** args, unsigned char nargs)
 
     if(buffer)
     {
-        if(url)
+        if(url && strcmp(url, "-c"))
         {
             file = basename(url);
 
             if(file && file)
             {
-                unlink(file);
+                if(!resume)
+                    unlink(file);
 
-                if(!http_get_file(url, &resp, file, buffer, 128))
+                if(!http_get_file(url, &resp, file, buffer, 128, resume))
                     write(fdes, GET_ERROR, sizeof(GET_ERROR)-1);
                 status = resp.status;
 
-                // fail if we didnt get the 200 OK. using the buffer here may overwrite the http header info.
-                if(status != 200)
+                // fail if we didnt get the 200 OK, or 206 Partial Content or 416 when the file was complete, on resume.
+                // using the buffer here may overwrite the http header info.
+                if(status != 200 && !(resume && (status == 206 || status == 416)))
                 {
                     sprintf(buffer, HTTP_STATUS_ERROR, status);
                     write(fdes, buffer, strlen(buffer));
@@ -200,6 +207,42 @@ int sh_ifconfig(int fdes, const char** args, unsigned char nargs)
     return SHELL_CMD_EXIT;
 }
 
+int sh_dns(int fdes, const char** args, unsigned char nargs)
+{
+    char buffer[80];
+    int i;
+    int length;
+    int ttl;
+    const char* ip;
+    sock_dns_entry_t entry;
+
+    if(has_switch("-f", args, nargs))
+    {
+        sock_dns_cache_flush();
+        return SHELL_CMD_EXIT;
+    }
+
+    write(fdes, DNS_HEADER, sizeof(DNS_HEADER)-1);
+
+    for(i = 0; i < SOCK_DNS_CACHE_SIZE; i++)
+    {
+        ttl = sock_dns_cache_entry(i, &entry);
+        if(ttl > 0)
+        {
+            ip = (const char*)&entry.addr.s_addr;
+            if(entry.resolved)
+                length = snprintf(buffer, sizeof(buffer), "%-32s%d.%d.%d.%d\t%d\t%lu"SHELL_NEWLINE,
+                        entry.host, ip[0],ip[1],ip[2],ip[3], ttl, entry.hits);
+            else
+                length = snprintf(buffer, sizeof(buffer), "%-32sunresolved\t%d\t%lu"SHELL_NEWLINE,
+                        entry.host, ttl, entry.hits);
+            write(fdes, buffer, length);
+        }
+    }
+
+    return SHELL_CMD_EXIT;
+}
+
 shell_cmd_t sh_netstat_cmd = {
 		.name = "netstat",
 		.usage = "prints network connection info",
@@ -212,10 +255,19 @@ shell_cmd_t sh_ifconfig_cmd = {
         .cmdfunc = sh_ifconfig
 };
 
+shell_cmd_t sh_dns_cmd = {
+        .name = "dns",
+        .usage = "prints the host names cached by the resolver"SHELL_NEWLINE \
+        "dns [-f]"SHELL_NEWLINE \
+        "-f    flush the cache",
+        .cmdfunc = sh_dns
+};
+
 shell_cmd_t sh_wget_cmd = {
         .name = "wget",
         .usage = "very basic wget implementation. saves the url endpoint to the cwd."SHELL_NEWLINE \
-        "wget [url]",
+        "wget [-c] [url]"SHELL_NEWLINE \
+        "-c    continue a partially downloaded file",
         .cmdfunc = sh_wget
 };
 
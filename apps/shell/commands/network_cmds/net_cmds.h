@@ -39,6 +39,7 @@
 extern shell_cmd_t sh_netstat_cmd;
 extern shell_cmd_t sh_ifconfig_cmd;
 extern shell_cmd_t sh_wget_cmd;
+extern shell_cmd_t sh_dns_cmd;
 
 
 shell_cmd_t* install_net_cmds(shellserver_t* sh);
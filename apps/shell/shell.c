@@ -73,7 +73,10 @@
  * 	- to use the threaded server ENABLE_LIKEPOSIX_SOCKETS must be set to 1 in likeposix_config.h
  * 	- shells share the global current working directory
  * 	- the shell_instance() function allocates a shell_instance_t which will be around 768bytes
- *  	when SHELL_HISTORY_LENGTH is set to 4, around 256bytes when SHELL_HISTORY_LENGTH is set to 0.
+ *  	when SHELL_HISTORY_LENGTH is set to 4, around 256bytes when SHELL_HISTORY_LENGTH is set to 0,
+ *  	plus the SHELL_READ_BUFFER_SIZE and SHELL_WRITE_BUFFER_SIZE input and output buffers.
+ * 	- input from sockets and files is read a block at a time. input typed ahead of a command
+ * 		is held by the shell, and is not seen by the command.
  *  - shell commands must not delete the shell thread - this will result in memory leaks.
  * 	- shells support user defined and built in commands, registered via the register_command() function.
  * 	- shells support running command(s) from within files, as shell scripts. when a filename is specified
@@ -105,6 +108,7 @@
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <stdint.h>
 #ifdef USE_MINLIBC
 #include "minlibc/stdio.h"
@@ -153,6 +157,12 @@ typedef struct {
 	struct stat sstat;
 	shell_input_t input_cmd;
 	bool exit_on_eof;
+	bool read_block;								///< set if rdfd returns what is available, rather than blocking for the whole count
+	uint16_t read_index;							///< the index of the next character in read_buffer
+	uint16_t read_length;							///< the number of characters in read_buffer
+	uint16_t write_length;							///< the number of characters in write_buffer
+	char read_buffer[SHELL_READ_BUFFER_SIZE];		///< input read from rdfd, not yet processed
+	char write_buffer[SHELL_WRITE_BUFFER_SIZE];		///< output for wrfd, not yet written
 }shell_instance_t;
 
 
@@ -171,6 +181,9 @@ static void close_output_file(shell_instance_t* shell_inst);
 static bool open_input_file(shell_instance_t* shell_inst);
 static char close_input_file(shell_instance_t* shell_inst, char input_char);
 static void make_prompt();
+static int shell_read(shell_instance_t* shell_inst, unsigned char* input_char);
+static void shell_write(shell_instance_t* shell_inst, const char* data, int length);
+static void shell_flush(shell_instance_t* shell_inst);
 
 static void shell_backspace(shell_instance_t* shell_inst);
 static void shell_delete(shell_instance_t* shell_inst, char code);
@@ -268,6 +281,8 @@ int start_shell_threaded_server(shellserver_t* shell, shell_cmd_t* commandset, c
     shell->wrfd = wrfd;
     shell->exit_on_eof = exit_on_eof;
     shell->server.conns = 0;
+    shell->server.workers = 0;
+    shell->server.queue = 0;
     shell->server.port = 0;
     shell->server.stacksize = stack_size ? stack_size : SHELL_TASK_STACK_SIZE;
     shell->server.prio = SHELL_TASK_PRIORITY;
@@ -400,6 +415,14 @@ void shell_instance(shellserver_t* shell, const char* inputstr)
 		shell_inst->wrfd = shell->wrfd;
 		shell_inst->rdfd_hold = -1;
 		shell_inst->wrfd_hold = -1;
+		shell_inst->read_index = 0;
+		shell_inst->read_length = 0;
+		shell_inst->write_length = 0;
+
+		// sockets and files return what is available, devices block for the whole count
+		shell_inst->read_block = !fstat(shell_inst->rdfd, &shell_inst->sstat) &&
+				(S_ISSOCK(shell_inst->sstat.st_mode) || S_ISREG(shell_inst->sstat.st_mode));
+
 		shell_inst->sstat.st_size = 0;
 		shell_inst->sstat.st_mode = 0;
 		shell_inst->exit_on_eof = shell->exit_on_eof;
@@ -436,7 +459,7 @@ void prompt(shell_instance_t* shell_inst, const char* inputstr)
 	            ret = -1;
 	    }
 	    else
-	        ret = read(shell_inst->rdfd, &input_char, 1);
+	        ret = shell_read(shell_inst, &input_char);
 
 		if(inject == '\0' && ret < 0)
 			shell_inst->exitflag = true;
@@ -461,16 +484,16 @@ void prompt(shell_instance_t* shell_inst, const char* inputstr)
 			if(input_char == 0x1B || input_char == 195) // ESC or
 			{
 				input_char = 0;
-				read(shell_inst->rdfd, &input_char, 1);
+				shell_read(shell_inst, &input_char);
 				if(input_char == 0x5B || input_char == 160)	// ANSI escaped sequences, ascii '['
 				{
 					input_char = 0;
-					read(shell_inst->rdfd, &input_char, 1);
+					shell_read(shell_inst, &input_char);
 
 					if(input_char == 0x33) // ascii '3'
 					{
 						input_char = 0;
-						read(shell_inst->rdfd, &input_char, 1);
+						shell_read(shell_inst, &input_char);
 
 						if(input_char == 0x7E) // DELETE, ascii '~'
 						{
@@ -505,7 +528,7 @@ void prompt(shell_instance_t* shell_inst, const char* inputstr)
 				else if(input_char == 0x4F)	// HOME, END
 				{
 					input_char = 0;
-					read(shell_inst->rdfd, &input_char, 1);
+					shell_read(shell_inst, &input_char);
 
 					if(input_char == 0x48) // HOME
 					{
@@ -529,6 +552,7 @@ void prompt(shell_instance_t* shell_inst, const char* inputstr)
 				{
 					// run the command, passing the arguments to it
 					// use args[1] as args[0] points to the command
+					shell_flush(shell_inst);
 					code = shell_cmd_exec(shell_inst->input_cmd.cmd, shell_inst->wrfd, shell_inst->input_cmd.args, shell_inst->input_cmd.nargs);
 					return_code_catcher(shell_inst, code);
 
@@ -575,17 +599,82 @@ void prompt(shell_instance_t* shell_inst, const char* inputstr)
 						put_prompt(shell_inst, NULL, true);
 					}
 
-					write(shell_inst->wrfd, &shell_inst->input_buffer[shell_inst->cursor_index-1], strlen((const char*)&shell_inst->input_buffer[shell_inst->cursor_index-1]));
+					shell_write(shell_inst, &shell_inst->input_buffer[shell_inst->cursor_index-1], strlen((const char*)&shell_inst->input_buffer[shell_inst->cursor_index-1]));
 
 					// put cursor back where it should be
 					for(i = shell_inst->input_index; i > shell_inst->cursor_index; i--)
 					{
-						write(shell_inst->wrfd, SHELL_LEFTARROW, sizeof(SHELL_LEFTARROW)-1);
+						shell_write(shell_inst, SHELL_LEFTARROW, sizeof(SHELL_LEFTARROW)-1);
 					}
 				}
 			}
 		}
 	}
+
+	shell_flush(shell_inst);
+}
+
+/**
+ * reads one character of input.
+ *
+ * input is read a block at a time into the read buffer when rdfd returns what is available,
+ * so pasted text is not read a byte per call. the output is flushed before waiting for more input.
+ * shell scripts are read a character at a time, as the end of the script is found by its position.
+ *
+ * @param   input_char is set to the character read.
+ * @retval  returns 1, or the value returned by read() when no character was read.
+ */
+int shell_read(shell_instance_t* shell_inst, unsigned char* input_char)
+{
+	int ret;
+
+	if(shell_inst->rdfs)
+		return read(shell_inst->rdfd, input_char, 1);
+
+	if(shell_inst->read_index == shell_inst->read_length)
+	{
+		shell_flush(shell_inst);
+
+		ret = read(shell_inst->rdfd, shell_inst->read_buffer, shell_inst->read_block ? sizeof(shell_inst->read_buffer) : 1);
+		if(ret <= 0)
+			return ret;
+
+		shell_inst->read_index = 0;
+		shell_inst->read_length = ret;
+	}
+
+	*input_char = shell_inst->read_buffer[shell_inst->read_index++];
+	return 1;
+}
+
+/**
+ * adds output to the write buffer, writing the buffer out when it is full.
+ */
+void shell_write(shell_instance_t* shell_inst, const char* data, int length)
+{
+	if(shell_inst->write_length + length > (int)sizeof(shell_inst->write_buffer))
+		shell_flush(shell_inst);
+
+	if(length > (int)sizeof(shell_inst->write_buffer))
+		write(shell_inst->wrfd, data, length);
+	else
+	{
+		memcpy(shell_inst->write_buffer + shell_inst->write_length, data, length);
+		shell_inst->write_length += length;
+	}
+}
+
+/**
+ * writes out the write buffer. must be called before anything else writes to wrfd,
+ * and before wrfd is changed.
+ */
+void shell_flush(shell_instance_t* shell_inst)
+{
+	if(shell_inst->write_length > 0)
+	{
+		write(shell_inst->wrfd, shell_inst->write_buffer, shell_inst->write_length);
+		shell_inst->write_length = 0;
+	}
 }
 
 void shell_backspace(shell_instance_t* shell_inst)
@@ -609,7 +698,7 @@ void shell_backspace(shell_instance_t* shell_inst)
 		// put cursor back where it should be
 		for(i = shell_inst->input_index; i > shell_inst->cursor_index; i--)
 		{
-			write(shell_inst->wrfd, SHELL_LEFTARROW, sizeof(SHELL_LEFTARROW)-1);
+			shell_write(shell_inst, SHELL_LEFTARROW, sizeof(SHELL_LEFTARROW)-1);
 		}
 	}
 }
@@ -635,7 +724,7 @@ void shell_delete(shell_instance_t* shell_inst, char code)
 		// put cursor back where it should be
 		for(i = shell_inst->input_index; i > shell_inst->cursor_index; i--)
 		{
-			write(shell_inst->wrfd, arrow, strlen(arrow));
+			shell_write(shell_inst, arrow, strlen(arrow));
 		}
 	}
 }
@@ -662,7 +751,7 @@ void shell_left(shell_instance_t* shell_inst, char code)
 	if(shell_inst->cursor_index > 0)
 	{
 		shell_inst->cursor_index--;
-		write(shell_inst->wrfd, arrow, strlen(arrow));
+		shell_write(shell_inst, arrow, strlen(arrow));
 	}
 }
 
@@ -672,7 +761,7 @@ void shell_right(shell_instance_t* shell_inst, char code)
 	if(shell_inst->cursor_index < shell_inst->input_index)
 	{
 		shell_inst->cursor_index++;
-		write(shell_inst->wrfd, arrow, strlen(arrow));
+		shell_write(shell_inst, arrow, strlen(arrow));
 	}
 }
 
@@ -681,7 +770,7 @@ void shell_home(shell_instance_t* shell_inst, char code)
 	char* arrow = code == 0x48 ? SHELL_LEFTARROW : SHELL_LEFTARROW_ALT; // 0x47
 	while(shell_inst->cursor_index > 0)
 	{
-		write(shell_inst->wrfd, arrow, strlen(arrow));
+		shell_write(shell_inst, arrow, strlen(arrow));
 		shell_inst->cursor_index--;
 	}
 }
@@ -691,7 +780,7 @@ void shell_end(shell_instance_t* shell_inst, char code)
 	char* arrow = code == 0x46 ? SHELL_RIGHTARROW : SHELL_RIGHTARROW_ALT; // 0x4f
 	while(shell_inst->cursor_index < shell_inst->input_index)
 	{
-		write(shell_inst->wrfd, arrow, strlen(arrow));
+		shell_write(shell_inst, arrow, strlen(arrow));
 		shell_inst->cursor_index++;
 	}
 }
@@ -740,14 +829,14 @@ void clear_prompt(shell_instance_t* shell_inst)
  */
 void put_prompt(shell_instance_t* shell_inst, const char* argstr, bool newline)
 {
-	write(shell_inst->wrfd, "\r", 1);
+	shell_write(shell_inst, "\r", 1);
 	if(newline)
-		write(shell_inst->wrfd, "\n", 1);
+		shell_write(shell_inst, "\n", 1);
 
-	write(shell_inst->wrfd, shell_prompt_string, strlen(shell_prompt_string));
+	shell_write(shell_inst, shell_prompt_string, strlen(shell_prompt_string));
 
 	if(argstr)
-		write(shell_inst->wrfd, argstr, strlen((const char*)argstr));
+		shell_write(shell_inst, argstr, strlen((const char*)argstr));
 }
 
 /**
@@ -857,7 +946,7 @@ void parse_input_line(shell_instance_t* shell_inst)
 		// return command if one was matched
 		if(head && head->name)
 		{
-			write(shell_inst->wrfd, SHELL_NEWLINE, sizeof(SHELL_NEWLINE)-1);
+			shell_write(shell_inst, SHELL_NEWLINE, sizeof(SHELL_NEWLINE)-1);
 
 			// find special characters
 			open_output_file(shell_inst);
@@ -872,8 +961,8 @@ void parse_input_line(shell_instance_t* shell_inst)
 		else if(*shell_inst->input_cmd.args)
 		{
 			// print error message if the buffer had some content but no valid command or input file
-			write(shell_inst->wrfd, SHELL_NO_SUCH_COMMAND, sizeof(SHELL_NO_SUCH_COMMAND)-1);
-			write(shell_inst->wrfd, *shell_inst->input_cmd.args, strlen((const char*)*shell_inst->input_cmd.args));
+			shell_write(shell_inst, SHELL_NO_SUCH_COMMAND, sizeof(SHELL_NO_SUCH_COMMAND)-1);
+			shell_write(shell_inst, *shell_inst->input_cmd.args, strlen((const char*)*shell_inst->input_cmd.args));
 		}
 	}
 }
@@ -913,6 +1002,7 @@ void open_output_file(shell_instance_t* shell_inst)
 
 				if(fdes != -1)
 				{
+					shell_flush(shell_inst);
 					shell_inst->wrfd_hold = shell_inst->wrfd;
 					shell_inst->wrfd = fdes;
 				}
@@ -930,6 +1020,7 @@ void close_output_file(shell_instance_t* shell_inst)
 	// close output file if any
 	if(shell_inst->wrfd_hold != -1 && shell_inst->wrfd != -1)
 	{
+		shell_flush(shell_inst);
 		close(shell_inst->wrfd);
 		shell_inst->wrfd = shell_inst->wrfd_hold;
 		shell_inst->wrfd_hold = -1;
@@ -1009,15 +1100,16 @@ void return_code_catcher(shell_instance_t* shell_inst, int code)
         break;
 		case SHELL_CMD_PRINT_CMDS:
 			head = *shell_inst->head_cmd;
-			write(shell_inst->wrfd, SHELL_HELP_STR, sizeof(SHELL_HELP_STR)-1);
+			shell_write(shell_inst, SHELL_HELP_STR, sizeof(SHELL_HELP_STR)-1);
 			while(head)
 			{
-				write(shell_inst->wrfd, SHELL_NEWLINE, sizeof(SHELL_NEWLINE)-1);
-				write(shell_inst->wrfd, head->name, strlen((const char*)head->name));
+				shell_write(shell_inst, SHELL_NEWLINE, sizeof(SHELL_NEWLINE)-1);
+				shell_write(shell_inst, head->name, strlen((const char*)head->name));
 				head = head->next;
 			}
 		break;
 		case SHELL_CMD_PRINT_USAGE:
+			shell_flush(shell_inst);
 			cmd_usage(shell_inst->input_cmd.cmd, shell_inst->wrfd);
 		break;
 	}
@@ -53,6 +53,14 @@
 #define SHELL_HISTORY_LENGTH        1	///< the number of lines of history to keep in ram
 #endif
 
+#ifndef SHELL_READ_BUFFER_SIZE
+#define SHELL_READ_BUFFER_SIZE      64	///< the size of the shell input buffer in bytes, filled a block at a time from sockets and files
+#endif
+
+#ifndef SHELL_WRITE_BUFFER_SIZE
+#define SHELL_WRITE_BUFFER_SIZE     128	///< the size of the shell output buffer in bytes, echo and prompt output is written from it in one piece
+#endif
+
 #ifndef SHELL_MAX_ARGS
 #define SHELL_MAX_ARGS              16	///< the maximum number of arguments supported on one line
 #endif
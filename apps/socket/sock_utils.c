@@ -49,6 +49,169 @@
 #include "FreeRTOS.h"
 #include "task.h"
 
+static int sock_connect_addr(logger_t* log, const char* host, const char* portbuf, int family, int type, int protocol,
+        struct sockaddr* addr, socklen_t addrlen, struct sockaddr* servaddr);
+
+/**
+ * the resolver cache, host names resolved by sock_connect().
+ */
+static sock_dns_entry_t sock_dns_cache[SOCK_DNS_CACHE_SIZE];
+
+/**
+ * @retval  returns the time in ms until the entry expires, 0 or less if it has expired.
+ */
+static int32_t sock_dns_ttl(const sock_dns_entry_t* entry, portTickType now)
+{
+    return (int32_t)(entry->expires - now) * portTICK_RATE_MS;
+}
+
+/**
+ * @retval  returns true if the host should be cached, it is a name not a numeric address.
+ */
+static bool sock_dns_cacheable(const char* host)
+{
+    struct in_addr addr;
+    return host && *host && strlen(host) < SOCK_DNS_HOST_LEN && !inet_aton(host, &addr);
+}
+
+/**
+ * looks up a host in the resolver cache.
+ *
+ * @param   host is the host name.
+ * @param   addr is set to the cached address.
+ * @retval  returns 1 if the address was found, -1 if the last lookup of the host failed
+ *          recently, or 0 if the host is not cached.
+ */
+int sock_dns_cache_lookup(const char* host, struct in_addr* addr)
+{
+    portTickType now = xTaskGetTickCount();
+    int res = 0;
+    int i;
+
+    if(!sock_dns_cacheable(host))
+        return 0;
+
+    vTaskSuspendAll();
+    for(i = 0; i < SOCK_DNS_CACHE_SIZE; i++)
+    {
+        if(sock_dns_cache[i].host[0] && sock_dns_ttl(&sock_dns_cache[i], now) > 0 && !strcmp(sock_dns_cache[i].host, host))
+        {
+            sock_dns_cache[i].hits++;
+            if(sock_dns_cache[i].resolved)
+            {
+                *addr = sock_dns_cache[i].addr;
+                res = 1;
+            }
+            else
+                res = -1;
+            break;
+        }
+    }
+    xTaskResumeAll();
+
+    return res;
+}
+
+/**
+ * adds a host to the resolver cache, into an empty entry, or replacing an expired entry or
+ * the one closest to expiring.
+ *
+ * @param   host is the host name.
+ * @param   addr is the resolved address, or NULL if the lookup failed.
+ */
+void sock_dns_cache_store(const char* host, const struct in_addr* addr)
+{
+    portTickType now = xTaskGetTickCount();
+    sock_dns_entry_t* entry = NULL;
+    int i;
+
+    if(SOCK_DNS_CACHE_SIZE == 0 || !sock_dns_cacheable(host))
+        return;
+
+    vTaskSuspendAll();
+    for(i = 0; i < SOCK_DNS_CACHE_SIZE; i++)
+    {
+        if(!strcmp(sock_dns_cache[i].host, host))
+        {
+            entry = &sock_dns_cache[i];
+            break;
+        }
+        // an empty entry is used before any that still holds a host
+        if(!entry || (entry->host[0] && (!sock_dns_cache[i].host[0] ||
+                sock_dns_ttl(&sock_dns_cache[i], now) < sock_dns_ttl(entry, now))))
+            entry = &sock_dns_cache[i];
+    }
+
+    strcpy(entry->host, host);
+    entry->resolved = addr != NULL;
+    if(addr)
+        entry->addr = *addr;
+    entry->expires = now + (addr ? SOCK_DNS_CACHE_TTL : SOCK_DNS_CACHE_NEGATIVE_TTL) / portTICK_RATE_MS;
+    entry->hits = 0;
+    xTaskResumeAll();
+}
+
+/**
+ * removes a host from the resolver cache.
+ */
+void sock_dns_cache_remove(const char* host)
+{
+    portTickType now = xTaskGetTickCount();
+    int i;
+
+    vTaskSuspendAll();
+    for(i = 0; i < SOCK_DNS_CACHE_SIZE; i++)
+    {
+        if(host && !strcmp(sock_dns_cache[i].host, host))
+        {
+            sock_dns_cache[i].host[0] = '\0';
+            sock_dns_cache[i].expires = now;
+        }
+    }
+    xTaskResumeAll();
+}
+
+/**
+ * empties the resolver cache.
+ */
+void sock_dns_cache_flush()
+{
+    portTickType now = xTaskGetTickCount();
+    int i;
+
+    vTaskSuspendAll();
+    for(i = 0; i < SOCK_DNS_CACHE_SIZE; i++)
+    {
+        sock_dns_cache[i].host[0] = '\0';
+        sock_dns_cache[i].expires = now;
+    }
+    xTaskResumeAll();
+}
+
+/**
+ * copies an entry of the resolver cache, for display.
+ *
+ * @param   index is the index of the entry, 0 to SOCK_DNS_CACHE_SIZE-1.
+ * @param   entry is set to a copy of the entry.
+ * @retval  returns the time in ms until the entry expires, or 0 if the index is out of range,
+ *          the entry is empty, or it has expired.
+ */
+int sock_dns_cache_entry(int index, sock_dns_entry_t* entry)
+{
+    int32_t ttl = 0;
+
+    if(index < 0 || index >= SOCK_DNS_CACHE_SIZE)
+        return 0;
+
+    vTaskSuspendAll();
+    *entry = sock_dns_cache[index];
+    if(entry->host[0])
+        ttl = sock_dns_ttl(entry, xTaskGetTickCount());
+    xTaskResumeAll();
+
+    return ttl > 0 ? ttl : 0;
+}
+
 /**
  * open a socket.
  *
@@ -123,6 +286,7 @@ int sock_connect(const char *host, int port, int type, struct sockaddr* servaddr
     char portbuf[16];
     struct addrinfo *addr_list, *addr_ptr;
     struct addrinfo hints;
+    struct sockaddr_in cached;
     int fd = -1;
     int res;
 
@@ -137,6 +301,28 @@ int sock_connect(const char *host, int port, int type, struct sockaddr* servaddr
     if(servaddr)
         memset(servaddr, 0, sizeof(struct sockaddr));
 
+    // convert integer port to string for getaddrinfo
+    snprintf(portbuf, sizeof(portbuf)-1, "%d", port);
+
+    // skip the name lookup for a host resolved recently
+    memset(&cached, 0, sizeof(cached));
+    res = sock_dns_cache_lookup(host, &cached.sin_addr);
+    if(res < 0)
+    {
+        log_error(&log, "getaddrinfo error, cached");
+        return -1;
+    }
+    if(res > 0)
+    {
+        cached.sin_family = AF_INET;
+        cached.sin_port = htons(port);
+        fd = sock_connect_addr(&log, host, portbuf, AF_INET, type, 0, (struct sockaddr*)&cached, sizeof(cached), servaddr);
+        if(fd >= 0)
+            return fd;
+        // the host may have a new address
+        sock_dns_cache_remove(host);
+    }
+
     // setup hints to help resolve our hostname
     memset(&hints, 0, sizeof(struct addrinfo));
     hints.ai_family = AF_INET;
@@ -148,52 +334,24 @@ int sock_connect(const char *host, int port, int type, struct sockaddr* servaddr
 //    if(type == SOCK_DGRAM && host == NULL)
 //        hints.ai_flags = AI_PASSIVE;
 
-    // convert integer port to string for getaddrinfo
-    snprintf(portbuf, sizeof(portbuf)-1, "%d", port);
-
     // obtain a list of address info's
     res = getaddrinfo(host, portbuf, &hints, &addr_list);
     if (res != 0) {
         log_error(&log, "getaddrinfo error");
+        sock_dns_cache_store(host, NULL);
         return -1;
     }
 
     // attempt to connect to remote host
     for (addr_ptr = addr_list; addr_ptr != NULL; addr_ptr = addr_ptr->ai_next)
     {
-        fd = socket(addr_ptr->ai_family, addr_ptr->ai_socktype, addr_ptr->ai_protocol);
-        if(fd < 0)
-            continue;
-
-        if(addr_ptr->ai_socktype == SOCK_STREAM)
-        {
-            if(connect(fd, addr_ptr->ai_addr, addr_ptr->ai_addrlen) >= 0)
-            {
-                log_info(&log, "connect %s:%s %s", host, portbuf, "OK");
-                break;
-            }
-            log_info(&log, "connect %s:%s %s", host, portbuf, "failed");
-        }
-        else if(addr_ptr->ai_socktype == SOCK_DGRAM)
+        fd = sock_connect_addr(&log, host, portbuf, addr_ptr->ai_family, addr_ptr->ai_socktype, addr_ptr->ai_protocol,
+                addr_ptr->ai_addr, addr_ptr->ai_addrlen, servaddr);
+        if(fd >= 0)
         {
-        	if(host == NULL)
-        	{
-        		// work around hints.ai_flags = AI_PASSIVE not being possible
-        		// lwip will set the address to INADDR_LOOPBACK when host is NULL
-        		// we set to IP_ADDR_ANY instead
-                memset(&((struct sockaddr_in*)addr_ptr->ai_addr)->sin_addr, 0, sizeof(struct in_addr));
-        		if(bind(fd, addr_ptr->ai_addr, addr_ptr->ai_addrlen) == 0){
-                    log_info(&log, "bind %s %s", portbuf, "OK");
-        		}
-        		else{
-        	        log_error(&log, "bind %s %s", portbuf, "failed");
-        		}
-        	}
-            *servaddr = *addr_ptr->ai_addr;
+            sock_dns_cache_store(host, &((struct sockaddr_in*)addr_ptr->ai_addr)->sin_addr);
             break;
         }
-
-        closesocket(fd);
     }
 
     // we are done with addr_list, we can free it, and check one more time that we got a connection
@@ -202,6 +360,225 @@ int sock_connect(const char *host, int port, int type, struct sockaddr* servaddr
     return addr_ptr != NULL ? fd : -1;
 }
 
+/**
+ * opens a socket to one address.
+ *
+ * @retval  returns the socket file descriptor, or -1 if the socket could not be opened or connected.
+ */
+static int sock_connect_addr(logger_t* log, const char* host, const char* portbuf, int family, int type, int protocol,
+        struct sockaddr* addr, socklen_t addrlen, struct sockaddr* servaddr)
+{
+    int fd = socket(family, type, protocol);
+    if(fd < 0)
+        return -1;
+
+    if(type == SOCK_STREAM)
+    {
+        if(connect(fd, addr, addrlen) >= 0)
+        {
+            log_info(log, "connect %s:%s %s", host, portbuf, "OK");
+            return fd;
+        }
+        log_info(log, "connect %s:%s %s", host, portbuf, "failed");
+    }
+    else if(type == SOCK_DGRAM)
+    {
+        if(host == NULL)
+        {
+            // work around hints.ai_flags = AI_PASSIVE not being possible
+            // lwip will set the address to INADDR_LOOPBACK when host is NULL
+            // we set to IP_ADDR_ANY instead
+            memset(&((struct sockaddr_in*)addr)->sin_addr, 0, sizeof(struct in_addr));
+            if(bind(fd, addr, addrlen) == 0){
+                log_info(log, "bind %s %s", portbuf, "OK");
+            }
+            else{
+                log_error(log, "bind %s %s", portbuf, "failed");
+            }
+        }
+        *servaddr = *addr;
+        return fd;
+    }
+
+    closesocket(fd);
+    return -1;
+}
+
+/**
+ * sets up a packer, to send many small records over UDP at a high rate. each datagram
+ * costs a buffer and a trip through the network stack, so records are packed into as few
+ * datagrams as possible, and the datagrams are sent with sendmmsg().
+ *
+ * records are not split between datagrams, the receiver reads whole records from each datagram.
+ *
+ * @param   packer is the packer to set up.
+ * @param   fdes is a SOCK_DGRAM socket.
+ * @param   addr is the address to send to, as returned by sock_connect(), or NULL if the socket is connected.
+ * @param   addrlen is the length of addr.
+ * @param   buffer is where the datagrams are packed, it must not go out of scope.
+ * @param   size is the size of buffer, up to SOCK_PACKER_DATAGRAMS times mtu is used.
+ * @param   mtu is the largest datagram to send, generally SOCK_UDP_MTU.
+ */
+void sock_packer_init(sock_packer_t* packer, int fdes, struct sockaddr* addr, socklen_t addrlen, char* buffer, int size, int mtu)
+{
+    int i;
+
+    packer->fdes = fdes;
+    packer->mtu = mtu;
+    packer->datagrams = size / mtu;
+    if(packer->datagrams > SOCK_PACKER_DATAGRAMS)
+        packer->datagrams = SOCK_PACKER_DATAGRAMS;
+    packer->count = 0;
+    packer->records = 0;
+    packer->sent = 0;
+    packer->dropped = 0;
+
+    memset(packer->msgs, 0, sizeof(packer->msgs));
+    for(i = 0; i < packer->datagrams; i++)
+    {
+        packer->iov[i].iov_base = buffer + i * mtu;
+        packer->iov[i].iov_len = 0;
+        packer->msgs[i].msg_hdr.msg_name = addr;
+        packer->msgs[i].msg_hdr.msg_namelen = addr ? addrlen : 0;
+        packer->msgs[i].msg_hdr.msg_iov = &packer->iov[i];
+        packer->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+/**
+ * adds a record to the packer, sending the packed datagrams when the buffer is full.
+ *
+ * @param   record is the data to send.
+ * @param   length is the length of the record, at most the mtu.
+ * @retval  returns 0 on success, or -1 if the record is too long or the datagrams could not be sent.
+ */
+int sock_packer_add(sock_packer_t* packer, const void* record, int length)
+{
+    struct iovec* iov;
+    int res = 0;
+
+    if(length > packer->mtu || packer->datagrams == 0)
+        return -1;
+
+    iov = packer->count > 0 ? &packer->iov[packer->count - 1] : NULL;
+
+    // start a new datagram when the record does not fit in the current one
+    if(!iov || (int)iov->iov_len + length > packer->mtu)
+    {
+        if(packer->count == packer->datagrams)
+            res = sock_packer_flush(packer);
+        iov = &packer->iov[packer->count++];
+    }
+
+    memcpy((char*)iov->iov_base + iov->iov_len, record, length);
+    iov->iov_len += length;
+    packer->records++;
+
+    return res < 0 ? -1 : 0;
+}
+
+/**
+ * sends the packed datagrams. call to send the records added since the last flush,
+ * at the end of a burst or periodically.
+ *
+ * @retval  returns the number of datagrams sent, or -1 on error.
+ */
+int sock_packer_flush(sock_packer_t* packer)
+{
+    int res = 0;
+    int i;
+
+    if(packer->count > 0)
+    {
+        res = sendmmsg(packer->fdes, packer->msgs, packer->count, 0);
+
+        // datagrams that could not be sent are dropped, rather than delaying the records that follow
+        packer->sent += res > 0 ? res : 0;
+        packer->dropped += res > 0 ? packer->count - res : packer->count;
+
+        for(i = 0; i < packer->count; i++)
+            packer->iov[i].iov_len = 0;
+        packer->count = 0;
+    }
+
+    return res;
+}
+
+/**
+ * sets up a pool of connection contexts. the memory for all of them is allocated here, once,
+ * so that serving connections does not fragment the heap.
+ *
+ * @param   pool is the pool to set up.
+ * @param   size is the size of one object, its sizeof() so that the objects are aligned as an array.
+ * @param   count is the number of objects, generally the conns setting of the server.
+ * @retval  returns true if the memory was allocated.
+ */
+bool sock_pool_init(sock_pool_t* pool, int size, int count)
+{
+    int i;
+
+    pool->size = size;
+    pool->count = count;
+    pool->available = 0;
+    pool->peak = 0;
+    pool->exhausted = 0;
+    pool->objects = malloc(pool->size * count);
+    pool->free = malloc(count * sizeof(int));
+
+    if(!pool->objects || !pool->free)
+    {
+        free(pool->objects);
+        free(pool->free);
+        pool->objects = NULL;
+        pool->free = NULL;
+        return false;
+    }
+
+    memset(pool->objects, 0, pool->size * count);
+
+    // hand out the lowest objects first
+    for(i = 0; i < count; i++)
+        pool->free[pool->available++] = count - 1 - i;
+
+    return true;
+}
+
+/**
+ * takes an object from a pool.
+ *
+ * @retval  returns a pointer to the object, or NULL if all of the objects are in use.
+ */
+void* sock_pool_alloc(sock_pool_t* pool)
+{
+    void* object = NULL;
+
+    vTaskSuspendAll();
+    if(pool->available > 0)
+    {
+        object = pool->objects + pool->free[--pool->available] * pool->size;
+        if(pool->count - pool->available > pool->peak)
+            pool->peak = pool->count - pool->available;
+    }
+    else
+        pool->exhausted++;
+    xTaskResumeAll();
+
+    return object;
+}
+
+/**
+ * returns an object to the pool it was taken from.
+ */
+void sock_pool_free(sock_pool_t* pool, void* object)
+{
+    if(!object)
+        return;
+
+    vTaskSuspendAll();
+    pool->free[pool->available++] = ((char*)object - pool->objects) / pool->size;
+    xTaskResumeAll();
+}
+
 /**
  * socket server.
  *
@@ -251,6 +628,9 @@ void sock_server_kill(sock_server_t* servinfo)
 
 /**
  * this is a thread function - when run, is the the listener.
+ *
+ * the handle_incoming function is passed the accepted connection, which it must copy
+ * if it is needed after the call returns.
  */
 void sock_server_thread(void* parameters)
 {
@@ -258,11 +638,9 @@ void sock_server_thread(void* parameters)
     bool handled;
 
     sock_conn_t newconn;
-    sock_conn_t* conn;
 
     newconn.ctx = servinfo->ctx;
     newconn.service = servinfo->service;
-    newconn.service = servinfo->service;
     newconn.connfd = 0;
 
     while(newconn.connfd != -1)
@@ -272,26 +650,18 @@ void sock_server_thread(void* parameters)
 
         if(newconn.connfd != -1)
         {
+            newconn.accepted = xTaskGetTickCount();
             log_debug(&servinfo->log, "%s accepted conn with %s",
                                     servinfo->name, inet_ntoa(newconn.cliaddr.sin_addr));
             handled = false;
-            conn = NULL;
 
             if(servinfo->handle_incoming)
             {
-                conn = malloc(sizeof(sock_conn_t));
-
-                if(conn)
+                if(servinfo->handle_incoming(servinfo, &newconn) == 0)
                 {
-                    memcpy(conn, &newconn, sizeof(sock_conn_t));
-                    if(servinfo->handle_incoming(servinfo, conn) == 0)
-                    {
-                        log_debug(&servinfo->log, "handled service successfully");
-                        handled = true;
-                    }
+                    log_debug(&servinfo->log, "handled service successfully");
+                    handled = true;
                 }
-                else
-                    log_error(&servinfo->log, "couldnt allocate connection data");
             }
             else
                 log_error(&servinfo->log, "service function not set");
@@ -300,8 +670,6 @@ void sock_server_thread(void* parameters)
             {
                 log_error(&servinfo->log, "closing unhandled connection");
                 closesocket(newconn.connfd);
-                if(conn)
-                    free(conn);
             }
         }
     }
@@ -40,9 +40,65 @@
 #ifndef SOCKET_SOCK_UTILS_H_
 #define SOCKET_SOCK_UTILS_H_
 
+#include <stdbool.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include "logger.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#ifndef SOCK_DNS_CACHE_SIZE
+#define SOCK_DNS_CACHE_SIZE             4       ///< the number of host names in the resolver cache, at least 1, may be set in the project makefile
+#endif
+#ifndef SOCK_DNS_CACHE_TTL
+#define SOCK_DNS_CACHE_TTL              300000  ///< time in ms that a resolved address is used for
+#endif
+#ifndef SOCK_DNS_CACHE_NEGATIVE_TTL
+#define SOCK_DNS_CACHE_NEGATIVE_TTL     10000   ///< time in ms that a failed lookup is remembered for
+#endif
+#define SOCK_DNS_HOST_LEN               32      ///< longer host names are not cached
+#define SOCK_UDP_MTU                    1472    ///< the largest UDP payload that is not fragmented on ethernet
+#define SOCK_PACKER_DATAGRAMS           8       ///< the most datagrams a packer sends in one batch
+
+/**
+ * an entry of the resolver cache used by sock_connect().
+ */
+typedef struct {
+	char host[SOCK_DNS_HOST_LEN];   ///< the host name, empty if the entry is not used
+	struct in_addr addr;            ///< the address of the host
+	bool resolved;                  ///< false if the lookup of the host failed
+	portTickType expires;           ///< the tick count at which the entry expires
+	unsigned long hits;             ///< the number of times the entry was used
+}sock_dns_entry_t;
+
+/**
+ * a fixed number of equally sized objects, allocated once, for connection contexts.
+ */
+typedef struct {
+	char* objects;                  ///< the storage for all of the objects
+	int* free;                      ///< a stack of the indexes of the free objects
+	int size;                       ///< the size of one object
+	int count;                      ///< the number of objects
+	int available;                  ///< the number of free objects
+	int peak;                       ///< the most objects that were in use at once
+	unsigned long exhausted;        ///< the number of allocations that failed as the pool was empty
+}sock_pool_t;
+
+/**
+ * coalesces small records into datagrams of up to mtu bytes, and sends the datagrams in batches.
+ */
+typedef struct {
+	int fdes;                       ///< the SOCK_DGRAM socket to send on
+	int mtu;                        ///< the largest datagram to send
+	int datagrams;                  ///< the number of datagrams that fit in the buffer
+	int count;                      ///< the number of datagrams holding records
+	struct iovec iov[SOCK_PACKER_DATAGRAMS];
+	struct mmsghdr msgs[SOCK_PACKER_DATAGRAMS];
+	unsigned long records;          ///< the number of records added
+	unsigned long sent;             ///< the number of datagrams sent
+	unsigned long dropped;          ///< the number of datagrams that could not be sent
+}sock_packer_t;
 
 typedef struct _sock_server_t sock_server_t;
 typedef struct _sock_conn_t sock_conn_t;
@@ -56,6 +112,7 @@ typedef struct _sock_conn_t {
 	int connfd;
 	void* ctx;
 	sock_service_fptr_t service;
+	portTickType accepted;      ///< the tick count when the connection was accepted
 }sock_conn_t;
 
 typedef struct _sock_server_t {
@@ -69,9 +126,25 @@ typedef struct _sock_server_t {
 	int prio;
 	int port;
 	int conns;
+	int workers;                ///< the number of worker tasks serving connections
+	int queue;                  ///< the number of accepted connections that may wait for a worker
+	QueueHandle_t pending;      ///< accepted connections waiting for a worker
+	TaskHandle_t listener;      ///< the task accepting connections
+	TaskHandle_t* worker_tasks; ///< the worker tasks, workers long
 }sock_server_t;
 
 int sock_connect(const char *host, int port, int type, struct sockaddr* servaddr);
+int sock_dns_cache_lookup(const char* host, struct in_addr* addr);
+void sock_dns_cache_store(const char* host, const struct in_addr* addr);
+void sock_dns_cache_remove(const char* host);
+void sock_dns_cache_flush();
+int sock_dns_cache_entry(int index, sock_dns_entry_t* entry);
+void sock_packer_init(sock_packer_t* packer, int fdes, struct sockaddr* addr, socklen_t addrlen, char* buffer, int size, int mtu);
+int sock_packer_add(sock_packer_t* packer, const void* record, int length);
+int sock_packer_flush(sock_packer_t* packer);
+bool sock_pool_init(sock_pool_t* pool, int size, int count);
+void* sock_pool_alloc(sock_pool_t* pool);
+void sock_pool_free(sock_pool_t* pool, void* object);
 int sock_server(int port, int type, int conns, sock_server_t* servinfo,
 				sock_handle_incoming_fptr_t handle_incoming, sock_service_fptr_t service,
 				void* ctx, const char* name, int stacksize, int prio);
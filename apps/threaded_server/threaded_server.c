@@ -53,10 +53,12 @@
 #include "logger.h"
 #include "FreeRTOS.h"
 #include "task.h"
-#include "confparse.h"
+#include "queue.h"
+#include "confstore.h"
 
-void run_spawned(sock_conn_t* conn);
-int spawn_connection(sock_server_t* server, sock_conn_t* conn);
+void run_worker(sock_server_t* server);
+int queue_connection(sock_server_t* server, sock_conn_t* conn);
+static void delete_workers(sock_server_t* servinfo);
 
 /**
  * used to extract the name, stacksize and task priority from the config file.
@@ -66,6 +68,8 @@ int spawn_connection(sock_server_t* server, sock_conn_t* conn);
  *
  * Example:
  * servinfo.conns = 0;
+ * servinfo.workers = 0;
+ * servinfo.queue = 0;
  * servinfo.port = 0;
  * servinfo.stacksize = APP_SERVER_STACK_SIZE;
  * servinfo.prio = APP_SERVER_TASK_PRIO;
@@ -73,47 +77,68 @@ int spawn_connection(sock_server_t* server, sock_conn_t* conn);
  */
 void get_server_configuration(const char* configfile, sock_server_t* servinfo)
 {
-	uint8_t buffer[32];
-	const uint8_t* confstr;
+	config_store_t store;
 
 	log_init(&servinfo->log, servinfo->name);
 
-	if(stat(configfile, (struct stat*)&buffer) == 0)
+	if(config_store_load(&store, configfile))
+		get_server_configuration_from_store(&store, servinfo);
+	else
+	    log_error(&servinfo->log, "couldnt read config file %s", configfile);
+
+	config_store_free(&store);
+}
+
+/**
+ * as get_server_configuration(), but reads the settings from an already loaded config store.
+ * use this when the application reads its own settings from the same file.
+ */
+void get_server_configuration_from_store(config_store_t* store, sock_server_t* servinfo)
+{
+	const char* confstr;
+
+	confstr = config_store_get_string(store, "stacksize", NULL);
+	if(confstr) {
+		servinfo->stacksize = atoi(confstr);
+		log_info(&servinfo->log, "%s set stacksize: %d", store->filepath, servinfo->stacksize);
+	}
+
+	confstr = config_store_get_string(store, "taskprio", NULL);
+	if(confstr) {
+		servinfo->prio = atoi(confstr);
+		log_info(&servinfo->log, "%s set threadprio: %d", store->filepath, servinfo->prio);
+	}
+
+	confstr = config_store_get_string(store, "name", NULL);
+	if(confstr)
 	{
-	    confstr = get_config_value_by_key(buffer, sizeof(buffer), (const uint8_t*)configfile, (const uint8_t*)"stacksize");
-        if(confstr) {
-        	servinfo->stacksize = atoi((const char*)confstr);
-        	log_info(&servinfo->log, "%s set stacksize: %d", configfile, servinfo->stacksize);
-        }
-
-        confstr = get_config_value_by_key(buffer, sizeof(buffer), (const uint8_t*)configfile, (const uint8_t*)"taskprio");
-        if(confstr) {
-        	servinfo->prio = atoi((const char*)confstr);
-        	log_info(&servinfo->log, "%s set threadprio: %d", configfile, servinfo->prio);
-        }
-
-		confstr = get_config_value_by_key(buffer, sizeof(buffer), (const uint8_t*)configfile, (const uint8_t*)"name");
-		if(confstr)
-		{
-			servinfo->name = malloc(strlen((const char*)confstr) + 1);
-			strcpy((char*)servinfo->name, (const char*)confstr);
-			log_info(&servinfo->log, "%s set name: %s", configfile, servinfo->name);
-		}
+		servinfo->name = malloc(strlen(confstr) + 1);
+		strcpy((char*)servinfo->name, confstr);
+		log_info(&servinfo->log, "%s set name: %s", store->filepath, servinfo->name);
+	}
+
+	confstr = config_store_get_string(store, "port", NULL);
+	if(confstr) {
+		servinfo->port = atoi(confstr);
+		log_info(&servinfo->log, "%s set port: %d", store->filepath, servinfo->port);
+	}
 
-	    confstr = get_config_value_by_key(buffer, sizeof(buffer), (const uint8_t*)configfile, (const uint8_t*)"port");
-        if(confstr) {
-        	servinfo->port = atoi((const char*)confstr);
-        	log_info(&servinfo->log, "%s set port: %d", configfile, servinfo->port);
-        }
-
-        confstr = get_config_value_by_key(buffer, sizeof(buffer), (const uint8_t*)configfile, (const uint8_t*)"conns");
-        if(confstr) {
-        	servinfo->conns = atoi((const char*)confstr);
-        	log_info(&servinfo->log, "%s set connections: %d", configfile, servinfo->conns);
-        }
+	confstr = config_store_get_string(store, "conns", NULL);
+	if(confstr) {
+		servinfo->conns = atoi(confstr);
+		log_info(&servinfo->log, "%s set connections: %d", store->filepath, servinfo->conns);
 	}
-	else {
-	    log_error(&servinfo->log, "couldnt stat config file %s", configfile);
+
+	confstr = config_store_get_string(store, "workers", NULL);
+	if(confstr) {
+		servinfo->workers = atoi(confstr);
+		log_info(&servinfo->log, "%s set workers: %d", store->filepath, servinfo->workers);
+	}
+
+	confstr = config_store_get_string(store, "queue", NULL);
+	if(confstr) {
+		servinfo->queue = atoi(confstr);
+		log_info(&servinfo->log, "%s set queue: %d", store->filepath, servinfo->queue);
 	}
 
 	log_init(&servinfo->log, servinfo->name);
@@ -123,63 +148,138 @@ void get_server_configuration(const char* configfile, sock_server_t* servinfo)
  * starts a threaded server daemon.
  *
  * ensure that the servinfo structure is configured manually or via a call to get_server_configuration().
+ * when workers is 0, a worker is started for each of conns. when queue is 0, it is set to workers.
  */
 int start_threaded_server(sock_server_t* servinfo, sock_service_fptr_t threadfunc, void* appdata)
 {
 	int fd = -1;
+	int i;
 
     if(!servinfo->conns || !servinfo->port) {
         log_error(&servinfo->log, "port and/or conns settings invalid, %d and %d", servinfo->port, servinfo->conns);
         return fd;
     }
 
+    if(servinfo->workers <= 0)
+    	servinfo->workers = servinfo->conns;
+    if(servinfo->queue <= 0)
+    	servinfo->queue = servinfo->workers;
+
+    servinfo->listener = NULL;
+    servinfo->pending = xQueueCreate(servinfo->queue, sizeof(sock_conn_t));
+    servinfo->worker_tasks = calloc(servinfo->workers, sizeof(TaskHandle_t));
+    if(!servinfo->pending || !servinfo->worker_tasks) {
+        log_error(&servinfo->log, "error creating connection queue");
+        delete_workers(servinfo);
+        return fd;
+    }
+
 	// create the socket server structures
-	fd = sock_server(servinfo->port, SOCK_STREAM, servinfo->conns, servinfo, spawn_connection, threadfunc, appdata, servinfo->name, servinfo->stacksize, servinfo->prio);
-	// start a new thread that runs the listener
+	fd = sock_server(servinfo->port, SOCK_STREAM, servinfo->conns, servinfo, queue_connection, threadfunc, appdata, servinfo->name, servinfo->stacksize, servinfo->prio);
 	if(fd != -1)
 	{
-		if(xTaskCreate(sock_server_thread, servinfo->name, THREADED_SERVER_STACK_SIZE, servinfo, THREADED_SERVER_PRIORITY, NULL) != pdPASS) {
+		// start the workers, the server runs with as many as could be started
+		for(i = 0; i < servinfo->workers; i++)
+		{
+			if(xTaskCreate((TaskFunction_t)run_worker, servinfo->name, servinfo->stacksize, servinfo, servinfo->prio, &servinfo->worker_tasks[i]) != pdPASS)
+			{
+				log_error(&servinfo->log, "error starting worker task %d of %d", i + 1, servinfo->workers);
+				break;
+			}
+		}
+		servinfo->workers = i;
+
+		// start a new thread that runs the listener
+		if(!servinfo->workers ||
+			xTaskCreate(sock_server_thread, servinfo->name, THREADED_SERVER_STACK_SIZE, servinfo, THREADED_SERVER_PRIORITY, &servinfo->listener) != pdPASS) {
 			log_error(&servinfo->log, "error staring server task");
+			servinfo->listener = NULL;
 			stop_threaded_server(servinfo);
 			fd = -1;
 		}
 	}
+	else
+		delete_workers(servinfo);
 
 	return fd;
 }
 
+/**
+ * stops a threaded server started by start_threaded_server().
+ * the listener and worker tasks are deleted, connections being served are cut short.
+ */
 void stop_threaded_server(sock_server_t* servinfo)
 {
+    // the listener may be blocked on the queue, so goes before it
+    if(servinfo->listener)
+    {
+        vTaskDelete(servinfo->listener);
+        servinfo->listener = NULL;
+    }
+
     sock_server_kill(servinfo);
+    delete_workers(servinfo);
 
     if(servinfo->name)
         free((char*)servinfo->name);
 }
 
-int spawn_connection(sock_server_t* server, sock_conn_t* conn)
+/**
+ * deletes the worker tasks, then the queue they wait on.
+ */
+static void delete_workers(sock_server_t* servinfo)
 {
-	int ret = xTaskCreate((TaskFunction_t)run_spawned, server->name, server->stacksize, conn, server->prio, NULL);
-	if(ret == pdPASS) {
+	int i;
+
+	if(servinfo->worker_tasks)
+	{
+		for(i = 0; i < servinfo->workers; i++)
+		{
+			if(servinfo->worker_tasks[i])
+				vTaskDelete(servinfo->worker_tasks[i]);
+		}
+		free(servinfo->worker_tasks);
+		servinfo->worker_tasks = NULL;
+	}
+	servinfo->workers = 0;
+
+	if(servinfo->pending)
+	{
+		vQueueDelete(servinfo->pending);
+		servinfo->pending = NULL;
+	}
+}
+
+/**
+ * passes an accepted connection to the workers. blocks while the queue is full,
+ * so that no more connections are accepted until a worker is free.
+ */
+int queue_connection(sock_server_t* server, sock_conn_t* conn)
+{
+	if(xQueueSend(server->pending, conn, portMAX_DELAY) == pdTRUE) {
 	    return 0;
 	}
 
-	log_error(&server->log, "error spawning connection task (%d)", ret);
+	log_error(&server->log, "error queuing connection");
 	return -1;
 }
 
-void run_spawned(sock_conn_t* conn)
+/**
+ * a worker thread, serves connections from the queue one after another.
+ */
+void run_worker(sock_server_t* server)
 {
-	if(conn)
+	sock_conn_t conn;
+
+	while(1)
 	{
-		conn->service(conn);
-	    log_debug(NULL, "closing connection with %s", inet_ntoa(conn->cliaddr.sin_addr));
-		closesocket(conn->connfd);
-		free(conn);
+		if(xQueueReceive(server->pending, &conn, portMAX_DELAY) == pdTRUE)
+		{
+			conn.service(&conn);
+		    log_debug(NULL, "closing connection with %s", inet_ntoa(conn.cliaddr.sin_addr));
+			closesocket(conn.connfd);
+		}
 	}
-	else
-	    log_error(NULL, "spawned with no connection data");
-
-	vTaskDelete(NULL);
 }
 
 /**
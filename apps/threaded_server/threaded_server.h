@@ -42,6 +42,7 @@
 #define THREADED_SERVER_H_
 
 #include "sock_utils.h"
+#include "confstore.h"
 
 #define THREADED_SERVER_PRIORITY		1
 #define THREADED_SERVER_STACK_SIZE		128
@@ -49,6 +50,7 @@
 int start_threaded_server(sock_server_t* servinfo, sock_service_fptr_t threadfunc, void* appdata);
 void stop_threaded_server(sock_server_t* servinfo);
 void get_server_configuration(const char* configfile, sock_server_t* servinfo);
+void get_server_configuration_from_store(config_store_t* store, sock_server_t* servinfo);
 
 #endif /* THREADED_SERVER_H_ */
 
@@ -29,6 +29,7 @@ $(error USE_HTTP_UTILS is set. http utils requires USE_SOCK_UTILS set to 1)
 endif
 
 SOURCE += $(LIKEPOSIX_APPS_DIR)/http/http_client.c
+SOURCE += $(LIKEPOSIX_APPS_DIR)/http/http_reader.c
 CFLAGS += -I $(LIKEPOSIX_APPS_DIR)/http
 endif
 
@@ -110,4 +111,8 @@ endif
 
 SOURCE += $(LIKEPOSIX_APPS_DIR)/http/http_server.c
 SOURCE += $(LIKEPOSIX_APPS_DIR)/http/http_api.c
+SOURCE += $(LIKEPOSIX_APPS_DIR)/http/http_cache.c
+SOURCE += $(LIKEPOSIX_APPS_DIR)/http/http_event_server.c
+SOURCE += $(LIKEPOSIX_APPS_DIR)/http/http_websocket.c
+SOURCE += $(LIKEPOSIX_APPS_DIR)/http/http_metrics.c
 endif
@@ -12,4 +12,5 @@ CFLAGS += -I $(JSMNDIR)
 CFLAGS += -I $(JSMN_EXTENSIONS_DIR)
 SOURCE += $(JSMNDIR)/jsmn.c
 SOURCE += $(JSMN_EXTENSIONS_DIR)/jsmn_extensions.c
+SOURCE += $(JSMN_EXTENSIONS_DIR)/json_bind.c
 endif
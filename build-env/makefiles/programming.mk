@@ -10,6 +10,9 @@ stm32loader:
 
 qstlink2:
 	qstlink2 -cwVR $(OUTPUT_PREFIX).bin
+
+httpd_gzip:
+	python $(BUILD_ENV_DIR)/tools/gzip_httpd.py $(LIKEPOSIX_CORE_DIR)/base_fs/var/lib/httpd
 	
 #jtag: all
 #	echo "reset halt" | nc localhost 4444
@@ -31,5 +31,6 @@ endif
 
 ifeq ($(USE_CONFPARSE), 1)
 SOURCE += $(LIKEPOSIX_TOOLS_DIR)/confparse/confparse.c
+SOURCE += $(LIKEPOSIX_TOOLS_DIR)/confparse/confstore.c
 CFLAGS += -I $(LIKEPOSIX_TOOLS_DIR)/confparse
 endif
\ No newline at end of file
@@ -0,0 +1,41 @@
+#!/usr/bin/env python
+#
+# writes a gzip compressed copy, name.gz, next to each compressible file in a
+# http server document tree. the http server sends the .gz copy to clients that accept gzip.
+#
+# usage: gzip_httpd.py [directory]
+# the directory defaults to like-posix/base_fs/var/lib/httpd
+#
+
+import sys
+import os
+import gzip
+
+COMPRESSIBLE = ('.html', '.shtml', '.htm', '.css', '.js', '.json', '.xml', '.txt', '.svg')
+
+def compress(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    gzpath = path + '.gz'
+    # mtime=0 keeps the output the same from build to build
+    with open(gzpath, 'wb') as raw:
+        with gzip.GzipFile(os.path.basename(path), 'wb', 9, raw, 0) as f:
+            f.write(data)
+
+    size = os.path.getsize(gzpath)
+    if size >= len(data):
+        os.remove(gzpath)
+        print("skip %s, %dB does not compress" % (path, len(data)))
+    else:
+        print("gzip %s, %dB -> %dB" % (path, len(data), size))
+
+if len(sys.argv) > 1:
+    root = sys.argv[1]
+else:
+    root = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'like-posix', 'base_fs', 'var', 'lib', 'httpd')
+
+for directory, dirs, files in os.walk(root):
+    for name in sorted(files):
+        if os.path.splitext(name)[1].lower() in COMPRESSIBLE:
+            compress(os.path.join(directory, name))
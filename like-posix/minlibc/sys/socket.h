@@ -77,3 +77,49 @@ int ioctlsocket(int socket, int cmd, void* argp);
 #define ioctlsocket(a,b,c)    lwip_ioctl(a,b,c)
 
 #endif
+
+// this header has no include guard, so guard the type definitions
+#if USE_DRIVER_LWIP_NET && !defined(POLLIN)
+
+#define POLLIN      0x01    ///< there is data to read, or a connection to accept
+#define POLLOUT     0x04    ///< data may be written without blocking
+#define POLLERR     0x08    ///< the socket has an error, output only
+#define POLLHUP     0x10    ///< the peer closed the connection, output only
+#define POLLNVAL    0x20    ///< fd is not a socket, output only
+
+typedef unsigned int nfds_t;
+
+struct pollfd {
+    int fd;                 ///< the socket to poll, negative values are ignored
+    short events;           ///< the events to wait for, POLLIN and/or POLLOUT
+    short revents;          ///< the events that occurred
+};
+
+int poll(struct pollfd* fds, nfds_t nfds, int timeout);
+
+struct iovec {
+    void* iov_base;         ///< the data
+    size_t iov_len;         ///< the length of the data
+};
+
+struct msghdr {
+    void* msg_name;         ///< the address of the peer, a struct sockaddr, or NULL
+    socklen_t msg_namelen;  ///< the length of the address
+    struct iovec* msg_iov;  ///< the data of the datagram, only one iovec is supported
+    int msg_iovlen;         ///< the number of entries in msg_iov
+    void* msg_control;      ///< not supported, set to NULL
+    socklen_t msg_controllen;
+    int msg_flags;          ///< not supported
+};
+
+struct mmsghdr {
+    struct msghdr msg_hdr;  ///< the datagram
+    unsigned int msg_len;   ///< the number of bytes sent or received, output only
+};
+
+struct timespec;
+
+int sendmmsg(int socket, struct mmsghdr* msgvec, unsigned int vlen, int flags);
+int recvmmsg(int socket, struct mmsghdr* msgvec, unsigned int vlen, int flags, struct timespec* timeout);
+
+#endif
@@ -1069,6 +1069,59 @@ int _lseek(int file, int offset, int whence)
 	return res;
 }
 
+/**
+ * allocates the disk space for a file, before it is written.
+ *
+ * with FatFs, the space is allocated as one contiguous block of clusters, by f_expand(),
+ * rather than cluster by cluster as the file grows. like f_expand(), it only works on an
+ * empty file opened for writing. the file size is set to offset + len, and the file pointer
+ * is left at the start of the file.
+ *
+ * @param   file is the file descriptor of an empty regular file, opened for writing.
+ * @param   offset must be 0.
+ * @param   len is the size to allocate.
+ * @retval  returns 0 on success, or an error number as POSIX specifies, errno is not set:
+ *          EBADF if file is not open for writing, ENODEV if it is not a regular file,
+ *          EINVAL if offset is not 0 or len is not positive, ENOSPC if there is no
+ *          contiguous space, EIO on a disk error, or EOPNOTSUPP without f_expand().
+ */
+int posix_fallocate(int file, off_t offset, off_t len)
+{
+#if _USE_EXPAND && !_FS_READONLY
+	filtab_entry_t* fte;
+	int res;
+
+	if(offset != 0 || len <= 0)
+		return EINVAL;
+
+	fte = __lock(file, true, true);
+	if(!fte)
+		return EBADF;
+
+	if(fte->mode != S_IFREG)
+		res = ENODEV;
+	else if(!(fte->file.flag & FA_WRITE))
+		res = EBADF;
+	else
+	{
+		switch(f_expand(&fte->file, len, 1))
+		{
+			case FR_OK: res = 0; break;
+			case FR_DENIED: res = ENOSPC; break;
+			default: res = EIO; break;
+		}
+	}
+	__unlock(fte, true, true);
+
+	return res;
+#else
+	(void)file;
+	(void)offset;
+	(void)len;
+	return EOPNOTSUPP;
+#endif
+}
+
 int _chdir(const char *path)
 {
     return f_chdir((TCHAR*)path) == FR_OK ? 0 : -1;
@@ -1560,6 +1613,204 @@ int closesocket(int socket)
 {
     return _close(socket);
 }
+#endif
+
+#if USE_DRIVER_LWIP_NET
+
+/**
+ * @retval  returns the lwip socket behind a file descriptor, or -1 if it is not a socket.
+ */
+static int __poll_fdes(int file)
+{
+#if ENABLE_LIKEPOSIX_SOCKETS
+	filtab_entry_t* fte = __get_entry(file);
+	if(fte && fte->mode == S_IFSOCK)
+		return fte->fdes;
+	return EOF;
+#else
+	return file;
+#endif
+}
+
+/**
+ * waits for events on a set of sockets, implemented over lwip_select().
+ *
+ * unlike select(), the sockets are given as an array, so that socket file descriptors
+ * need not fit into an fd_set - like-posix file descriptors may exceed FD_SETSIZE.
+ *
+ * lwip does not report hang ups, a closed connection is reported as POLLIN,
+ * and the following read returns 0.
+ *
+ * @param   fds is an array of sockets and the events to wait for.
+ * @param   nfds is the length of fds.
+ * @param   timeout is the time to wait in ms, -1 waits forever, 0 does not wait.
+ * @retval  returns the number of entries in fds with events set in revents,
+ *          0 on timeout, or -1 on error.
+ */
+int poll(struct pollfd* fds, nfds_t nfds, int timeout)
+{
+	fd_set readset;
+	fd_set writeset;
+	fd_set exceptset;
+	struct timeval tv;
+	int maxfdes = -1;
+	int fdes;
+	int res;
+	nfds_t i;
+
+	FD_ZERO(&readset);
+	FD_ZERO(&writeset);
+	FD_ZERO(&exceptset);
+
+	for(i = 0; i < nfds; i++)
+	{
+		fds[i].revents = 0;
+		if(fds[i].fd < 0)
+			continue;
+
+		fdes = __poll_fdes(fds[i].fd);
+		if(fdes < 0)
+			continue;
+
+		if(fds[i].events & POLLIN)
+			FD_SET(fdes, &readset);
+		if(fds[i].events & POLLOUT)
+			FD_SET(fdes, &writeset);
+		FD_SET(fdes, &exceptset);
+
+		if(fdes > maxfdes)
+			maxfdes = fdes;
+	}
+
+	tv.tv_sec = timeout / 1000;
+	tv.tv_usec = (timeout % 1000) * 1000;
+
+	res = lwip_select(maxfdes + 1, &readset, &writeset, &exceptset, timeout < 0 ? NULL : &tv);
+	if(res <= 0)
+		return res;
+
+	res = 0;
+	for(i = 0; i < nfds; i++)
+	{
+		if(fds[i].fd < 0)
+			continue;
+
+		fdes = __poll_fdes(fds[i].fd);
+		if(fdes < 0)
+			fds[i].revents = POLLNVAL;
+		else
+		{
+			if(FD_ISSET(fdes, &readset))
+				fds[i].revents |= POLLIN;
+			if(FD_ISSET(fdes, &writeset))
+				fds[i].revents |= POLLOUT;
+			if(FD_ISSET(fdes, &exceptset))
+				fds[i].revents |= POLLERR;
+		}
+
+		if(fds[i].revents)
+			res++;
+	}
+
+	return res;
+}
+
+/**
+ * sends or receives a batch of datagrams, with the socket locked once for the batch.
+ */
+static int __mmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen, int flags, bool receive)
+{
+	struct msghdr* msg;
+	unsigned int i;
+	int fdes = sockfd;
+	int res = 0;
+#if ENABLE_LIKEPOSIX_SOCKETS
+	filtab_entry_t* fte;
+#endif
+
+	if(vlen == 0)
+		return 0;
+
+#if ENABLE_LIKEPOSIX_SOCKETS
+	fte = __lock(sockfd, receive, !receive);
+	fdes = fte && fte->mode == S_IFSOCK ? fte->fdes : EOF;
+	if(fdes == EOF)
+		errno = EBADF;
+#endif
+
+	for(i = 0; fdes != EOF && i < vlen; i++)
+	{
+		msg = &msgvec[i].msg_hdr;
+		if(msg->msg_iovlen != 1)
+		{
+			errno = EINVAL;
+			break;
+		}
+
+		if(receive)
+		{
+			res = lwip_recvfrom(fdes, msg->msg_iov->iov_base, msg->msg_iov->iov_len, flags,
+					(struct sockaddr*)msg->msg_name, msg->msg_name ? &msg->msg_namelen : NULL);
+			// only wait for the first datagram
+			flags |= MSG_DONTWAIT;
+		}
+		else
+			res = lwip_sendto(fdes, msg->msg_iov->iov_base, msg->msg_iov->iov_len, flags,
+					(struct sockaddr*)msg->msg_name, msg->msg_namelen);
+
+		if(res < 0)
+			break;
+		msgvec[i].msg_len = res;
+	}
+
+#if ENABLE_LIKEPOSIX_SOCKETS
+	if(fte)
+		__unlock(fte, receive, !receive);
+#endif
+
+	return i > 0 ? (int)i : EOF;
+}
+
+/**
+ * sends several datagrams in one call, for sending at high rates. the socket is looked up
+ * and locked once for the batch, rather than once for each datagram.
+ *
+ * @param   sockfd is a SOCK_DGRAM socket.
+ * @param   msgvec is an array of datagrams, each with one iovec, and the address to send
+ *          it to in msg_name, or NULL if the socket is connected. msg_iovlen must be 1,
+ *          gather from several iovecs is not supported, and fails with EINVAL.
+ * @param   vlen is the length of msgvec.
+ * @param   flags are the flags passed to sendto().
+ * @retval  returns the number of datagrams sent, msg_len is set to the length sent for each,
+ *          0 if vlen is 0, or -1 if none were sent, with errno set to EBADF if sockfd is
+ *          not a socket.
+ */
+int sendmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen, int flags)
+{
+	return __mmsg(sockfd, msgvec, vlen, flags, false);
+}
+
+/**
+ * receives several datagrams in one call. waits for the first datagram as recvfrom() would,
+ * then takes the datagrams that have already arrived, without waiting.
+ *
+ * @param   sockfd is a SOCK_DGRAM socket.
+ * @param   msgvec is an array of buffers, each with one iovec, and room for the sender address
+ *          in msg_name, or NULL. msg_iovlen must be 1, scatter to several iovecs is not
+ *          supported, and fails with EINVAL.
+ * @param   vlen is the length of msgvec.
+ * @param   flags are the flags passed to recvfrom().
+ * @param   timeout is not supported, set to NULL. use SO_RCVTIMEO or MSG_DONTWAIT.
+ * @retval  returns the number of datagrams received, msg_len is set to the length of each,
+ *          0 if vlen is 0, or -1 if none were received, with errno set to EBADF if sockfd
+ *          is not a socket.
+ */
+int recvmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen, int flags, struct timespec* timeout)
+{
+	(void)timeout;
+	return __mmsg(sockfd, msgvec, vlen, flags, true);
+}
+
 #endif
 /**
  * @}
@@ -35,6 +35,7 @@
 #define LIKE_POSIX_SYSCALLS_H_
 
 #include <stdint.h>
+#include <sys/types.h>
 
 #if USE_LIKEPOSIX
 #include "likeposix_config.h"
@@ -132,6 +133,7 @@ dev_ioctl_t* install_device(const char* name,
 							unsigned int buffersize);
 int file_table_open_files();
 int file_table_hwm();
+int posix_fallocate(int file, off_t offset, off_t len);
 
 #endif
 
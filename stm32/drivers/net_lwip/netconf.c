@@ -37,6 +37,7 @@
 #include "netconf.h"
 #include "logger.h"
 #include "confparse.h"
+#include "confstore.h"
 
 
 #if USE_CONFPARSE
@@ -137,9 +138,9 @@ bool string_to_mac_address(uint8_t* address, const uint8_t* macaddr)
 void net_config(netconf_t* netconf, const char* resolv, const char* interface)
 {
 	logger_t log;
-	config_parser_t cfg;
-	uint8_t buffer[64];
+	config_store_t store;
 	const char* prot;
+	const char* macaddr;
 	const char* hostname;
 	bool mac_configured = false;
 	bool ip_configured = false;
@@ -150,8 +151,11 @@ void net_config(netconf_t* netconf, const char* resolv, const char* interface)
 
 	log_init(&log, __FUNCTION__);
 
+	// parse the resolv file once for all of its settings
+	config_store_load(&store, resolv);
+
 	// check for configuration protocol
-	prot = (const char*)get_config_value_by_key(buffer, sizeof(buffer), (const uint8_t*)resolv, (const uint8_t*)"resolv");
+	prot = config_store_get_string(&store, "resolv", "static");
 	if(strcmp("dhcp", prot) == 0)
 		netconf->resolv = NET_RESOLV_DHCP;
 	else
@@ -160,12 +164,14 @@ void net_config(netconf_t* netconf, const char* resolv, const char* interface)
 
 #if LWIP_NETIF_HOSTNAME
 	// check for hostname
-	hostname = (const char*)get_config_value_by_key(buffer, sizeof(buffer), (const uint8_t*)resolv, (const uint8_t*)"hostname");
+	hostname = config_store_get_string(&store, "hostname", "");
 	strncpy((char*)netconf->hostname, (const char*)hostname, sizeof(netconf->hostname)-1);
 	netconf->netif.hostname = (char*)netconf->hostname;
 	log_info(&log, "%s: %s=%s", resolv, "hostname", hostname);
 #endif
 
+	config_store_free(&store);
+
 	//we must not allow the device to be configured with static data from flash - MAC/IP address conflicts will arise
 	netconf->addr_cache[0].addr = 0;
 	netconf->addr_cache[1].addr = 0;
@@ -178,34 +184,31 @@ void net_config(netconf_t* netconf, const char* resolv, const char* interface)
 	memset(netconf->netif.hwaddr, 0, sizeof(netconf->netif.hwaddr));
 
 	// load settings from the config file
-	if(open_config_file(&cfg, buffer, sizeof(buffer), (const uint8_t*)interface))
+	if(config_store_load(&store, interface))
 	{
-		while(get_next_config(&cfg))
+		// only set details if static IP is required
+		if(netconf->resolv == NET_RESOLV_STATIC)
+		{
+			ip_configured = config_store_get_ip(&store, "ipaddr", (uint8_t*)&(netconf->addr_cache[0].addr));
+			nm_configured = config_store_get_ip(&store, "netmask", (uint8_t*)&(netconf->addr_cache[1].addr));
+			gw_configured = config_store_get_ip(&store, "gateway", (uint8_t*)&(netconf->addr_cache[2].addr));
+			dns1_configured = config_store_get_ip(&store, "dns1", (uint8_t*)&(netconf->addr_cache[3].addr));
+			dns2_configured = config_store_get_ip(&store, "dns2", (uint8_t*)&(netconf->addr_cache[4].addr));
+			log_info(&log, "%s: ipaddr=%s netmask=%s gateway=%s", interface,
+					config_store_get_string(&store, "ipaddr", "none"),
+					config_store_get_string(&store, "netmask", "none"),
+					config_store_get_string(&store, "gateway", "none"));
+		}
+		// always set mac address
+		macaddr = config_store_get_string(&store, "macaddr", NULL);
+		if(macaddr)
 		{
-			log_info(&log, "%s: %s=%s", interface, get_config_key(&cfg), get_config_value(&cfg));
-			// only set details if static IP is required
-			if(netconf->resolv == NET_RESOLV_STATIC)
-			{
-				if(config_key_match(&cfg, (const uint8_t*)"ipaddr"))
-					ip_configured = string_to_address((uint8_t*)&(netconf->addr_cache[0].addr), get_config_value(&cfg));
-				else if(config_key_match(&cfg, (const uint8_t*)"netmask"))
-					nm_configured = string_to_address((uint8_t*)&(netconf->addr_cache[1].addr), get_config_value(&cfg));
-				else if(config_key_match(&cfg, (const uint8_t*)"gateway"))
-					gw_configured = string_to_address((uint8_t*)&(netconf->addr_cache[2].addr), get_config_value(&cfg));
-				else if(config_key_match(&cfg, (const uint8_t*)"dns1"))
-					dns1_configured = string_to_address((uint8_t*)&(netconf->addr_cache[3].addr), get_config_value(&cfg));
-				else if(config_key_match(&cfg, (const uint8_t*)"dns2"))
-					dns2_configured = string_to_address((uint8_t*)&(netconf->addr_cache[4].addr), get_config_value(&cfg));
-			}
-			// always set mac address
-			if(config_key_match(&cfg, (const uint8_t*)"macaddr"))
-			{
-				mac_configured = string_to_mac_address(netconf->netif.hwaddr, get_config_value(&cfg));
-				netconf->netif.hwaddr_len = ETHARP_HWADDR_LEN;
-			}
+			mac_configured = string_to_mac_address(netconf->netif.hwaddr, (const uint8_t*)macaddr);
+			netconf->netif.hwaddr_len = ETHARP_HWADDR_LEN;
+			log_info(&log, "%s: macaddr=%s", interface, macaddr);
 		}
-		close_config_file(&cfg);
 	}
+	config_store_free(&store);
 
 	// at least the mac address has to have been configured
 	assert_true(mac_configured);
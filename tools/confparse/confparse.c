@@ -44,6 +44,7 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include "confparse.h"
+#include "confstore.h"
 
 /**
  * @brief 	opens a config file for parsing.
@@ -96,6 +97,7 @@ void close_config_file(config_parser_t* cfg)
 /**
  * @brief 	reads the current line from the config file.
  * 			this function is used to iterate over all config entries.
+ * 			note that changes held in the config journal are not seen, use a config store to see them.
  * @param   cfg pointer to an initialised config parser structure.
  * @retval  returns true if a line was read successfully. does not indicate that the line held a key:value pair.
  *          returns false if the end of the file is reached.
@@ -271,7 +273,10 @@ const uint8_t* get_config_comment(config_parser_t* cfg)
 /**
  * @brief	checks if a key exists in the file, and returns its value.
  *
- * @param buffer is a pointer to some memory to use. must be long enough to hold one line from the config file.
+ * changes held in the config journal are taken into account.
+ * to look up more than one key, use a config store directly.
+ *
+ * @param buffer is a pointer to some memory to use. must be long enough to hold the value.
  * @param buffer_length is the length of the buffer memory in  bytes.
  * @param filepath is the path to the config file.
  * @param key is the key string to write.
@@ -280,22 +285,22 @@ const uint8_t* get_config_comment(config_parser_t* cfg)
  */
 const uint8_t* get_config_value_by_key(uint8_t* buffer, uint16_t buffer_length, const uint8_t* filepath, const uint8_t* key)
 {
-	config_parser_t cfg;
-
+	config_store_t store;
+	const char* value;
+	const uint8_t* ret = NULL;
 
-	if(open_config_file(&cfg, buffer, buffer_length, filepath))
+	if(config_store_load(&store, (const char*)filepath))
 	{
-		while(get_next_config(&cfg))
+		value = config_store_get_string(&store, (const char*)key, NULL);
+		if(value && strlen(value) < buffer_length)
 		{
-			if(config_key_match(&cfg, key))
-			{
-				close_config_file(&cfg);
-				return get_config_value(&cfg);
-			}
+			strcpy((char*)buffer, value);
+			ret = buffer;
 		}
-		close_config_file(&cfg);
 	}
-	return NULL;
+	config_store_free(&store);
+
+	return ret;
 }
 
 /**
@@ -318,12 +323,16 @@ bool add_config_entry(uint8_t* buffer, uint16_t buffer_length, const uint8_t* fi
     // check if file exists
     if(stat((const char*)filepath, &st) == EOF)
     {
-    	// if not just create a new one and add the entry
+    	// if not just create a new one and add the entry,
+    	// discarding any journal left behind by a deleted file
+    	snprintf((char*)buffer, buffer_length, "%s" CONFIG_JOURNAL_EXT, filepath);
+    	unlink((const char*)buffer);
     	newconf = fopen((const char*)filepath, "w");
     	if(newconf != NULL)
     	{
 			fprintf(newconf, "%s %s\n", (const char*)key, (const char*)value);
 			fclose(newconf);
+			config_changed();
 			return true;
     	}
     }
@@ -339,7 +348,9 @@ bool add_config_entry(uint8_t* buffer, uint16_t buffer_length, const uint8_t* fi
 /**
  * @brief edits a key/value entry to a config file.
  *
- * the file must already exist. a backup is created and left behind after modification.
+ * the file must already exist. the change is appended to the config journal and
+ * the file itself is only rewritten when the journal is compacted, see config_store_set().
+ * read the file with a config store, or get_config_value_by_key(), to see journaled changes.
  *
  * - if the file does not exist, exits immediately.
  * - if the key exists in the file, its value is modified.
@@ -347,90 +358,21 @@ bool add_config_entry(uint8_t* buffer, uint16_t buffer_length, const uint8_t* fi
  * - whitespace is not guaranteed to be retained
  * - comments will be retained
  *
- * @param buffer is a pointer to some memory to use. must be long enough to hold one line from the config file.
- * @param buffer_length is the length of the buffer memory in  bytes.
+ * @param buffer is not used, retained for compatibility.
+ * @param buffer_length is not used, retained for compatibility.
  * @param filepath is the path to the config file.
  * @param key is the key string to write.
  * @param value is the value string to write.
  */
 bool edit_config_entry(uint8_t* buffer, uint16_t buffer_length, const uint8_t* filepath, const uint8_t* key, const uint8_t* value)
 {
-    bool set = false;
-    FILE* newconf;
-    config_parser_t cfg;
-    cfg.buffer = buffer;
-    cfg.buffer_length = buffer_length;
-    cfg.key = NULL;
-    cfg.value = NULL;
-    cfg.retain_comments_newlines = true;
-    const char* k;
-	const char* v;
-    const char* c;
-
-    // use buffer temporarily to create backup config file name
-    snprintf((char*)buffer, buffer_length-1, "%s.bak", filepath);
-
-    // remove old backup if needed
-    unlink((const char*)buffer);
-
-    if(rename((const char*)filepath, (const char*)buffer) != -1)
-    {
-    	// open backup for reading
-    	cfg.file = fopen((const char*)buffer, "r");
-        if(cfg.file != NULL)
-        {
-        	// create new version of the config file
-        	newconf = fopen((const char*)filepath, "w");
-            if(newconf != NULL)
-			{
-            	// iterate over entries in backup
-				while(get_next_config(&cfg))
-				{
-					k = (const char*)get_config_key(&cfg);
-					v = (const char*)get_config_value(&cfg);
-					c = (const char*)get_config_comment(&cfg);
-
-					if(!c && !k && !v)
-					{
-						// the line contained only a comment - no key/value
-						fputs((const char*)cfg.buffer, newconf);
-					}
-					else if(config_key_match(&cfg, key))
-					{
-						// if we matched the desired key, add it with the new value
-						if(c)
-							fprintf(newconf, "%s %s #%s", (const char*)key, (const char*)value, c);
-						else
-							fprintf(newconf, "%s %s\n", (const char*)key, (const char*)value);
-						set = true;
-					}
-					else
-					{
-						if(k && v && c)
-							fprintf(newconf, "%s %s #%s", k, v, c);
-						else if(k && v)
-							fprintf(newconf, "%s %s\n", k, v);
-					}
-				}
-
-				// if we get here and the key wasnt modified, add it
-				if(!set)
-				{
-					// if we matched the desired key, add it with the new value
-					fprintf(newconf, "%s %s", (const char*)key, (const char*)value);
-					set = true;
-				}
-				// close new config
-				fclose(newconf);
-			}
-            // close backup file
-			close_config_file(&cfg);
-        }
-    }
+	(void)buffer;
+	(void)buffer_length;
 
-    cfg.retain_comments_newlines = false;
+	if(!config_file_exists(filepath))
+		return false;
 
-    return set;
+	return config_set((const char*)filepath, (const char*)key, (const char*)value);
 }
 
 /**
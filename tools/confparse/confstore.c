@@ -0,0 +1,728 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+* @addtogroup confparse
+*
+* The config store reads a config file with a single read, parses every line
+* once and keeps the key/value pairs in a hash table.
+*
+* The file format is the same as that read by get_next_config().
+* Where a key appears more than once, the first occurrence is used.
+*
+* Changes are not written to the config file directly. Each change is appended to a
+* journal file, named as the config file with CONFIG_JOURNAL_EXT added, as a record
+* followed by a commit record:
+*
+* @code
+* key value
+* @checksum
+* @endcode
+*
+* The commit record holds the FNV-1a hash of the record line before it, in hex.
+* A record is only applied when its commit record is complete and the hash
+* matches, so a write that is cut short by a power loss is ignored.
+*
+* When the journal grows past CONFIG_JOURNAL_MAX_SIZE, it is compacted into the config file.
+* The new config file is written in full to a temporary file and synced before the
+* old file is replaced and the journal removed. If power is lost at any point, either the
+* old config file and journal, or the new config file, describe the latest settings.
+*
+* @{
+* @file confstore.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "confstore.h"
+
+#define CONFIG_ENTRY_JOURNALED	0x01	///< set on entries whose key is not in the config file
+
+#define CONFIG_JOURNAL_COMMIT	'@'
+
+typedef struct {
+	const char* key;
+	int keylen;
+	const char* value;
+	int valuelen;
+} config_line_t;
+
+/**
+ * counts changes made to config files via this module, used to detect stale stores.
+ */
+static volatile uint32_t config_generation;
+
+/**
+ * FNV-1a hash of a string.
+ */
+static uint32_t config_hash(const char* str, int length)
+{
+	uint32_t hash = 2166136261u;
+	while(length--)
+	{
+		hash ^= (uint8_t)*str++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static config_entry_t* config_store_find(config_store_t* store, const char* key, int keylen)
+{
+	uint32_t hash = config_hash(key, keylen);
+	config_entry_t* entry = store->buckets[hash & (CONFIG_STORE_BUCKETS-1)];
+
+	while(entry)
+	{
+		if(entry->hash == hash && !strncmp(entry->key, key, keylen) && entry->key[keylen] == '\0')
+			return entry;
+		entry = entry->next;
+	}
+	return NULL;
+}
+
+/**
+ * adds a new entry to the store. does not check if the key already exists.
+ */
+static config_entry_t* config_store_add(config_store_t* store, const char* key, int keylen, const char* value, int valuelen, uint8_t flags)
+{
+	config_entry_t* entry = malloc(sizeof(config_entry_t) + keylen + valuelen + 2);
+
+	if(entry)
+	{
+		memcpy(entry->key, key, keylen);
+		entry->key[keylen] = '\0';
+		entry->value = entry->key + keylen + 1;
+		memcpy(entry->value, value, valuelen);
+		entry->value[valuelen] = '\0';
+		entry->flags = flags;
+		entry->hash = config_hash(key, keylen);
+		entry->next = store->buckets[entry->hash & (CONFIG_STORE_BUCKETS-1)];
+		store->buckets[entry->hash & (CONFIG_STORE_BUCKETS-1)] = entry;
+		store->entries++;
+	}
+	return entry;
+}
+
+/**
+ * adds an entry to the store, or replaces the value of an existing one.
+ */
+static bool config_store_put(config_store_t* store, const char* key, int keylen, const char* value, int valuelen)
+{
+	config_entry_t** link;
+	config_entry_t* entry = config_store_find(store, key, keylen);
+	uint8_t flags = CONFIG_ENTRY_JOURNALED;
+
+	if(entry)
+	{
+		if((int)strlen(entry->value) == valuelen && !strncmp(entry->value, value, valuelen))
+			return true;
+
+		flags = entry->flags;
+		for(link = &store->buckets[entry->hash & (CONFIG_STORE_BUCKETS-1)]; *link != entry; link = &(*link)->next);
+		*link = entry->next;
+		free(entry);
+		store->entries--;
+	}
+
+	return config_store_add(store, key, keylen, value, valuelen, flags) != NULL;
+}
+
+static void config_store_clear(config_store_t* store)
+{
+	config_entry_t* entry;
+	config_entry_t* next;
+	int i;
+
+	for(i = 0; i < CONFIG_STORE_BUCKETS; i++)
+	{
+		for(entry = store->buckets[i]; entry; entry = next)
+		{
+			next = entry->next;
+			free(entry);
+		}
+		store->buckets[i] = NULL;
+	}
+	store->entries = 0;
+}
+
+#define is_space(c)		((c) == ' ' || (c) == '\t')
+#define is_eol(c)		((c) == '\r' || (c) == '\n' || (c) == '#' || (c) == '\0')
+
+/**
+ * finds the key and value on one line of config data.
+ * for comments, blank and corrupt lines, line->keylen or line->valuelen is 0.
+ *
+ * @retval returns a pointer to the start of the next line.
+ */
+static const char* config_parse_line(const char* data, const char* end, config_line_t* line)
+{
+	// skip leading whitespace
+	while(data < end && is_space(*data))
+		data++;
+
+	line->key = data;
+	while(data < end && !is_space(*data) && !is_eol(*data))
+		data++;
+	line->keylen = data - line->key;
+
+	while(data < end && is_space(*data))
+		data++;
+
+	line->value = data;
+	while(data < end && !is_space(*data) && !is_eol(*data))
+		data++;
+	line->valuelen = data - line->value;
+
+	// skip to the start of the next line
+	while(data < end && *data != '\n')
+		data++;
+
+	return data < end ? data + 1 : end;
+}
+
+/**
+ * parses the config lines in data into the store.
+ */
+static void config_store_parse(config_store_t* store, const char* data, const char* end)
+{
+	config_line_t line;
+
+	while(data < end)
+	{
+		data = config_parse_line(data, end, &line);
+
+		// the first occurrence of a key wins, as with get_config_value_by_key()
+		if(line.keylen && line.valuelen && !config_store_find(store, line.key, line.keylen))
+			config_store_add(store, line.key, line.keylen, line.value, line.valuelen, 0);
+	}
+}
+
+/**
+ * applies the committed records in journal data to the store.
+ */
+static void config_store_replay(config_store_t* store, const char* data, const char* end)
+{
+	config_line_t line;
+	config_line_t record;
+	const char* record_start = NULL;
+	int record_length = 0;
+	const char* next;
+	unsigned long checksum;
+	char* check_end;
+
+	while(data < end)
+	{
+		next = config_parse_line(data, end, &line);
+
+		if(line.keylen && *line.key == CONFIG_JOURNAL_COMMIT)
+		{
+			// only whole commit records with a matching checksum are accepted
+			checksum = strtoul(line.key + 1, &check_end, 16);
+			if(record_start && next[-1] == '\n' && check_end == line.key + line.keylen &&
+			   checksum == config_hash(record_start, record_length))
+				config_store_put(store, record.key, record.keylen, record.value, record.valuelen);
+			record_start = NULL;
+		}
+		else if(line.keylen && line.valuelen)
+		{
+			record = line;
+			record_start = line.key;
+			record_length = line.value + line.valuelen - line.key;
+		}
+
+		data = next;
+	}
+}
+
+/**
+ * @retval returns a new string holding filepath with ext appended, to be freed by the caller.
+ */
+static char* config_path(const char* filepath, const char* ext)
+{
+	char* path = malloc(strlen(filepath) + strlen(ext) + 1);
+	if(path)
+	{
+		strcpy(path, filepath);
+		strcat(path, ext);
+	}
+	return path;
+}
+
+/**
+ * reads a whole file with a single read.
+ *
+ * @param length is set to the number of bytes read.
+ * @retval returns the file data, to be freed by the caller, or NULL if the file could not be read.
+ */
+static char* config_read_file(const char* filepath, int* length)
+{
+	struct stat st;
+	char* data = NULL;
+	int fd = open(filepath, O_RDONLY);
+
+	if(fd == -1)
+		return NULL;
+
+	if(fstat(fd, &st) != -1 && (data = malloc(st.st_size + 1)))
+	{
+		*length = read(fd, data, st.st_size);
+		if(*length < 0)
+		{
+			free(data);
+			data = NULL;
+		}
+	}
+
+	close(fd);
+	return data;
+}
+
+/**
+ * @retval returns the size of a file, or -1 if it does not exist.
+ */
+static int32_t config_file_size(const char* filepath)
+{
+	struct stat st;
+	return stat(filepath, &st) == -1 ? -1 : (int32_t)st.st_size;
+}
+
+/**
+ * completes a compaction that was interrupted after the old config file was removed.
+ */
+static void config_recover(const char* filepath)
+{
+	struct stat st;
+	char* tmppath = config_path(filepath, CONFIG_COMPACT_EXT);
+
+	if(tmppath)
+	{
+		if(stat(filepath, &st) == -1 && stat(tmppath, &st) != -1)
+			rename(tmppath, filepath);
+		free(tmppath);
+	}
+}
+
+/**
+ * @brief	reads a config file into a config store.
+ *
+ * the whole file is read into a temporary buffer, parsed and the buffer freed.
+ * committed changes in the journal are then applied.
+ * on failure the store is initialised empty, and may still be used with the get functions,
+ * which then return their default values.
+ *
+ * @param store is a pointer to an uninitialised config store.
+ * @param filepath is the path to the config file.
+ * @retval returns true if the file was read successfully, false otherwise.
+ */
+bool config_store_load(config_store_t* store, const char* filepath)
+{
+	memset(store, 0, sizeof(config_store_t));
+
+	store->filepath = malloc(strlen(filepath) + 1);
+	if(!store->filepath)
+		return false;
+	strcpy(store->filepath, filepath);
+	store->size = -1;
+
+	return config_store_refresh(store);
+}
+
+/**
+ * @brief	frees all memory held by a config store.
+ */
+void config_store_free(config_store_t* store)
+{
+	config_store_clear(store);
+	free(store->filepath);
+	store->filepath = NULL;
+}
+
+/**
+ * @brief	tests if the config file has changed since the store was loaded.
+ *
+ * like-posix does not keep file modification times, so a change is detected
+ * when the file size differs, or when config_changed() has been called.
+ *
+ * @retval returns true if the store needs to be reloaded.
+ */
+bool config_store_stale(config_store_t* store)
+{
+	if(store->generation != config_generation)
+		return true;
+	return config_file_size(store->filepath) != store->size;
+}
+
+/**
+ * @brief	reloads the config store if the config file has changed since it was loaded.
+ *
+ * @param store is a pointer to a config store, initialised by config_store_load().
+ * @retval returns false if the store needed reloading and the file could not be read.
+ */
+bool config_store_refresh(config_store_t* store)
+{
+	char* data;
+	char* path;
+	int length;
+
+	if(store->size != -1 && !config_store_stale(store))
+		return true;
+
+	config_store_clear(store);
+	store->generation = config_generation;
+	store->size = -1;
+	store->journal_size = 0;
+
+	data = config_read_file(store->filepath, &length);
+	if(!data)
+	{
+		config_recover(store->filepath);
+		data = config_read_file(store->filepath, &length);
+		if(!data)
+			return false;
+	}
+
+	store->size = length;
+	config_store_parse(store, data, data + length);
+	free(data);
+
+	path = config_path(store->filepath, CONFIG_JOURNAL_EXT);
+	if(path)
+	{
+		data = config_read_file(path, &length);
+		if(data)
+		{
+			store->journal_size = length;
+			config_store_replay(store, data, data + length);
+			free(data);
+		}
+		free(path);
+	}
+
+	return true;
+}
+
+/**
+ * @brief	marks all config stores as stale.
+ *
+ * should be called after a config file is modified. functions in this module
+ * that modify config files call it automatically.
+ */
+void config_changed()
+{
+	config_generation++;
+}
+
+/**
+ * @brief	sets the value of a key in a config file, via the journal.
+ *
+ * the change is appended to the journal as one transaction and synced. the config
+ * file is compacted when the journal grows past CONFIG_JOURNAL_MAX_SIZE.
+ *
+ * @param store is a pointer to a config store, initialised by config_store_load().
+ * @param key is the key to set. may not contain whitespace, '#', or start with '@'.
+ * @param value is the value to set. may not contain whitespace or '#'.
+ * @retval returns true if the change was committed.
+ */
+bool config_store_set(config_store_t* store, const char* key, const char* value)
+{
+	const char* c;
+	char* path;
+	char* record;
+	int keylen = strlen(key);
+	int valuelen = strlen(value);
+	int length;
+	int fd;
+	bool ret = false;
+
+	if(!keylen || !valuelen || *key == CONFIG_JOURNAL_COMMIT)
+		return false;
+	for(c = key; *c; c++)
+		if(is_space(*c) || is_eol(*c))
+			return false;
+	for(c = value; *c; c++)
+		if(is_space(*c) || is_eol(*c))
+			return false;
+
+	// pick up changes made by others before appending
+	config_store_refresh(store);
+
+	c = config_store_get_string(store, key, NULL);
+	if(c && !strcmp(c, value))
+		return true;
+
+	path = config_path(store->filepath, CONFIG_JOURNAL_EXT);
+	record = malloc(keylen + valuelen + 15);
+
+	if(path && record)
+	{
+		// the record and its commit record are written with a single write.
+		// the leading newline separates them from any partial record left by an earlier failed write.
+		length = sprintf(record, "\n%s %s", key, value);
+		length += sprintf(record + length, "\n%c%08lx\n", CONFIG_JOURNAL_COMMIT, (unsigned long)config_hash(record + 1, length - 1));
+
+		fd = open(path, O_WRONLY|O_CREAT|O_APPEND, 0666);
+		if(fd != -1)
+		{
+			ret = write(fd, record, length) == length;
+			ret = fsync(fd) == 0 && ret;
+			close(fd);
+		}
+	}
+
+	free(record);
+	free(path);
+
+	if(ret)
+	{
+		config_store_put(store, key, keylen, value, valuelen);
+		store->journal_size += length;
+
+		config_changed();
+		store->generation = config_generation;
+
+		if(store->journal_size > CONFIG_JOURNAL_MAX_SIZE)
+			config_store_compact(store);
+	}
+
+	return ret;
+}
+
+/**
+ * @brief	sets the value of a key in a config file, via the journal.
+ *
+ * as config_store_set(), for use when no config store is held for the file.
+ *
+ * @param filepath is the path to the config file.
+ * @param key is the key to set.
+ * @param value is the value to set.
+ * @retval returns true if the change was committed.
+ */
+bool config_set(const char* filepath, const char* key, const char* value)
+{
+	config_store_t store;
+	bool ret = config_store_load(&store, filepath) && config_store_set(&store, key, value);
+	config_store_free(&store);
+	return ret;
+}
+
+/**
+ * @brief	writes the settings in a config store back to the config file, and removes the journal.
+ *
+ * comments and layout in the config file are retained, values are updated in place
+ * and keys that were not in the file are appended to it.
+ *
+ * @param store is a pointer to a config store, initialised by config_store_load().
+ * @retval returns true if the config file was rewritten.
+ */
+bool config_store_compact(config_store_t* store)
+{
+	config_line_t line;
+	config_entry_t* entry;
+	const char* ptr;
+	const char* next;
+	char* data;
+	char* tmppath = config_path(store->filepath, CONFIG_COMPACT_EXT);
+	char* jnlpath = config_path(store->filepath, CONFIG_JOURNAL_EXT);
+	FILE* file = NULL;
+	bool ret = false;
+	int length = 0;
+	int i;
+
+	config_store_refresh(store);
+
+	data = config_read_file(store->filepath, &length);
+
+	if(data && tmppath && jnlpath)
+	{
+		unlink(tmppath);
+		file = fopen(tmppath, "w");
+	}
+
+	if(file)
+	{
+		for(ptr = data; ptr < data + length; ptr = next)
+		{
+			next = config_parse_line(ptr, data + length, &line);
+			entry = line.keylen && line.valuelen ? config_store_find(store, line.key, line.keylen) : NULL;
+			if(entry)
+			{
+				// replace the value, keep the rest of the line
+				fwrite(ptr, 1, line.value - ptr, file);
+				fputs(entry->value, file);
+				ptr = line.value + line.valuelen;
+			}
+			fwrite(ptr, 1, next - ptr, file);
+		}
+
+		if(length && data[length-1] != '\n')
+			fputc('\n', file);
+
+		for(i = 0; i < CONFIG_STORE_BUCKETS; i++)
+		{
+			for(entry = store->buckets[i]; entry; entry = entry->next)
+			{
+				if(entry->flags & CONFIG_ENTRY_JOURNALED)
+					fprintf(file, "%s %s\n", entry->key, entry->value);
+			}
+		}
+
+		ret = fflush(file) == 0 && fsync(fileno(file)) == 0 && !ferror(file);
+		fclose(file);
+
+		// the old file may only be replaced once the new one is complete
+		if(ret)
+		{
+			unlink(store->filepath);
+			ret = rename(tmppath, store->filepath) == 0;
+		}
+		if(ret)
+		{
+			unlink(jnlpath);
+
+			for(i = 0; i < CONFIG_STORE_BUCKETS; i++)
+				for(entry = store->buckets[i]; entry; entry = entry->next)
+					entry->flags &= ~CONFIG_ENTRY_JOURNALED;
+
+			config_changed();
+			store->generation = config_generation;
+			store->journal_size = 0;
+			store->size = config_file_size(store->filepath);
+		}
+	}
+
+	free(data);
+	free(tmppath);
+	free(jnlpath);
+
+	return ret;
+}
+
+/**
+ * @param store is a pointer to an initialised config store.
+ * @param key is the key to look up.
+ * @param def is the value to return if the key is not found.
+ * @retval returns the value string for the specified key, or def.
+ */
+const char* config_store_get_string(config_store_t* store, const char* key, const char* def)
+{
+	config_entry_t* entry = config_store_find(store, key, strlen(key));
+	return entry ? entry->value : def;
+}
+
+/**
+ * @param store is a pointer to an initialised config store.
+ * @param key is the key to look up.
+ * @param def is the value to return if the key is not found or is not a number.
+ * @retval returns the value for the specified key as an integer, decimal, hex (0x) or octal (0), or def.
+ */
+int config_store_get_int(config_store_t* store, const char* key, int def)
+{
+	config_entry_t* entry = config_store_find(store, key, strlen(key));
+	char* end;
+	long value;
+
+	if(!entry)
+		return def;
+
+	value = strtol(entry->value, &end, 0);
+	return *end == '\0' ? (int)value : def;
+}
+
+/**
+ * @param store is a pointer to an initialised config store.
+ * @param key is the key to look up.
+ * @param def is the value to return if the key is not found or is not a boolean.
+ * @retval returns true for the values 1, true, yes, on, enabled,
+ * 			false for the values 0, false, no, off, disabled, or def.
+ */
+bool config_store_get_bool(config_store_t* store, const char* key, bool def)
+{
+	static const char* true_values[] = {"1", "true", "yes", "on", "enabled", NULL};
+	static const char* false_values[] = {"0", "false", "no", "off", "disabled", NULL};
+	config_entry_t* entry = config_store_find(store, key, strlen(key));
+	const char** v;
+
+	if(entry)
+	{
+		for(v = true_values; *v; v++)
+			if(!strcmp(*v, entry->value))
+				return true;
+		for(v = false_values; *v; v++)
+			if(!strcmp(*v, entry->value))
+				return false;
+	}
+	return def;
+}
+
+/**
+ * @param store is a pointer to an initialised config store.
+ * @param key is the key to look up.
+ * @param address is a pointer to 4 bytes of memory, in which to store the address
+ * 			parsed from a value in the form "192.168.0.1". address[0] holds the first octet,
+ * 			so it may be used directly as a network order in_addr.
+ * @retval returns true if the key was found and held a valid IPv4 address.
+ */
+bool config_store_get_ip(config_store_t* store, const char* key, uint8_t* address)
+{
+	config_entry_t* entry = config_store_find(store, key, strlen(key));
+	const char* ptr;
+	char* end;
+	unsigned long octet;
+	uint8_t addr[4];
+	int i;
+
+	if(!entry)
+		return false;
+
+	ptr = entry->value;
+	for(i = 0; i < 4; i++)
+	{
+		if(*ptr < '0' || *ptr > '9')
+			return false;
+		octet = strtoul(ptr, &end, 10);
+		if(octet > 255 || (i < 3 && *end != '.') || (i == 3 && *end != '\0'))
+			return false;
+		addr[i] = (uint8_t)octet;
+		ptr = end + 1;
+	}
+
+	memcpy(address, addr, sizeof(addr));
+	return true;
+}
+
+/**
+ * @}
+ */
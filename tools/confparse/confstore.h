@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+* @addtogroup confparse
+* @{
+*
+* The config store parses a whole config file once into a hash table in RAM.
+* Lookups are then made without any further file access.
+*
+* Examples:
+
+@code
+
+config_store_t store;
+if(config_store_load(&store, "/etc/http/httpd.conf"))
+{
+    int port = config_store_get_int(&store, "port", 80);
+    bool dhcp = config_store_get_bool(&store, "dhcp", true);
+    const char* name = config_store_get_string(&store, "name", "httpd");
+
+    // reloads the file only if it was changed since it was loaded
+    config_store_refresh(&store);
+
+    // appends the change to the journal, the config file is not rewritten
+    config_store_set(&store, "port", "8080");
+
+    config_store_free(&store);
+}
+
+@endcode
+
+*/
+
+#ifndef CONFSTORE_H_
+#define CONFSTORE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/**
+ * the number of hash buckets in a config store, must be a power of 2.
+ */
+#ifndef CONFIG_STORE_BUCKETS
+#define CONFIG_STORE_BUCKETS	16
+#endif
+
+/**
+ * the journal is compacted into the config file when it grows past this many bytes.
+ */
+#ifndef CONFIG_JOURNAL_MAX_SIZE
+#define CONFIG_JOURNAL_MAX_SIZE	512
+#endif
+
+#define CONFIG_JOURNAL_EXT		".jnl"	///< appended to a config file path to name its journal
+#define CONFIG_COMPACT_EXT		".tmp"	///< appended to a config file path to name the file written during compaction
+
+typedef struct _config_entry_t {
+	struct _config_entry_t* next;	///< the next entry in the same hash bucket
+	uint32_t hash;					///< the hash of the key
+	uint8_t flags;					///< internal flags
+	char* value;					///< the value string, stored after the key
+	char key[];						///< the key string
+} config_entry_t;
+
+typedef struct {
+	char* filepath;								///< the path to the config file
+	int32_t size;								///< the file size when it was loaded, -1 if not loaded
+	int32_t journal_size;						///< the journal size
+	uint32_t generation;						///< the config change count when it was loaded
+	uint16_t entries;							///< the number of entries in the store
+	config_entry_t* buckets[CONFIG_STORE_BUCKETS];	///< the hash table
+} config_store_t;
+
+bool config_store_load(config_store_t* store, const char* filepath);
+void config_store_free(config_store_t* store);
+bool config_store_refresh(config_store_t* store);
+bool config_store_stale(config_store_t* store);
+void config_changed();
+bool config_store_set(config_store_t* store, const char* key, const char* value);
+bool config_store_compact(config_store_t* store);
+bool config_set(const char* filepath, const char* key, const char* value);
+
+const char* config_store_get_string(config_store_t* store, const char* key, const char* def);
+int config_store_get_int(config_store_t* store, const char* key, int def);
+bool config_store_get_bool(config_store_t* store, const char* key, bool def);
+bool config_store_get_ip(config_store_t* store, const char* key, uint8_t* address);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif // CONFSTORE_H_
+
+ /**
+  * @}
+  */
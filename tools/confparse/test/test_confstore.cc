@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include "gtest/gtest.h"
+#include "confstore.h"
+
+/**
+ * each test works on a config file in a new temporary directory.
+ */
+class test_confstore : public ::testing::Test
+{
+protected:
+    char dir[32];
+    std::string path;
+    std::string journal;
+    std::string compact;
+
+    virtual void SetUp()
+    {
+        strcpy(dir, "/tmp/confstoreXXXXXX");
+        ASSERT_TRUE(mkdtemp(dir) != NULL);
+        path = std::string(dir) + "/test.conf";
+        journal = path + CONFIG_JOURNAL_EXT;
+        compact = path + CONFIG_COMPACT_EXT;
+    }
+
+    virtual void TearDown()
+    {
+        unlink(path.c_str());
+        unlink(journal.c_str());
+        unlink(compact.c_str());
+        rmdir(dir);
+    }
+
+    void write_file(const std::string& filepath, const char* text, const char* mode = "w")
+    {
+        FILE* file = fopen(filepath.c_str(), mode);
+        ASSERT_TRUE(file != NULL);
+        fputs(text, file);
+        fclose(file);
+    }
+
+    std::string read_file(const std::string& filepath)
+    {
+        std::string text;
+        char buffer[128];
+        size_t length;
+        FILE* file = fopen(filepath.c_str(), "r");
+        if(file)
+        {
+            while((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+                text.append(buffer, length);
+            fclose(file);
+        }
+        return text;
+    }
+
+    bool exists(const std::string& filepath)
+    {
+        struct stat st;
+        return stat(filepath.c_str(), &st) == 0;
+    }
+
+    /**
+     * a journal record and its commit record, as written by config_store_set().
+     */
+    std::string record(const char* line)
+    {
+        uint32_t hash = 2166136261u;
+        char commit[16];
+        for(const char* c = line; *c; c++)
+        {
+            hash ^= (uint8_t)*c;
+            hash *= 16777619u;
+        }
+        sprintf(commit, "@%08lx", (unsigned long)hash);
+        return std::string("\n") + line + "\n" + commit + "\n";
+    }
+};
+
+TEST_F(test_confstore, journal_replay)
+{
+    config_store_t store;
+
+    write_file(path, "port 80\nname httpd\n");
+    ASSERT_TRUE(config_store_load(&store, path.c_str()));
+    ASSERT_TRUE(config_store_set(&store, "port", "8080"));
+    ASSERT_TRUE(config_store_set(&store, "conns", "4"));
+    config_store_free(&store);
+
+    // the config file is left alone, the changes are in the journal
+    ASSERT_EQ(read_file(path), "port 80\nname httpd\n");
+    ASSERT_EQ(read_file(journal), record("port 8080") + record("conns 4"));
+
+    ASSERT_TRUE(config_store_load(&store, path.c_str()));
+    ASSERT_EQ(config_store_get_int(&store, "port", 0), 8080);
+    ASSERT_EQ(config_store_get_int(&store, "conns", 0), 4);
+    ASSERT_STREQ(config_store_get_string(&store, "name", NULL), "httpd");
+    config_store_free(&store);
+}
+
+TEST_F(test_confstore, partial_trailing_record)
+{
+    config_store_t store;
+    std::string torn = record("port 9090");
+
+    write_file(path, "port 80\n");
+    write_file(journal, (record("port 8080") + record("conns 4")).c_str());
+    // a record cut short in its commit record, and one with no commit record
+    write_file(journal, torn.substr(0, torn.size() - 4).c_str(), "a");
+    write_file(journal, "\nname torn", "a");
+
+    ASSERT_TRUE(config_store_load(&store, path.c_str()));
+    ASSERT_EQ(config_store_get_int(&store, "port", 0), 8080);
+    ASSERT_EQ(config_store_get_int(&store, "conns", 0), 4);
+    ASSERT_STREQ(config_store_get_string(&store, "name", "none"), "none");
+
+    // a later change is separated from the torn record, and applies
+    ASSERT_TRUE(config_store_set(&store, "name", "httpd"));
+    config_store_free(&store);
+
+    ASSERT_TRUE(config_store_load(&store, path.c_str()));
+    ASSERT_EQ(config_store_get_int(&store, "port", 0), 8080);
+    ASSERT_STREQ(config_store_get_string(&store, "name", NULL), "httpd");
+    config_store_free(&store);
+}
+
+TEST_F(test_confstore, bad_checksum)
+{
+    config_store_t store;
+    std::string good = record("port 8080");
+    std::string bad = record("port 9090");
+
+    // a corrupted checksum
+    bad[bad.size() - 2] = bad[bad.size() - 2] == '0' ? '1' : '0';
+
+    write_file(path, "port 80\n");
+    write_file(journal, (good + bad).c_str());
+    // a commit record that belongs to another record
+    write_file(journal, ("\nconns 4\n" + good.substr(good.find('@'))).c_str(), "a");
+    // a commit record with no record
+    write_file(journal, good.substr(good.find('@') - 1).c_str(), "a");
+
+    ASSERT_TRUE(config_store_load(&store, path.c_str()));
+    ASSERT_EQ(config_store_get_int(&store, "port", 0), 8080);
+    ASSERT_EQ(config_store_get_int(&store, "conns", 0), 0);
+    config_store_free(&store);
+}
+
+TEST_F(test_confstore, compact_keeps_comments)
+{
+    config_store_t store;
+
+    write_file(path, "# http settings\nport 80 # the listening port\n\n\tname  httpd\nfsroot /var/lib/httpd");
+    ASSERT_TRUE(config_store_load(&store, path.c_str()));
+    ASSERT_TRUE(config_store_set(&store, "port", "8080"));
+    ASSERT_TRUE(config_store_set(&store, "name", "web"));
+    ASSERT_TRUE(config_store_set(&store, "conns", "4"));
+    ASSERT_TRUE(exists(journal));
+
+    ASSERT_TRUE(config_store_compact(&store));
+    ASSERT_FALSE(exists(journal));
+    ASSERT_FALSE(exists(compact));
+    ASSERT_EQ(read_file(path), "# http settings\nport 8080 # the listening port\n\n\tname  web\nfsroot /var/lib/httpd\nconns 4\n");
+
+    // the store is still usable, and is up to date with the file
+    ASSERT_FALSE(config_store_stale(&store));
+    ASSERT_EQ(config_store_get_int(&store, "port", 0), 8080);
+    config_store_free(&store);
+
+    ASSERT_TRUE(config_store_load(&store, path.c_str()));
+    ASSERT_EQ(config_store_get_int(&store, "conns", 0), 4);
+    ASSERT_STREQ(config_store_get_string(&store, "name", NULL), "web");
+    config_store_free(&store);
+}
+
+TEST_F(test_confstore, compact_when_journal_full)
+{
+    config_store_t store;
+    char value[16];
+    int i;
+
+    write_file(path, "# counter\ncount 0\n");
+    ASSERT_TRUE(config_store_load(&store, path.c_str()));
+    for(i = 1; i <= 100; i++)
+    {
+        sprintf(value, "%d", i);
+        ASSERT_TRUE(config_store_set(&store, "count", value));
+        ASSERT_LE((int)read_file(journal).size(), CONFIG_JOURNAL_MAX_SIZE);
+    }
+    config_store_free(&store);
+
+    ASSERT_TRUE(config_store_load(&store, path.c_str()));
+    ASSERT_EQ(config_store_get_int(&store, "count", 0), 100);
+    config_store_free(&store);
+    ASSERT_EQ(read_file(path).find("# counter\n"), 0u);
+}
+
+TEST_F(test_confstore, recover_interrupted_compaction)
+{
+    config_store_t store;
+
+    // power was lost after the old config file was removed, before the new one was renamed
+    write_file(compact, "port 8080\nconns 4\n");
+    ASSERT_FALSE(exists(path));
+
+    ASSERT_TRUE(config_store_load(&store, path.c_str()));
+    ASSERT_EQ(config_store_get_int(&store, "port", 0), 8080);
+    ASSERT_EQ(config_store_get_int(&store, "conns", 0), 4);
+    config_store_free(&store);
+
+    ASSERT_TRUE(exists(path));
+    ASSERT_FALSE(exists(compact));
+    ASSERT_EQ(read_file(path), "port 8080\nconns 4\n");
+}
+
+TEST_F(test_confstore, no_recovery_with_config_file)
+{
+    config_store_t store;
+
+    // an incomplete compaction file is ignored while the config file exists
+    write_file(path, "port 80\n");
+    write_file(compact, "port 80");
+
+    ASSERT_TRUE(config_store_load(&store, path.c_str()));
+    ASSERT_EQ(config_store_get_int(&store, "port", 0), 80);
+    config_store_free(&store);
+    ASSERT_EQ(read_file(path), "port 80\n");
+}
+
+TEST_F(test_confstore, missing_file)
+{
+    config_store_t store;
+
+    ASSERT_FALSE(config_store_load(&store, path.c_str()));
+    ASSERT_EQ(config_store_get_int(&store, "port", 80), 80);
+    config_store_free(&store);
+}
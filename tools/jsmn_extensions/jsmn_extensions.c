@@ -33,6 +33,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <unistd.h>
 #include "jsmn_extensions.h"
 
 /**
@@ -53,17 +54,138 @@ jsmnerr_t json_init(json_t* json, jsmntok_t* tokens, int ntokens, char* input, i
     jsmn_parser parser;
     json->buffer = input;
     json->tokens = tokens;
+    json->ntokens = 0;
+    json->index = NULL;
     json->current_item = NULL;
     json->current_iterable = NULL;
     jsmn_init(&parser);
     jsmnerr_t e = jsmn_parse(&parser, input, length, tokens, ntokens);
     if(e > 0)
     {
+        json->ntokens = parser.toknext;
         json->current_item = tokens;
     }
     return e;
 }
 
+/**
+ * FNV-1a hash of an object key, combined with the index of the object token.
+ */
+static uint32_t json_key_hash(int object, const char* key, int length)
+{
+    uint32_t hash = 2166136261u ^ ((uint32_t)object * 2654435761u);
+    while(length--)
+    {
+        hash ^= (uint8_t)*key++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * builds a structural index over a parsed json structure, to speed up access.
+ *
+ * once built, the index is used by all of the access and iterator functions:
+ * - skipping over an array item or object value, including everything it contains, is O(1).
+ * - json_get_value_by_key() is O(1) on average, rather than a scan of the object.
+ *
+ * the index must be rebuilt if json_init() is called again.
+ *
+ * @param   json - pointer to the initialized json structure to index.
+ * @param   index will be fully initialized by this function.
+ * @param   next is a pointer to an array of at least as many elements as there are tokens.
+ * @param   keys is a pointer to an array of nkeys elements, for the key hash table.
+ * @param   nkeys is the number of elements in keys. must be a power of 2, larger than
+ *          the number of object keys in the json structure. twice the number of keys is good.
+ * @retval  returns the number of object keys indexed, or -1 if keys was too small,
+ *          or there are more tokens than next and keys can address (INT16_MAX).
+ *          on error the index is not used.
+ */
+int json_index(json_t* json, json_index_t* index, uint16_t* next, int16_t* keys, uint16_t nkeys)
+{
+    jsmntok_t* token;
+    int count = 0;
+    int parent;
+    int slot;
+    int i;
+
+    json->index = NULL;
+
+    // token indices are stored in next[] and keys[], which are 16 bit
+    if(!nkeys || (nkeys & (nkeys - 1)) || json->ntokens > INT16_MAX)
+        return -1;
+
+    index->next = next;
+    index->keys = keys;
+    index->nkeys = nkeys;
+
+    // tokens always follow their container, so working backwards the end of
+    // every token's contents is known before it is passed up to its container
+    for(i = 0; i < json->ntokens; i++)
+        next[i] = i + 1;
+    for(i = json->ntokens - 1; i >= 0; i--)
+    {
+        parent = json->tokens[i].parent;
+        if(parent >= 0 && next[i] > next[parent])
+            next[parent] = next[i];
+    }
+
+    for(i = 0; i < nkeys; i++)
+        keys[i] = -1;
+
+    // object keys are the first of each pair of object members
+    for(i = 0; i < json->ntokens; i++)
+    {
+        token = &json->tokens[i];
+        if(token->type != JSMN_OBJECT)
+            continue;
+
+        parent = i;
+        i++;
+        while(i < next[parent])
+        {
+            if(count >= nkeys - 1)
+                return -1;
+
+            slot = json_key_hash(parent, json->buffer + json->tokens[i].start, json->tokens[i].end - json->tokens[i].start);
+            while(keys[slot & (nkeys - 1)] != -1)
+                slot++;
+            keys[slot & (nkeys - 1)] = i;
+            count++;
+
+            // skip over the value
+            i = next[i] < next[parent] ? next[next[i]] : next[parent];
+        }
+        // nested objects are indexed by the outer loop too
+        i = parent;
+    }
+
+    json->index = index;
+    return count;
+}
+
+/**
+ * finds the token following a token and all of the tokens it contains.
+ * for array items and object values, this is the next item or key.
+ *
+ * @param   json - pointer to the initialized json structure to work with.
+ * @param   token - pointer to the token to skip.
+ * @retval  returns the next sibling token, or a pointer to one past the last token.
+ *          O(1) if json_index() was used, or a scan over the tokens contained by token otherwise.
+ */
+jsmntok_t* json_token_next(json_t* json, jsmntok_t* token)
+{
+    jsmntok_t* end = json->tokens + json->ntokens;
+
+    if(json->index)
+        return json->tokens + json->index->next[token - json->tokens];
+
+    jsmntok_t* next = token + 1;
+    while(next < end && next->start < token->end)
+        next++;
+    return next;
+}
+
 /**
  * checks that a token is iterable.
  *
@@ -84,7 +206,7 @@ jsmntok_t* json_token_is_iterable(jsmntok_t* iterable)
  */
 jsmntok_t* json_token_in_iterable(jsmntok_t* token, jsmntok_t* iterable)
 {
-	return iterable && (token >= iterable) && (token <= (iterable + iterable->size)) ? token : NULL;
+	return iterable && token && (token >= iterable) && (token->start < iterable->end) ? token : NULL;
 }
 
 /**
@@ -118,22 +240,26 @@ jsmntok_t* json_reset_iterator(json_t* json, jsmntok_t* iterable)
  */
 jsmntok_t* json_iterator(json_t* json)
 {
+    jsmntok_t* next;
+
     if(json_token_is_iterable(json->current_iterable))
     {
     	// if we are not currently within the iterable, set the current to the iterable itself
         if(!json_token_in_iterable(json->current_item, json->current_iterable))
            json->current_item = json->current_iterable;
 
-        // if we are already inside the iterable
+        // if we are already inside the iterable, skip over the current item, and the object value
         if(json->current_item != json->current_iterable)
         {
-            json->current_item += json->current_item->size;
-            if(json->current_iterable->type == JSMN_OBJECT)
-                json->current_item++;
+            next = json_token_next(json, json->current_item);
+            if(json->current_iterable->type == JSMN_OBJECT && next < json->tokens + json->ntokens)
+                next = json_token_next(json, next);
         }
+        else
+            next = json->current_iterable + 1;
 
         // advance to next item, return NULL if we hit the end of the parent container
-        json->current_item = json_token_in_iterable(json->current_item + 1, json->current_iterable);
+        json->current_item = next < json->tokens + json->ntokens ? json_token_in_iterable(next, json->current_iterable) : NULL;
     }
     else
         json->current_item = NULL;
@@ -170,16 +296,16 @@ jsmntok_t* json_iterator_get_object_value(json_t* json)
  */
 jsmntok_t* json_object_value_iterator(json_t* json)
 {
+    jsmntok_t* next;
+
     if(json->current_iterable && json->current_iterable->type == JSMN_OBJECT && json->current_iterable->size >= 2)
     {
-        if(!json_token_in_iterable(json->current_item, json->current_iterable))
-            json->current_item = json->current_iterable;
-        else if(json->current_item != json->current_iterable)
-            json->current_item += json->current_item->size;
+        if(!json_token_in_iterable(json->current_item, json->current_iterable) || json->current_item == json->current_iterable)
+            next = json->current_iterable + 2;
+        else
+            next = json_token_next(json, json->current_item) + 1;
 
-        json->current_item += 2;
-
-        json->current_item = json_token_in_iterable(json->current_item, json->current_iterable);
+        json->current_item = next < json->tokens + json->ntokens ? json_token_in_iterable(next, json->current_iterable) : NULL;
     }
 
     return json->current_item;
@@ -201,24 +327,41 @@ jsmntok_t* json_object_value_iterator(json_t* json)
  */
 jsmntok_t* json_get_value_by_key(json_t* json, jsmntok_t* object, char* key)
 {
-    jsmntok_t* token = object+1;
-    int count = 0;
+    jsmntok_t* token;
+    jsmntok_t* end;
+    int length = strlen(key);
+    int slot;
+    int k;
     json->current_item = NULL;
 
     if(object && object->type == JSMN_OBJECT && object->size >= 2)
     {
-        while(count < object->size)
+        if(json->index)
+        {
+            slot = json_key_hash(object - json->tokens, key, length);
+            while((k = json->index->keys[slot & (json->index->nkeys - 1)]) != -1)
+            {
+                token = json->tokens + k;
+                if(json->tokens + token->parent == object && length == token->end - token->start &&
+                   memcmp(key, json->buffer + token->start, length) == 0)
+                {
+                    json->current_item = token + 1;
+                    break;
+                }
+                slot++;
+            }
+        }
+        else
         {
-           if(json->tokens + token->parent == object)
-           {
-               if((strlen(key) == (size_t)(token->end - token->start)) && (memcmp(key, json->buffer + token->start, token->end - token->start) == 0))
-               {
-                   json->current_item = token + 1;
-                   return json->current_item;
-               }
-               count++;
-           }
-           token++;
+            end = json_token_next(json, object);
+            for(token = object + 1; token < end; token = json_token_next(json, token + 1))
+            {
+                if((length == token->end - token->start) && (memcmp(key, json->buffer + token->start, length) == 0))
+                {
+                    json->current_item = token + 1;
+                    break;
+                }
+            }
         }
     }
 
@@ -247,10 +390,7 @@ jsmntok_t* json_get_item_by_index(json_t* json, jsmntok_t* array, int index)
     {
         token = array + 1;
         while(index--)
-        {
-            token += token->size;
-            token++;
-        }
+            token = json_token_next(json, token);
         json->current_item = token;
     }
     return json->current_item;
@@ -424,3 +564,717 @@ char* json_raw_data(json_t* json)
 {
     return json->buffer + json->current_item->start;
 }
+
+/**
+ * stream parser states.
+ */
+enum {
+    JSON_STATE_VALUE,           ///< expecting a value
+    JSON_STATE_VALUE_OR_END,    ///< expecting a value or ], just after [
+    JSON_STATE_KEY,             ///< expecting an object key, after a comma
+    JSON_STATE_KEY_OR_END,      ///< expecting an object key or }, just after {
+    JSON_STATE_COLON,           ///< expecting a colon after an object key
+    JSON_STATE_NEXT,            ///< expecting a comma or the end of the container
+    JSON_STATE_STRING,          ///< inside a string value
+    JSON_STATE_KEY_STRING,      ///< inside an object key
+    JSON_STATE_PRIMITIVE,       ///< inside a primitive value
+    JSON_STATE_DONE,            ///< a whole json value has been parsed
+    JSON_STATE_ERROR            ///< a parse error occurred
+};
+
+#define json_is_space(c)    ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n')
+
+/**
+ * initialise a json stream parser.
+ *
+ * the stream parser works on json input in chunks of any size, as it arrives,
+ * without the whole input or a token array being held in memory. every token is passed
+ * to the visitor function as it is completed. only one string or primitive token is held
+ * in memory at a time, in the window.
+ *
+ * Example, parsing an HTTP POST body in an http_api_t function:
+ *
+ * @code
+ * static bool visitor(json_stream_t* stream, json_stream_event_t event, char* value, int length)
+ * {
+ *     if(event == JSON_STREAM_PRIMITIVE && json_stream_depth(stream) == 1 && !strcmp(json_stream_key(stream), "rate"))
+ *         set_rate(atoi(value));
+ *     return true;
+ * }
+ *
+ * int api_call(int fdes, int content_length, char* buffer, int size)
+ * {
+ *     char window[64];
+ *     json_stream_t stream;
+ *     json_stream_init(&stream, visitor, NULL, window, sizeof(window));
+ *     if(json_stream_read(&stream, fdes, content_length, buffer, size) != JSON_STREAM_DONE)
+ *         ... error
+ * }
+ * @endcode
+ *
+ * @param   stream will be fully initialized by this function.
+ * @param   visitor is the function to call with each token.
+ * @param   ctx is a pointer to some user data, available to the visitor as stream->ctx.
+ * @param   window is some memory to hold one string or primitive token, must be long enough for
+ *          the longest string or primitive expected, plus 1 byte for the 0 terminator.
+ * @param   window_size is the size of the window memory.
+ */
+void json_stream_init(json_stream_t* stream, json_visitor_t visitor, void* ctx, char* window, int window_size)
+{
+    stream->visitor = visitor;
+    stream->ctx = ctx;
+    stream->window = window;
+    stream->window_size = window_size;
+    stream->length = 0;
+    stream->state = JSON_STATE_VALUE;
+    stream->escape = 0;
+    stream->depth = 0;
+    stream->key[0] = '\0';
+}
+
+/**
+ * appends a character to the stream parser window.
+ */
+static int json_stream_append(json_stream_t* stream, char c)
+{
+    if(stream->length >= stream->window_size - 1)
+        return JSMN_ERROR_NOMEM;
+    stream->window[stream->length++] = c;
+    return 0;
+}
+
+/**
+ * calls the visitor, with the window content for token events.
+ */
+static int json_stream_emit(json_stream_t* stream, json_stream_event_t event)
+{
+    char* value = NULL;
+    int length = 0;
+
+    if(event == JSON_STREAM_KEY || event == JSON_STREAM_STRING || event == JSON_STREAM_PRIMITIVE)
+    {
+        stream->window[stream->length] = '\0';
+        value = stream->window;
+        length = stream->length;
+        stream->length = 0;
+    }
+
+    if(event == JSON_STREAM_KEY)
+    {
+        strncpy(stream->key, value, sizeof(stream->key) - 1);
+        stream->key[sizeof(stream->key) - 1] = '\0';
+    }
+
+    if(stream->visitor && !stream->visitor(stream, event, value, length))
+        return JSON_STREAM_ABORTED;
+
+    return 0;
+}
+
+/**
+ * sets the state after a whole value has been parsed.
+ */
+static void json_stream_value_done(json_stream_t* stream)
+{
+    stream->state = stream->depth == 0 ? JSON_STATE_DONE : JSON_STATE_NEXT;
+}
+
+static int json_stream_open(json_stream_t* stream, jsmntype_t type)
+{
+    int ret;
+
+    if(stream->depth >= JSON_STREAM_MAX_DEPTH)
+        return JSMN_ERROR_NOMEM;
+
+    ret = json_stream_emit(stream, type == JSMN_OBJECT ? JSON_STREAM_OBJECT_START : JSON_STREAM_ARRAY_START);
+    stream->stack[stream->depth++] = type;
+    stream->state = type == JSMN_OBJECT ? JSON_STATE_KEY_OR_END : JSON_STATE_VALUE_OR_END;
+    return ret;
+}
+
+static int json_stream_close(json_stream_t* stream, jsmntype_t type)
+{
+    if(stream->depth == 0 || stream->stack[stream->depth - 1] != type)
+        return JSMN_ERROR_INVAL;
+
+    stream->depth--;
+    json_stream_value_done(stream);
+    return json_stream_emit(stream, type == JSMN_OBJECT ? JSON_STREAM_OBJECT_END : JSON_STREAM_ARRAY_END);
+}
+
+/**
+ * parses one character.
+ */
+static int json_stream_char(json_stream_t* stream, char c)
+{
+    switch(stream->state)
+    {
+        case JSON_STATE_STRING:
+        case JSON_STATE_KEY_STRING:
+            if((unsigned char)c < 32)
+                return JSMN_ERROR_INVAL;
+            if(stream->escape == 1)
+            {
+                if(c == 'u')
+                    stream->escape = 5;
+                else if(strchr("\"/\\bfrnt", c))
+                    stream->escape = 0;
+                else
+                    return JSMN_ERROR_INVAL;
+            }
+            else if(stream->escape)
+            {
+                if(!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')))
+                    return JSMN_ERROR_INVAL;
+                if(--stream->escape == 1)
+                    stream->escape = 0;
+            }
+            else if(c == '\\')
+                stream->escape = 1;
+            else if(c == '\"')
+            {
+                if(stream->state == JSON_STATE_KEY_STRING)
+                {
+                    stream->state = JSON_STATE_COLON;
+                    return json_stream_emit(stream, JSON_STREAM_KEY);
+                }
+                json_stream_value_done(stream);
+                return json_stream_emit(stream, JSON_STREAM_STRING);
+            }
+            return json_stream_append(stream, c);
+
+        case JSON_STATE_PRIMITIVE:
+            if(json_is_space(c) || c == ',' || c == ']' || c == '}')
+            {
+                int ret;
+                json_stream_value_done(stream);
+                ret = json_stream_emit(stream, JSON_STREAM_PRIMITIVE);
+                // the terminating character belongs to the next state
+                return ret ? ret : json_stream_char(stream, c);
+            }
+            if(c < 32 || c >= 127 || c == ':')
+                return JSMN_ERROR_INVAL;
+            return json_stream_append(stream, c);
+
+        default:
+            break;
+    }
+
+    if(json_is_space(c))
+        return 0;
+
+    switch(stream->state)
+    {
+        case JSON_STATE_VALUE_OR_END:
+            if(c == ']')
+                return json_stream_close(stream, JSMN_ARRAY);
+            // fall through
+        case JSON_STATE_VALUE:
+            if(c == '{')
+                return json_stream_open(stream, JSMN_OBJECT);
+            if(c == '[')
+                return json_stream_open(stream, JSMN_ARRAY);
+            if(c == '\"')
+            {
+                stream->state = JSON_STATE_STRING;
+                return 0;
+            }
+            if(c == '}' || c == ']' || c == ',' || c == ':' || c < 32 || c >= 127)
+                return JSMN_ERROR_INVAL;
+            stream->state = JSON_STATE_PRIMITIVE;
+            return json_stream_append(stream, c);
+
+        case JSON_STATE_KEY_OR_END:
+            if(c == '}')
+                return json_stream_close(stream, JSMN_OBJECT);
+            // fall through
+        case JSON_STATE_KEY:
+            if(c != '\"')
+                return JSMN_ERROR_INVAL;
+            stream->state = JSON_STATE_KEY_STRING;
+            return 0;
+
+        case JSON_STATE_COLON:
+            if(c != ':')
+                return JSMN_ERROR_INVAL;
+            stream->state = JSON_STATE_VALUE;
+            return 0;
+
+        case JSON_STATE_NEXT:
+            if(c == ',')
+            {
+                stream->state = stream->stack[stream->depth - 1] == JSMN_OBJECT ? JSON_STATE_KEY : JSON_STATE_VALUE;
+                return 0;
+            }
+            if(c == '}')
+                return json_stream_close(stream, JSMN_OBJECT);
+            if(c == ']')
+                return json_stream_close(stream, JSMN_ARRAY);
+            return JSMN_ERROR_INVAL;
+
+        default:
+            return JSMN_ERROR_INVAL;
+    }
+}
+
+/**
+ * feeds a chunk of json input to the stream parser.
+ * the input may be split anywhere, including inside a token.
+ *
+ * @param   stream - pointer to the initialized stream parser.
+ * @param   data is a pointer to the next chunk of input. it is not modified, and may be reused once this function returns.
+ * @param   length is the length in bytes of the input chunk.
+ * @retval  returns JSON_STREAM_MORE if more input is expected, JSON_STREAM_DONE once a whole json value
+ *          has been parsed, JSON_STREAM_ABORTED if the visitor stopped the parser, or a jsmn error code:
+ *          - JSMN_ERROR_INVAL on invalid input.
+ *          - JSMN_ERROR_NOMEM if a token did not fit in the window, or nesting was deeper than JSON_STREAM_MAX_DEPTH.
+ */
+int json_stream_feed(json_stream_t* stream, const char* data, int length)
+{
+    int ret;
+    if(stream->state == JSON_STATE_ERROR)
+        return JSMN_ERROR_INVAL;
+
+    char c;
+
+    while(length--)
+    {
+        c = *data++;
+
+        if(stream->state == JSON_STATE_DONE)
+        {
+            if(!json_is_space(c))
+            {
+                stream->state = JSON_STATE_ERROR;
+                return JSMN_ERROR_INVAL;
+            }
+            continue;
+        }
+
+        ret = json_stream_char(stream, c);
+        if(ret < 0)
+        {
+            stream->state = JSON_STATE_ERROR;
+            return ret;
+        }
+    }
+
+    return stream->state == JSON_STATE_DONE ? JSON_STREAM_DONE : JSON_STREAM_MORE;
+}
+
+/**
+ * signals the end of the input to the stream parser.
+ * this is needed to complete a top level primitive value, that has no terminating character.
+ *
+ * @param   stream - pointer to the initialized stream parser.
+ * @retval  returns JSON_STREAM_DONE if a whole json value was parsed, or a jsmn error code:
+ *          - JSMN_ERROR_PART if the input ended part way through.
+ */
+int json_stream_finish(json_stream_t* stream)
+{
+    if(stream->state == JSON_STATE_PRIMITIVE && stream->depth == 0)
+    {
+        stream->state = JSON_STATE_DONE;
+        if(json_stream_emit(stream, JSON_STREAM_PRIMITIVE))
+            return JSON_STREAM_ABORTED;
+    }
+
+    if(stream->state == JSON_STATE_ERROR)
+        return JSMN_ERROR_INVAL;
+
+    return stream->state == JSON_STATE_DONE ? JSON_STREAM_DONE : JSMN_ERROR_PART;
+}
+
+/**
+ * reads json input of a known length from a file or socket, and feeds it to the stream parser.
+ * all of the input is read, even if parsing completes or fails early.
+ *
+ * @param   stream - pointer to the initialized stream parser.
+ * @param   fdes is the file descriptor to read from.
+ * @param   content_length is the number of bytes to read.
+ * @param   buffer is some memory to read into.
+ * @param   size is the size of the buffer memory. the input is read in chunks of up to this size.
+ * @retval  returns the same as json_stream_finish(), or the first error from json_stream_feed().
+ */
+int json_stream_read(json_stream_t* stream, int fdes, int content_length, char* buffer, int size)
+{
+    int ret = JSON_STREAM_MORE;
+    int length;
+
+    while(content_length > 0)
+    {
+        length = read(fdes, buffer, content_length < size ? content_length : size);
+        if(length <= 0)
+            return JSMN_ERROR_PART;
+        content_length -= length;
+
+        if(ret >= 0)
+            ret = json_stream_feed(stream, buffer, length);
+    }
+
+    return ret < 0 ? ret : json_stream_finish(stream);
+}
+
+/**
+ * @retval  the number of objects and arrays enclosing the current token.
+ *          members of the top level object or array are at depth 1.
+ */
+int json_stream_depth(json_stream_t* stream)
+{
+    return stream->depth;
+}
+
+/**
+ * @retval  the most recent object key. inside the visitor, during a JSON_STREAM_STRING, JSON_STREAM_PRIMITIVE,
+ *          JSON_STREAM_OBJECT_START or JSON_STREAM_ARRAY_START event for an object member,
+ *          this is the member's key. keys longer than JSON_STREAM_KEY_LENGTH-1 are truncated.
+ */
+const char* json_stream_key(json_stream_t* stream)
+{
+    return stream->key;
+}
+
+/**
+ * initialise a json writer.
+ *
+ * the writer produces compact json text, handling commas and string escaping. it does no
+ * memory allocation. output is collected in the buffer, and written to fdes in buffer
+ * sized blocks when the buffer fills, so responses of any size may be written with a small buffer.
+ *
+ * Example, responding to an http_api_t function call:
+ *
+ * @code
+ * int api_call(int fdes, int content_length, char* buffer, int size)
+ * {
+ *     json_writer_t writer;
+ *     json_writer_init(&writer, buffer, size, fdes);
+ *     json_writer_object_start(&writer);
+ *     json_writer_key(&writer, "temperature");
+ *     json_writer_fixed(&writer, temperature_millidegrees, 3);
+ *     json_writer_key(&writer, "samples");
+ *     json_writer_array_start(&writer);
+ *     for(i = 0; i < count; i++)
+ *         json_writer_int(&writer, samples[i]);
+ *     json_writer_array_end(&writer);
+ *     json_writer_object_end(&writer);
+ *     return json_writer_finish(&writer);
+ * }
+ * @endcode
+ *
+ * @param   writer will be fully initialized by this function.
+ * @param   buffer is a pointer to the output buffer memory.
+ * @param   size is the size of the output buffer memory.
+ * @param   fdes is a file or socket descriptor to flush the buffer to, or -1 if the
+ *          output must fit in the buffer. to frame the flushed output, for example as
+ *          http chunks, set writer->output after calling this function.
+ */
+void json_writer_init(json_writer_t* writer, char* buffer, int size, int fdes)
+{
+    writer->buffer = buffer;
+    writer->size = size;
+    writer->length = 0;
+    writer->fdes = fdes;
+    writer->output = NULL;
+    writer->total = 0;
+    writer->error = 0;
+    writer->depth = 0;
+    writer->key = false;
+    writer->items = 0;
+}
+
+/**
+ * writes the buffer content to the file descriptor, if there is one.
+ *
+ * @param   writer - pointer to the initialized json writer.
+ * @retval  returns 0 on success, or the writer error code.
+ */
+int json_writer_flush(json_writer_t* writer)
+{
+    int ret;
+    int sent = 0;
+
+    if(writer->fdes >= 0 && !writer->error)
+    {
+        while(sent < writer->length)
+        {
+            if(writer->output)
+                ret = writer->output(writer->fdes, writer->buffer + sent, writer->length - sent);
+            else
+                ret = write(writer->fdes, writer->buffer + sent, writer->length - sent);
+            if(ret <= 0)
+            {
+                writer->error = -1;
+                break;
+            }
+            sent += ret;
+        }
+        writer->length = 0;
+    }
+
+    return writer->error;
+}
+
+static void json_writer_put(json_writer_t* writer, const char* data, int length)
+{
+    int count;
+
+    while(length > 0 && !writer->error)
+    {
+        if(writer->length == writer->size)
+        {
+            if(writer->fdes < 0)
+            {
+                writer->error = JSMN_ERROR_NOMEM;
+                break;
+            }
+            json_writer_flush(writer);
+        }
+
+        count = writer->size - writer->length;
+        if(count > length)
+            count = length;
+        memcpy(writer->buffer + writer->length, data, count);
+        writer->length += count;
+        writer->total += count;
+        data += count;
+        length -= count;
+    }
+}
+
+/**
+ * writes the comma between items, if needed.
+ */
+static void json_writer_item(json_writer_t* writer)
+{
+    if(writer->key)
+        writer->key = false;
+    else if(writer->depth > 0)
+    {
+        if(writer->items & (1u << writer->depth))
+            json_writer_put(writer, ",", 1);
+        writer->items |= 1u << writer->depth;
+    }
+}
+
+static void json_writer_open(json_writer_t* writer, const char* bracket)
+{
+    json_writer_item(writer);
+    if(writer->depth >= JSON_WRITER_MAX_DEPTH - 1)
+    {
+        writer->error = JSMN_ERROR_NOMEM;
+        return;
+    }
+    json_writer_put(writer, bracket, 1);
+    writer->depth++;
+    writer->items &= ~(1u << writer->depth);
+}
+
+static void json_writer_close(json_writer_t* writer, const char* bracket)
+{
+    if(writer->depth <= 0)
+    {
+        writer->error = JSMN_ERROR_INVAL;
+        return;
+    }
+    json_writer_put(writer, bracket, 1);
+    writer->depth--;
+}
+
+void json_writer_object_start(json_writer_t* writer)
+{
+    json_writer_open(writer, "{");
+}
+
+void json_writer_object_end(json_writer_t* writer)
+{
+    json_writer_close(writer, "}");
+}
+
+void json_writer_array_start(json_writer_t* writer)
+{
+    json_writer_open(writer, "[");
+}
+
+void json_writer_array_end(json_writer_t* writer)
+{
+    json_writer_close(writer, "]");
+}
+
+/**
+ * writes a quoted, escaped string.
+ */
+static void json_writer_quoted(json_writer_t* writer, const char* value, int length)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char* run = value;
+    char escape[6];
+    int i;
+
+    json_writer_put(writer, "\"", 1);
+    for(i = 0; i < length; i++)
+    {
+        unsigned char c = value[i];
+        if(c >= 0x20 && c != '\"' && c != '\\')
+            continue;
+
+        // write out the run of plain characters before this one
+        json_writer_put(writer, run, value + i - run);
+        run = value + i + 1;
+
+        escape[0] = '\\';
+        switch(c)
+        {
+            case '\"': escape[1] = '\"'; break;
+            case '\\': escape[1] = '\\'; break;
+            case '\n': escape[1] = 'n'; break;
+            case '\r': escape[1] = 'r'; break;
+            case '\t': escape[1] = 't'; break;
+            case '\b': escape[1] = 'b'; break;
+            case '\f': escape[1] = 'f'; break;
+            default:
+                memcpy(escape + 1, "u00", 3);
+                escape[4] = hex[c >> 4];
+                escape[5] = hex[c & 0x0f];
+                json_writer_put(writer, escape, 6);
+                continue;
+        }
+        json_writer_put(writer, escape, 2);
+    }
+    json_writer_put(writer, run, value + length - run);
+    json_writer_put(writer, "\"", 1);
+}
+
+/**
+ * writes an object key. the next call must write its value.
+ */
+void json_writer_key(json_writer_t* writer, const char* key)
+{
+    json_writer_item(writer);
+    json_writer_quoted(writer, key, strlen(key));
+    json_writer_put(writer, ":", 1);
+    writer->key = true;
+}
+
+void json_writer_string(json_writer_t* writer, const char* value)
+{
+    json_writer_string_n(writer, value, strlen(value));
+}
+
+/**
+ * writes a string of the given length, that need not be 0 terminated.
+ */
+void json_writer_string_n(json_writer_t* writer, const char* value, int length)
+{
+    json_writer_item(writer);
+    json_writer_quoted(writer, value, length);
+}
+
+/**
+ * writes an unsigned integer, with at least digits digits.
+ */
+static void json_writer_digits(json_writer_t* writer, uint32_t value, int digits)
+{
+    char str[10];
+    int i = sizeof(str);
+
+    do {
+        str[--i] = '0' + (value % 10);
+        value /= 10;
+        digits--;
+    } while(value || digits > 0);
+
+    json_writer_put(writer, str + i, sizeof(str) - i);
+}
+
+void json_writer_int(json_writer_t* writer, int32_t value)
+{
+    json_writer_fixed(writer, value, 0);
+}
+
+void json_writer_uint(json_writer_t* writer, uint32_t value)
+{
+    json_writer_item(writer);
+    json_writer_digits(writer, value, 1);
+}
+
+/**
+ * writes a fixed point number, value / 10^decimals.
+ *
+ * Eg, value=-12345, decimals=3 is written as -12.345
+ *
+ * @param   writer - pointer to the initialized json writer.
+ * @param   value is the fixed point value.
+ * @param   decimals is the number of decimal places in value, 0 to 9.
+ */
+void json_writer_fixed(json_writer_t* writer, int32_t value, int decimals)
+{
+    uint32_t magnitude = value < 0 ? -(uint32_t)value : (uint32_t)value;
+    uint32_t scale = 1;
+    int i;
+
+    for(i = 0; i < decimals; i++)
+        scale *= 10;
+
+    json_writer_item(writer);
+    if(value < 0)
+        json_writer_put(writer, "-", 1);
+    json_writer_digits(writer, magnitude / scale, 1);
+    if(decimals > 0)
+    {
+        json_writer_put(writer, ".", 1);
+        json_writer_digits(writer, magnitude % scale, decimals);
+    }
+}
+
+/**
+ * writes a float with a fixed number of decimal places, rounded to nearest.
+ * values that do not fit in a 32 bit fixed point number are written as null.
+ *
+ * @param   writer - pointer to the initialized json writer.
+ * @param   value is the value to write.
+ * @param   decimals is the number of decimal places to write, 0 to 9.
+ */
+void json_writer_float(json_writer_t* writer, float value, int decimals)
+{
+    float scaled = value;
+    int i;
+
+    for(i = 0; i < decimals; i++)
+        scaled *= 10.0f;
+    scaled += scaled < 0 ? -0.5f : 0.5f;
+
+    if(scaled != scaled || scaled >= 2147483647.0f || scaled <= -2147483647.0f)
+        json_writer_null(writer);
+    else
+        json_writer_fixed(writer, (int32_t)scaled, decimals);
+}
+
+void json_writer_bool(json_writer_t* writer, bool value)
+{
+    json_writer_item(writer);
+    if(value)
+        json_writer_put(writer, "true", 4);
+    else
+        json_writer_put(writer, "false", 5);
+}
+
+void json_writer_null(json_writer_t* writer)
+{
+    json_writer_item(writer);
+    json_writer_put(writer, "null", 4);
+}
+
+/**
+ * flushes any remaining output.
+ *
+ * @param   writer - pointer to the initialized json writer.
+ * @retval  returns the total number of bytes written, or the writer error code if an error occurred.
+ *          JSMN_ERROR_NOMEM is returned when there was no file descriptor and the output did
+ *          not fit in the buffer, or nesting was deeper than JSON_WRITER_MAX_DEPTH.
+ *          JSMN_ERROR_INVAL is returned if containers were closed that were not opened.
+ */
+int json_writer_finish(json_writer_t* writer)
+{
+    json_writer_flush(writer);
+    return writer->error ? writer->error : writer->total;
+}
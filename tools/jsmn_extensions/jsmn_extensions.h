@@ -35,17 +35,109 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "jsmn.h"
 
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/**
+ * optional structural index over the tokens of a json_t, built by json_index().
+ * all memory is supplied by the caller.
+ */
+typedef struct {
+    uint16_t* next;         ///< per token, the index of the first token after the token and its contents
+    int16_t* keys;          ///< hash table of object key token indices, -1 where empty
+    uint16_t nkeys;         ///< number of slots in the key hash table, a power of 2
+}json_index_t;
+
 typedef struct _json_t {
     char* buffer;
     jsmntok_t* tokens;
+    int ntokens;
+    json_index_t* index;
     jsmntok_t* current_item;
     jsmntok_t* current_iterable;
 }json_t;
 
+/**
+ * the maximum nesting depth of objects and arrays supported by the stream parser.
+ */
+#ifndef JSON_STREAM_MAX_DEPTH
+#define JSON_STREAM_MAX_DEPTH   16
+#endif
+
+/**
+ * the maximum length of an object key retained by the stream parser, see json_stream_key().
+ */
+#ifndef JSON_STREAM_KEY_LENGTH
+#define JSON_STREAM_KEY_LENGTH  32
+#endif
+
+#define JSON_STREAM_MORE        0       ///< json_stream_feed() return value, more input is expected.
+#define JSON_STREAM_DONE        1       ///< json_stream_feed() return value, a whole json value has been parsed.
+#define JSON_STREAM_ABORTED     -4      ///< json_stream_feed() return value, the visitor stopped the parser.
+
+typedef enum {
+    JSON_STREAM_OBJECT_START,
+    JSON_STREAM_OBJECT_END,
+    JSON_STREAM_ARRAY_START,
+    JSON_STREAM_ARRAY_END,
+    JSON_STREAM_KEY,
+    JSON_STREAM_STRING,
+    JSON_STREAM_PRIMITIVE
+}json_stream_event_t;
+
+typedef struct _json_stream_t json_stream_t;
+
+/**
+ * called by the stream parser for every json token.
+ * for JSON_STREAM_KEY, JSON_STREAM_STRING and JSON_STREAM_PRIMITIVE, value points to the
+ * zero terminated token text, in the parser window, and length is its length. strings are not unescaped.
+ * for the other events value is NULL.
+ * return false to stop the parser.
+ */
+typedef bool(*json_visitor_t)(json_stream_t* stream, json_stream_event_t event, char* value, int length);
+
+struct _json_stream_t {
+    json_visitor_t visitor;                     ///< the token visitor
+    void* ctx;                                  ///< user context, for use by the visitor
+    char* window;                               ///< memory to hold one string or primitive token
+    int window_size;                            ///< size of the window memory
+    int length;                                 ///< length of the token in the window
+    uint8_t state;                              ///< parser state
+    uint8_t escape;                             ///< number of escaped characters pending in a string
+    int8_t depth;                               ///< current nesting depth, 0 at the top level
+    uint8_t stack[JSON_STREAM_MAX_DEPTH];       ///< the type of each open container
+    char key[JSON_STREAM_KEY_LENGTH];           ///< the most recent object key
+};
+
+/**
+ * the maximum nesting depth of objects and arrays supported by the json writer.
+ */
+#define JSON_WRITER_MAX_DEPTH   32
+
+/**
+ * json writer, writes json into a buffer, flushing it to a file or socket when full.
+ */
+typedef struct {
+    char* buffer;           ///< the output buffer
+    int size;               ///< size of the output buffer
+    int length;             ///< number of bytes in the output buffer
+    int fdes;               ///< file descriptor to flush to, or -1 to write to the buffer only
+    int (*output)(int fdes, const void* data, int length);  ///< function used to flush the buffer to fdes, write() by default
+    int total;              ///< number of bytes written so far, including those flushed
+    int error;              ///< set to a jsmn error code, or -1 on a write error
+    int8_t depth;           ///< current nesting depth
+    bool key;               ///< set after a key is written, until its value is written
+    uint32_t items;         ///< bit n is set when the container at depth n has an item
+}json_writer_t;
+
 jsmnerr_t json_init(json_t* json, jsmntok_t* tokens, int ntokens, char* input, int length);
+int json_index(json_t* json, json_index_t* index, uint16_t* next, int16_t* keys, uint16_t nkeys);
+jsmntok_t* json_token_next(json_t* json, jsmntok_t* token);
 
 jsmntok_t* json_reset_iterator(json_t* json, jsmntok_t* container);
 jsmntok_t* json_iterator(json_t* json);
@@ -74,4 +166,32 @@ int json_size(json_t* json);
 int json_raw_length(json_t* json);
 char* json_raw_data(json_t* json);
 
+void json_stream_init(json_stream_t* stream, json_visitor_t visitor, void* ctx, char* window, int window_size);
+int json_stream_feed(json_stream_t* stream, const char* data, int length);
+int json_stream_finish(json_stream_t* stream);
+int json_stream_read(json_stream_t* stream, int fdes, int content_length, char* buffer, int size);
+int json_stream_depth(json_stream_t* stream);
+const char* json_stream_key(json_stream_t* stream);
+
+void json_writer_init(json_writer_t* writer, char* buffer, int size, int fdes);
+void json_writer_object_start(json_writer_t* writer);
+void json_writer_object_end(json_writer_t* writer);
+void json_writer_array_start(json_writer_t* writer);
+void json_writer_array_end(json_writer_t* writer);
+void json_writer_key(json_writer_t* writer, const char* key);
+void json_writer_string(json_writer_t* writer, const char* value);
+void json_writer_string_n(json_writer_t* writer, const char* value, int length);
+void json_writer_int(json_writer_t* writer, int32_t value);
+void json_writer_uint(json_writer_t* writer, uint32_t value);
+void json_writer_fixed(json_writer_t* writer, int32_t value, int decimals);
+void json_writer_float(json_writer_t* writer, float value, int decimals);
+void json_writer_bool(json_writer_t* writer, bool value);
+void json_writer_null(json_writer_t* writer);
+int json_writer_flush(json_writer_t* writer);
+int json_writer_finish(json_writer_t* writer);
+
+#ifdef __cplusplus
+ }
+#endif
+
 #endif /* JSMN_EXTENSIONS_H_ */
@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "json_bind.h"
+
+/**
+ * the longest primitive value text that is converted to a number.
+ */
+#define JSON_BIND_PRIMITIVE_LENGTH  24
+
+static const json_field_t* json_bind_find(const json_field_t* fields, const char* key, int length)
+{
+    for(; fields->key; fields++)
+    {
+        if(!strncmp(fields->key, key, length) && fields->key[length] == '\0')
+            return fields;
+    }
+    return NULL;
+}
+
+static void json_bind_store_int(const json_field_t* field, uint8_t* dest, int32_t value)
+{
+    switch(field->size)
+    {
+        case 1: *(int8_t*)dest = (int8_t)value; break;
+        case 2: *(int16_t*)dest = (int16_t)value; break;
+        case 4: *(int32_t*)dest = value; break;
+        default: break;
+    }
+}
+
+static int32_t json_bind_load_int(const json_field_t* field, const uint8_t* src)
+{
+    switch(field->size)
+    {
+        case 1: return field->type == JSON_BIND_UINT ? *(uint8_t*)src : *(int8_t*)src;
+        case 2: return field->type == JSON_BIND_UINT ? *(uint16_t*)src : *(int16_t*)src;
+        case 4: return *(int32_t*)src;
+        default: return 0;
+    }
+}
+
+/**
+ * sets a field from the text of a string or primitive value.
+ *
+ * @param   field is the field to set.
+ * @param   base is the address of the structure that holds the field.
+ * @param   value is the value text, it need not be 0 terminated.
+ * @param   length is the length of the value text.
+ * @param   string is true if the value is a json string.
+ * @retval  returns true if the field was set, false if the value did not suit the field type.
+ */
+static bool json_bind_set(const json_field_t* field, uint8_t* base, const char* value, int length, bool string)
+{
+    char primitive[JSON_BIND_PRIMITIVE_LENGTH];
+    uint8_t* dest = base + field->offset;
+    char* end;
+    int32_t number;
+    float real;
+
+    if(field->type == JSON_BIND_STRING)
+    {
+        if(!string || field->size == 0)
+            return false;
+        if(length >= field->size)
+            length = field->size - 1;
+        memcpy(dest, value, length);
+        dest[length] = '\0';
+        return true;
+    }
+
+    if(string || length >= (int)sizeof(primitive) || field->type == JSON_BIND_OBJECT)
+        return false;
+
+    memcpy(primitive, value, length);
+    primitive[length] = '\0';
+
+    // numbers are decimal and must use the whole value, so 010 is 10 and 1.5 is not an int
+
+    switch(field->type)
+    {
+        case JSON_BIND_INT:
+            if(*primitive != '-' && (*primitive < '0' || *primitive > '9'))
+                return false;
+            number = strtol(primitive, &end, 10);
+            if(*end != '\0')
+                return false;
+            json_bind_store_int(field, dest, number);
+        break;
+        case JSON_BIND_UINT:
+            if(*primitive < '0' || *primitive > '9')
+                return false;
+            number = (int32_t)strtoul(primitive, &end, 10);
+            if(*end != '\0')
+                return false;
+            json_bind_store_int(field, dest, number);
+        break;
+        case JSON_BIND_BOOL:
+            if(!strcmp(primitive, "true"))
+                *(bool*)dest = true;
+            else if(!strcmp(primitive, "false"))
+                *(bool*)dest = false;
+            else
+                return false;
+        break;
+        case JSON_BIND_FLOAT:
+            if(*primitive != '-' && (*primitive < '0' || *primitive > '9'))
+                return false;
+            real = strtof(primitive, &end);
+            if(*end != '\0')
+                return false;
+            *(float*)dest = real;
+        break;
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+static int json_bind_decode_object(json_t* json, jsmntok_t* object, const json_field_t* fields, uint8_t* base)
+{
+    jsmntok_t* end = json->tokens + json->ntokens;
+    jsmntok_t* key = object + 1;
+    jsmntok_t* value;
+    const json_field_t* field;
+    int count = 0;
+    int i;
+
+    // object size counts both keys and values
+    for(i = 0; i < object->size / 2 && key + 1 < end; i++)
+    {
+        value = key + 1;
+        field = json_bind_find(fields, json->buffer + key->start, key->end - key->start);
+        if(field)
+        {
+            if(value->type == JSMN_OBJECT)
+            {
+                if(field->type == JSON_BIND_OBJECT && field->fields)
+                    count += 1 + json_bind_decode_object(json, value, field->fields, base + field->offset);
+            }
+            else if(value->type == JSMN_STRING || value->type == JSMN_PRIMITIVE)
+            {
+                if(json_bind_set(field, base, json->buffer + value->start, value->end - value->start, value->type == JSMN_STRING))
+                    count++;
+            }
+        }
+        key = json_token_next(json, value);
+    }
+
+    return count;
+}
+
+/**
+ * decodes a parsed json object into a structure, in a single pass over the object tokens.
+ *
+ * keys that are not in the field table, and values that do not suit the field type are ignored.
+ * fields that do not appear in the object are left unchanged, so dest may be preset with defaults.
+ * strings are copied as they appear in the json text, they are not unescaped.
+ *
+ * @param   json - pointer to the initialized json structure to work with.
+ * @param   object - pointer to the object token to decode, eg json->tokens.
+ * @param   fields - the field table describing the structure.
+ * @param   dest - pointer to the structure to fill.
+ * @retval  returns the number of fields set, or -1 if object is not an object.
+ */
+int json_bind_decode(json_t* json, jsmntok_t* object, const json_field_t* fields, void* dest)
+{
+    if(!object || object->type != JSMN_OBJECT)
+        return -1;
+    return json_bind_decode_object(json, object, fields, (uint8_t*)dest);
+}
+
+static bool json_bind_visitor(json_stream_t* stream, json_stream_event_t event, char* value, int length)
+{
+    json_bind_t* bind = (json_bind_t*)stream->ctx;
+    const json_field_t* field = bind->field;
+
+    bind->field = NULL;
+
+    switch(event)
+    {
+        case JSON_STREAM_OBJECT_START:
+            if(bind->skip)
+                bind->skip++;
+            else if(bind->level < 0)
+                bind->level = 0;
+            else if(field && field->type == JSON_BIND_OBJECT && field->fields && bind->level < JSON_BIND_MAX_DEPTH - 1)
+            {
+                bind->fields[bind->level + 1] = field->fields;
+                bind->base[bind->level + 1] = bind->base[bind->level] + field->offset;
+                bind->level++;
+                bind->count++;
+            }
+            else
+                bind->skip = 1;
+        break;
+        case JSON_STREAM_ARRAY_START:
+            bind->skip++;
+        break;
+        case JSON_STREAM_OBJECT_END:
+        case JSON_STREAM_ARRAY_END:
+            if(bind->skip)
+                bind->skip--;
+            else
+                bind->level--;
+        break;
+        case JSON_STREAM_KEY:
+            if(!bind->skip)
+                bind->field = json_bind_find(bind->fields[bind->level], value, length);
+        break;
+        case JSON_STREAM_STRING:
+        case JSON_STREAM_PRIMITIVE:
+            if(!bind->skip && field && json_bind_set(field, bind->base[bind->level], value, length, event == JSON_STREAM_STRING))
+                bind->count++;
+        break;
+    }
+
+    return true;
+}
+
+/**
+ * initialise a json stream parser that decodes an object into a structure as it is parsed.
+ * this suits documents too large to tokenize in memory, such as http request bodies.
+ * the window must be large enough to hold the longest string or primitive in the document,
+ * else the stream parser fails with JSMN_ERROR_NOMEM.
+ *
+ * @code
+ * json_stream_t stream;
+ * json_bind_t bind;
+ * char window[64];
+ * json_bind_stream_init(&stream, &bind, server_conf_fields, &conf, window, sizeof(window));
+ * if(json_stream_read(&stream, fdes, content_length, buffer, size) == JSON_STREAM_DONE)
+ *     count = json_bind_count(&bind);
+ * @endcode
+ *
+ * @param   stream - the stream parser to initialise.
+ * @param   bind - the binding state, must remain valid while the stream is in use.
+ * @param   fields - the field table describing the structure.
+ * @param   dest - pointer to the structure to fill.
+ * @param   window - memory to hold one string or primitive token.
+ * @param   window_size - size of the window memory.
+ */
+void json_bind_stream_init(json_stream_t* stream, json_bind_t* bind, const json_field_t* fields, void* dest, char* window, int window_size)
+{
+    bind->fields[0] = fields;
+    bind->base[0] = (uint8_t*)dest;
+    bind->field = NULL;
+    bind->level = -1;
+    bind->skip = 0;
+    bind->count = 0;
+    json_stream_init(stream, json_bind_visitor, bind, window, window_size);
+}
+
+/**
+ * @retval  returns the number of fields set by a stream parser initialised with json_bind_stream_init().
+ */
+int json_bind_count(json_bind_t* bind)
+{
+    return bind->count;
+}
+
+/**
+ * encodes a structure as a json object.
+ *
+ * @param   writer - the json writer to write to.
+ * @param   fields - the field table describing the structure.
+ * @param   src - pointer to the structure to encode.
+ */
+void json_bind_encode(json_writer_t* writer, const json_field_t* fields, const void* src)
+{
+    const uint8_t* base = (const uint8_t*)src;
+    const uint8_t* value;
+    int length;
+
+    json_writer_object_start(writer);
+    for(; fields->key; fields++)
+    {
+        value = base + fields->offset;
+        json_writer_key(writer, fields->key);
+        switch(fields->type)
+        {
+            case JSON_BIND_INT:
+                json_writer_int(writer, json_bind_load_int(fields, value));
+            break;
+            case JSON_BIND_UINT:
+                json_writer_uint(writer, (uint32_t)json_bind_load_int(fields, value));
+            break;
+            case JSON_BIND_BOOL:
+                json_writer_bool(writer, *(bool*)value);
+            break;
+            case JSON_BIND_FLOAT:
+                json_writer_float(writer, *(float*)value, JSON_BIND_DECIMALS);
+            break;
+            case JSON_BIND_STRING:
+                for(length = 0; length < fields->size && value[length]; length++);
+                json_writer_string_n(writer, (const char*)value, length);
+            break;
+            case JSON_BIND_OBJECT:
+                if(fields->fields)
+                    json_bind_encode(writer, fields->fields, value);
+                else
+                    json_writer_null(writer);
+            break;
+        }
+    }
+    json_writer_object_end(writer);
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+ * @addtogroup jsmn_extensions
+ *
+ * table driven binding of json objects to C structures.
+ *
+ * a structure is described by an array of json_field_t, terminated with JSON_FIELD_END.
+ * a json object may then be decoded into the structure in a single pass over its
+ * tokens, from a parsed json_t or from a json_stream_t, and encoded from it with a json_writer_t.
+ *
+ * @code
+ * typedef struct {
+ *     int16_t port;
+ *     char name[16];
+ *     bool enabled;
+ * }server_conf_t;
+ *
+ * static const json_field_t server_conf_fields[] = {
+ *     JSON_FIELD(server_conf_t, port, JSON_BIND_INT),
+ *     JSON_FIELD(server_conf_t, name, JSON_BIND_STRING),
+ *     JSON_FIELD(server_conf_t, enabled, JSON_BIND_BOOL),
+ *     JSON_FIELD_END
+ * };
+ *
+ * server_conf_t conf;
+ * json_bind_decode(&json, json.tokens, server_conf_fields, &conf);
+ * @endcode
+ *
+ * @{
+ */
+
+#ifndef JSON_BIND_H_
+#define JSON_BIND_H_
+
+#include "jsmn_extensions.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/**
+ * the maximum nesting depth of bound objects, when decoding from a json stream.
+ */
+#ifndef JSON_BIND_MAX_DEPTH
+#define JSON_BIND_MAX_DEPTH     4
+#endif
+
+/**
+ * the number of decimal places used to encode JSON_BIND_FLOAT fields.
+ */
+#ifndef JSON_BIND_DECIMALS
+#define JSON_BIND_DECIMALS      3
+#endif
+
+typedef enum {
+    JSON_BIND_INT,          ///< signed integer field, of 1, 2 or 4 bytes
+    JSON_BIND_UINT,         ///< unsigned integer field, of 1, 2 or 4 bytes
+    JSON_BIND_BOOL,         ///< bool field
+    JSON_BIND_FLOAT,        ///< float field
+    JSON_BIND_STRING,       ///< char array field, always 0 terminated
+    JSON_BIND_OBJECT        ///< structure field, described by another field table
+}json_bind_type_t;
+
+typedef struct _json_field_t {
+    const char* key;                        ///< the json object key, NULL terminates a field table
+    json_bind_type_t type;                  ///< the field type
+    uint16_t offset;                        ///< offset of the field in the structure
+    uint16_t size;                          ///< size of the field in the structure
+    const struct _json_field_t* fields;     ///< the field table of a JSON_BIND_OBJECT field
+}json_field_t;
+
+/**
+ * describes a field of a structure, using the member name as the json key.
+ */
+#define JSON_FIELD(structure, member, type) {#member, type, offsetof(structure, member), sizeof(((structure*)0)->member), NULL}
+/**
+ * describes a field of a structure, with a json key that differs from the member name.
+ */
+#define JSON_FIELD_KEY(structure, member, key, type) {key, type, offsetof(structure, member), sizeof(((structure*)0)->member), NULL}
+/**
+ * describes a structure field of a structure, with its own field table.
+ */
+#define JSON_FIELD_OBJECT(structure, member, table) {#member, JSON_BIND_OBJECT, offsetof(structure, member), sizeof(((structure*)0)->member), table}
+/**
+ * terminates a field table.
+ */
+#define JSON_FIELD_END {NULL, JSON_BIND_INT, 0, 0, NULL}
+
+/**
+ * json stream visitor context, used by json_bind_stream_init().
+ */
+typedef struct {
+    const json_field_t* fields[JSON_BIND_MAX_DEPTH];    ///< field table of each open bound object
+    uint8_t* base[JSON_BIND_MAX_DEPTH];                 ///< structure address of each open bound object
+    const json_field_t* field;                          ///< the field matched by the last key, or NULL
+    int8_t level;                                       ///< index of the innermost open bound object, -1 before the first
+    uint8_t skip;                                       ///< nesting depth within unbound values
+    int count;                                          ///< number of fields set
+}json_bind_t;
+
+int json_bind_decode(json_t* json, jsmntok_t* object, const json_field_t* fields, void* dest);
+void json_bind_stream_init(json_stream_t* stream, json_bind_t* bind, const json_field_t* fields, void* dest, char* window, int window_size);
+int json_bind_count(json_bind_t* bind);
+void json_bind_encode(json_writer_t* writer, const json_field_t* fields, const void* src);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif // JSON_BIND_H_
+
+/**
+ * @}
+ */
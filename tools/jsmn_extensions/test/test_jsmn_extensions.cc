@@ -0,0 +1,418 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include "gtest/gtest.h"
+#include "jsmn_extensions.h"
+
+#define NTOKENS 512
+
+static const char nested_doc[] =
+    "{\"a\": {\"x\": [1, {\"y\": 2}], \"z\": 3},"
+    " \"b\": [[1, 2], [3, [4, 5]], {\"k\": \"v\"}],"
+    " \"c\": \"str\","
+    " \"d\": {\"a\": 10, \"a\": 11},"
+    " \"e\": []}";
+
+class test_jsmn_extensions : public ::testing::TestWithParam<bool>
+{
+protected:
+    json_t json;
+    json_index_t index;
+    jsmntok_t tokens[NTOKENS];
+    uint16_t next[NTOKENS];
+    int16_t keys[64];
+    char buffer[sizeof(nested_doc)];
+
+    virtual void SetUp()
+    {
+        memcpy(buffer, nested_doc, sizeof(nested_doc));
+        ASSERT_GT(json_init(&json, tokens, NTOKENS, buffer, sizeof(nested_doc)-1), 0);
+        if(GetParam()) {
+            ASSERT_EQ(json_index(&json, &index, next, keys, 64), 11);
+        }
+    }
+};
+
+TEST_P(test_jsmn_extensions, value_by_key_skips_nested_containers)
+{
+    jsmntok_t* root = json.tokens;
+
+    ASSERT_EQ(json_get_value_by_key(&json, root, (char*)"a")->type, JSMN_OBJECT);
+    ASSERT_EQ(json_get_value_by_key(&json, root, (char*)"b")->type, JSMN_ARRAY);
+    ASSERT_STREQ(json_string_value(&json), (char*)NULL);
+    ASSERT_STREQ(json_token_string_value(&json, json_get_value_by_key(&json, root, (char*)"c")), "str");
+    ASSERT_EQ(json_get_value_by_key(&json, root, (char*)"x"), (jsmntok_t*)NULL);
+    ASSERT_EQ(json_get_value_by_key(&json, root, (char*)"y"), (jsmntok_t*)NULL);
+    ASSERT_EQ(json_get_value_by_key(&json, root, (char*)"e")->size, 0);
+    ASSERT_EQ(json_get_value_by_key(&json, root, (char*)"none"), (jsmntok_t*)NULL);
+}
+
+TEST_P(test_jsmn_extensions, value_by_key_in_nested_object)
+{
+    jsmntok_t* a = json_get_value_by_key(&json, json.tokens, (char*)"a");
+    jsmntok_t* d = json_get_value_by_key(&json, json.tokens, (char*)"d");
+
+    ASSERT_EQ(json_token_integer_value(&json, json_get_value_by_key(&json, a, (char*)"z")), 3);
+    // the first of duplicate keys is found, and keys of other objects are not
+    ASSERT_EQ(json_token_integer_value(&json, json_get_value_by_key(&json, d, (char*)"a")), 10);
+    ASSERT_EQ(json_get_value_by_key(&json, d, (char*)"z"), (jsmntok_t*)NULL);
+
+    jsmntok_t* x = json_get_value_by_key(&json, a, (char*)"x");
+    jsmntok_t* y = json_get_value_by_key(&json, json_get_item_by_index(&json, x, 1), (char*)"y");
+    ASSERT_EQ(json_token_integer_value(&json, y), 2);
+}
+
+TEST_P(test_jsmn_extensions, item_by_index_skips_nested_containers)
+{
+    jsmntok_t* b = json_get_value_by_key(&json, json.tokens, (char*)"b");
+
+    ASSERT_EQ(json_get_item_by_index(&json, b, 0)->size, 2);
+    jsmntok_t* item = json_get_item_by_index(&json, b, 1);
+    ASSERT_EQ(json_token_integer_value(&json, json_get_item_by_index(&json, item, 0)), 3);
+    ASSERT_EQ(json_token_integer_value(&json, json_get_item_by_index(&json, json_get_item_by_index(&json, item, 1), 1)), 5);
+    item = json_get_item_by_index(&json, b, 2);
+    ASSERT_EQ(item->type, JSMN_OBJECT);
+    ASSERT_STREQ(json_token_string_value(&json, json_get_value_by_key(&json, item, (char*)"k")), "v");
+    ASSERT_EQ(json_get_item_by_index(&json, b, 3), (jsmntok_t*)NULL);
+}
+
+TEST_P(test_jsmn_extensions, iterators_skip_nested_containers)
+{
+    const char* expected_keys[] = {"a", "b", "c", "d", "e"};
+    jsmntype_t expected_types[] = {JSMN_OBJECT, JSMN_ARRAY, JSMN_STRING, JSMN_OBJECT, JSMN_ARRAY};
+    int count = 0;
+
+    json_reset_iterator(&json, json.tokens);
+    while(json_iterator(&json))
+    {
+        ASSERT_LT(count, 5);
+        ASSERT_TRUE(json_value_match(&json, expected_keys[count]));
+        ASSERT_EQ(json_iterator_get_object_value(&json)->type, expected_types[count]);
+        count++;
+    }
+    ASSERT_EQ(count, 5);
+
+    count = 0;
+    json_reset_iterator(&json, json.tokens);
+    while(json_object_value_iterator(&json))
+    {
+        ASSERT_LT(count, 5);
+        ASSERT_EQ(json_type(&json), expected_types[count]);
+        count++;
+    }
+    ASSERT_EQ(count, 5);
+
+    count = 0;
+    json_reset_iterator(&json, json_get_value_by_key(&json, json.tokens, (char*)"b"));
+    while(json_iterator(&json))
+        count++;
+    ASSERT_EQ(count, 3);
+
+    json_reset_iterator(&json, json_get_value_by_key(&json, json.tokens, (char*)"e"));
+    ASSERT_EQ(json_iterator(&json), (jsmntok_t*)NULL);
+}
+
+INSTANTIATE_TEST_CASE_P(with_and_without_index, test_jsmn_extensions, ::testing::Values(false, true));
+
+TEST(test_json_index, index_fails_when_key_table_too_small)
+{
+    json_t json;
+    json_index_t index;
+    jsmntok_t tokens[NTOKENS];
+    uint16_t next[NTOKENS];
+    int16_t keys[8];
+    char buffer[sizeof(nested_doc)];
+
+    memcpy(buffer, nested_doc, sizeof(nested_doc));
+    ASSERT_GT(json_init(&json, tokens, NTOKENS, buffer, sizeof(nested_doc)-1), 0);
+    ASSERT_EQ(json_index(&json, &index, next, keys, 8), -1);
+    ASSERT_EQ(json_index(&json, &index, next, keys, 6), -1);
+    ASSERT_EQ(json.index, (json_index_t*)NULL);
+    ASSERT_EQ(json_token_integer_value(&json, json_get_value_by_key(&json, json_get_value_by_key(&json, tokens, (char*)"a"), (char*)"z")), 3);
+}
+
+/**
+ * not a pass/fail test, prints the lookup time for a ~300 token document with and without an index.
+ * disabled by default, run with --gtest_also_run_disabled_tests.
+ */
+TEST(test_json_index, DISABLED_lookup_benchmark)
+{
+    static char doc[8192];
+    static jsmntok_t tokens[NTOKENS];
+    static uint16_t next[NTOKENS];
+    static int16_t keys[256];
+    char key[16];
+    json_t json;
+    json_index_t index;
+    int length = 0;
+    int i;
+    int n;
+    int rounds = 2000;
+    clock_t start;
+    double plain;
+    double indexed;
+
+    // 30 fields, each a nested object of 4 key/value pairs
+    length += sprintf(doc + length, "{");
+    for(i = 0; i < 30; i++)
+        length += sprintf(doc + length, "%s\"field%d\": {\"id\": %d, \"name\": \"n%d\", \"values\": [%d, %d], \"ok\": true}",
+                i ? ", " : "", i, i, i, i, i+1);
+    length += sprintf(doc + length, "}");
+
+    ASSERT_GT(json_init(&json, tokens, NTOKENS, doc, length), 250);
+
+    for(n = 0; n < 2; n++)
+    {
+        if(n) {
+            ASSERT_EQ(json_index(&json, &index, next, keys, 256), 150);
+        }
+
+        start = clock();
+        for(int r = 0; r < rounds; r++)
+        {
+            for(i = 0; i < 30; i++)
+            {
+                sprintf(key, "field%d", i);
+                jsmntok_t* field = json_get_value_by_key(&json, tokens, key);
+                ASSERT_EQ(json_token_integer_value(&json, json_get_value_by_key(&json, field, (char*)"id")), i);
+            }
+        }
+        if(n)
+            indexed = (double)(clock() - start) / CLOCKS_PER_SEC;
+        else
+            plain = (double)(clock() - start) / CLOCKS_PER_SEC;
+    }
+
+    printf("%d tokens, %d lookups: %.1fns/lookup without index, %.1fns/lookup with index\n",
+            json.ntokens, rounds * 60, plain * 1e9 / (rounds * 60), indexed * 1e9 / (rounds * 60));
+}
+
+static bool record_visitor(json_stream_t* stream, json_stream_event_t event, char* value, int length)
+{
+    std::string* record = (std::string*)stream->ctx;
+    const char* names[] = {"{", "}", "[", "]", "K", "S", "P"};
+    char depth[8];
+
+    sprintf(depth, "%d", json_stream_depth(stream));
+    *record += names[event];
+    *record += depth;
+    if(value)
+    {
+        EXPECT_EQ((int)strlen(value), length);
+        *record += value;
+        if(event != JSON_STREAM_KEY)
+        {
+            *record += "@";
+            *record += json_stream_key(stream);
+        }
+    }
+    *record += " ";
+    return true;
+}
+
+static const char* nested_doc_events =
+    "{0 K1a {1 K2x [2 P31@x {3 K4y P42@y }3 ]2 K2z P23@z }1 K1b [1 [2 P31@b P32@b ]2 [2 P33@b [3 P44@b P45@b ]3 ]2 "
+    "{2 K3k S3v@k }2 ]1 K1c S1str@c K1d {1 K2a P210@a K2a P211@a }1 K1e [1 ]1 }0 ";
+
+TEST(test_json_stream, stream_events_whole_document)
+{
+    std::string record;
+    char window[16];
+    json_stream_t stream;
+
+    json_stream_init(&stream, record_visitor, &record, window, sizeof(window));
+    ASSERT_EQ(json_stream_feed(&stream, nested_doc, sizeof(nested_doc)-1), JSON_STREAM_DONE);
+    ASSERT_EQ(json_stream_finish(&stream), JSON_STREAM_DONE);
+    ASSERT_STREQ(record.c_str(), nested_doc_events);
+}
+
+TEST(test_json_stream, stream_events_one_byte_at_a_time)
+{
+    std::string record;
+    char window[16];
+    json_stream_t stream;
+    unsigned int i;
+
+    json_stream_init(&stream, record_visitor, &record, window, sizeof(window));
+    for(i = 0; i < sizeof(nested_doc)-2; i++)
+        ASSERT_EQ(json_stream_feed(&stream, nested_doc + i, 1), JSON_STREAM_MORE);
+    ASSERT_EQ(json_stream_feed(&stream, nested_doc + i, 1), JSON_STREAM_DONE);
+    ASSERT_EQ(json_stream_feed(&stream, " \r\n", 3), JSON_STREAM_DONE);
+    ASSERT_STREQ(record.c_str(), nested_doc_events);
+}
+
+TEST(test_json_stream, stream_strings_and_primitives)
+{
+    std::string record;
+    char window[16];
+    json_stream_t stream;
+
+    json_stream_init(&stream, record_visitor, &record, window, sizeof(window));
+    const char* doc = "[\"a\\\"b\\u00e9\", -1.5e3,true,null]";
+    ASSERT_EQ(json_stream_feed(&stream, doc, strlen(doc)), JSON_STREAM_DONE);
+    ASSERT_STREQ(record.c_str(), "[0 S1a\\\"b\\u00e9@ P1-1.5e3@ P1true@ P1null@ ]0 ");
+
+    record.clear();
+    json_stream_init(&stream, record_visitor, &record, window, sizeof(window));
+    ASSERT_EQ(json_stream_feed(&stream, "42", 2), JSON_STREAM_MORE);
+    ASSERT_EQ(json_stream_finish(&stream), JSON_STREAM_DONE);
+    ASSERT_STREQ(record.c_str(), "P042@ ");
+}
+
+TEST(test_json_stream, stream_errors)
+{
+    char window[8];
+    json_stream_t stream;
+    const char* invalid[] = {"{\"a\" 1}", "{\"a\":1]", "[1,}", "{1:2}", "[\"\\x\"]", "[1] 2", "}", NULL};
+
+    for(const char** doc = invalid; *doc; doc++)
+    {
+        json_stream_init(&stream, NULL, NULL, window, sizeof(window));
+        ASSERT_EQ(json_stream_feed(&stream, *doc, strlen(*doc)), JSMN_ERROR_INVAL) << *doc;
+        ASSERT_EQ(json_stream_feed(&stream, "", 0), JSMN_ERROR_INVAL);
+    }
+
+    json_stream_init(&stream, NULL, NULL, window, sizeof(window));
+    ASSERT_EQ(json_stream_feed(&stream, "[\"12345678\"]", 12), JSMN_ERROR_NOMEM);
+
+    json_stream_init(&stream, NULL, NULL, window, sizeof(window));
+    ASSERT_EQ(json_stream_feed(&stream, "[\"123456\"", 9), JSON_STREAM_MORE);
+    ASSERT_EQ(json_stream_finish(&stream), JSMN_ERROR_PART);
+
+    json_stream_init(&stream, NULL, NULL, window, sizeof(window));
+    ASSERT_EQ(json_stream_feed(&stream, "[[[[[[[[[[[[[[[[[", 17), JSMN_ERROR_NOMEM);
+}
+
+TEST(test_json_stream, stream_read_from_fd)
+{
+    std::string record;
+    char window[16];
+    char buffer[7];
+    json_stream_t stream;
+    int fds[2];
+
+    ASSERT_EQ(pipe(fds), 0);
+    ASSERT_EQ(write(fds[1], nested_doc, sizeof(nested_doc)-1), (int)sizeof(nested_doc)-1);
+    close(fds[1]);
+
+    json_stream_init(&stream, record_visitor, &record, window, sizeof(window));
+    ASSERT_EQ(json_stream_read(&stream, fds[0], sizeof(nested_doc)-1, buffer, sizeof(buffer)), JSON_STREAM_DONE);
+    ASSERT_STREQ(record.c_str(), nested_doc_events);
+    close(fds[0]);
+}
+
+static void write_test_doc(json_writer_t* writer)
+{
+    json_writer_object_start(writer);
+    json_writer_key(writer, "a");
+    json_writer_object_start(writer);
+    json_writer_key(writer, "x");
+    json_writer_array_start(writer);
+    json_writer_int(writer, 1);
+    json_writer_object_start(writer);
+    json_writer_key(writer, "y");
+    json_writer_int(writer, -2);
+    json_writer_object_end(writer);
+    json_writer_array_end(writer);
+    json_writer_key(writer, "z");
+    json_writer_fixed(writer, -1005, 3);
+    json_writer_object_end(writer);
+    json_writer_key(writer, "b");
+    json_writer_array_start(writer);
+    json_writer_array_start(writer);
+    json_writer_array_end(writer);
+    json_writer_float(writer, 2.5f, 2);
+    json_writer_bool(writer, true);
+    json_writer_null(writer);
+    json_writer_array_end(writer);
+    json_writer_key(writer, "c\"");
+    json_writer_string(writer, "q\"\\\n\x01/");
+    json_writer_object_end(writer);
+}
+
+static const char* test_doc_text =
+    "{\"a\":{\"x\":[1,{\"y\":-2}],\"z\":-1.005},\"b\":[[],2.50,true,null],\"c\\\"\":\"q\\\"\\\\\\n\\u0001/\"}";
+
+TEST(test_json_writer, write_to_buffer)
+{
+    char buffer[128];
+    json_writer_t writer;
+
+    json_writer_init(&writer, buffer, sizeof(buffer), -1);
+    write_test_doc(&writer);
+    ASSERT_EQ(json_writer_finish(&writer), (int)strlen(test_doc_text));
+    ASSERT_EQ(memcmp(buffer, test_doc_text, strlen(test_doc_text)), 0);
+
+    // the output is valid json
+    jsmntok_t tokens[32];
+    json_t json;
+    ASSERT_EQ(json_init(&json, tokens, 32, buffer, writer.total), 19);
+}
+
+TEST(test_json_writer, write_overflows_buffer)
+{
+    char buffer[16];
+    json_writer_t writer;
+
+    json_writer_init(&writer, buffer, sizeof(buffer), -1);
+    write_test_doc(&writer);
+    ASSERT_EQ(json_writer_finish(&writer), JSMN_ERROR_NOMEM);
+}
+
+TEST(test_json_writer, write_unbalanced)
+{
+    char buffer[128];
+    json_writer_t writer;
+    int i;
+
+    json_writer_init(&writer, buffer, sizeof(buffer), -1);
+    json_writer_array_end(&writer);
+    ASSERT_EQ(json_writer_finish(&writer), JSMN_ERROR_INVAL);
+    ASSERT_EQ(writer.depth, 0);
+
+    json_writer_init(&writer, buffer, sizeof(buffer), -1);
+    for(i = 0; i < JSON_WRITER_MAX_DEPTH + 4; i++)
+        json_writer_array_start(&writer);
+    ASSERT_EQ(json_writer_finish(&writer), JSMN_ERROR_NOMEM);
+    ASSERT_EQ(writer.depth, JSON_WRITER_MAX_DEPTH - 1);
+}
+
+TEST(test_json_writer, write_flushes_to_fd)
+{
+    char buffer[5];
+    char result[128];
+    json_writer_t writer;
+    int fds[2];
+
+    ASSERT_EQ(pipe(fds), 0);
+    json_writer_init(&writer, buffer, sizeof(buffer), fds[1]);
+    write_test_doc(&writer);
+    ASSERT_EQ(json_writer_finish(&writer), (int)strlen(test_doc_text));
+    close(fds[1]);
+    ASSERT_EQ(read(fds[0], result, sizeof(result)), (int)strlen(test_doc_text));
+    ASSERT_EQ(memcmp(result, test_doc_text, strlen(test_doc_text)), 0);
+    close(fds[0]);
+}
+
+TEST(test_json_writer, write_numbers)
+{
+    char buffer[128];
+    json_writer_t writer;
+
+    json_writer_init(&writer, buffer, sizeof(buffer), -1);
+    json_writer_array_start(&writer);
+    json_writer_int(&writer, 0);
+    json_writer_int(&writer, INT32_MIN);
+    json_writer_int(&writer, INT32_MAX);
+    json_writer_fixed(&writer, 5, 2);
+    json_writer_fixed(&writer, -5, 1);
+    json_writer_float(&writer, -0.126f, 2);
+    json_writer_float(&writer, 1e12f, 2);
+    json_writer_array_end(&writer);
+    ASSERT_GT(json_writer_finish(&writer), 0);
+    buffer[writer.total] = '\0';
+    ASSERT_STREQ(buffer, "[0,-2147483648,2147483647,0.05,-0.5,-0.13,null]");
+}
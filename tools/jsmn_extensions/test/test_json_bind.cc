@@ -0,0 +1,130 @@
+#include <string.h>
+#include <stdint.h>
+#include "gtest/gtest.h"
+#include "json_bind.h"
+
+typedef struct {
+    uint8_t ip[4];
+    uint16_t port;
+}endpoint_t;
+
+typedef struct {
+    int16_t count;
+    uint32_t serial;
+    bool enabled;
+    float gain;
+    char name[8];
+    endpoint_t endpoint;
+}device_t;
+
+static const json_field_t endpoint_fields[] = {
+    JSON_FIELD(endpoint_t, port, JSON_BIND_UINT),
+    JSON_FIELD_END
+};
+
+static const json_field_t device_fields[] = {
+    JSON_FIELD(device_t, count, JSON_BIND_INT),
+    JSON_FIELD(device_t, serial, JSON_BIND_UINT),
+    JSON_FIELD_KEY(device_t, enabled, "on", JSON_BIND_BOOL),
+    JSON_FIELD(device_t, gain, JSON_BIND_FLOAT),
+    JSON_FIELD(device_t, name, JSON_BIND_STRING),
+    JSON_FIELD_OBJECT(device_t, endpoint, endpoint_fields),
+    JSON_FIELD_END
+};
+
+static const char* device_text =
+    "{\"extra\":{\"count\":99,\"list\":[1,{\"name\":\"no\"}]},\"count\":-12,\"serial\":4000000000,"
+    "\"on\":true,\"gain\":1.5,\"name\":\"truncated name\",\"endpoint\":{\"port\":8080,\"ip\":[1,2,3,4]},"
+    "\"count\":\"wrong type\"}";
+
+static void check_device(device_t* device)
+{
+    ASSERT_EQ(device->count, -12);
+    ASSERT_EQ(device->serial, 4000000000u);
+    ASSERT_TRUE(device->enabled);
+    ASSERT_FLOAT_EQ(device->gain, 1.5f);
+    ASSERT_STREQ(device->name, "truncat");
+    ASSERT_EQ(device->endpoint.port, 8080);
+}
+
+TEST(test_json_bind, decode_tokens)
+{
+    char text[256];
+    jsmntok_t tokens[64];
+    json_t json;
+    device_t device;
+
+    memset(&device, 0, sizeof(device));
+    strcpy(text, device_text);
+    ASSERT_GT(json_init(&json, tokens, 64, text, strlen(text)), 0);
+    ASSERT_EQ(json_bind_decode(&json, json.tokens, device_fields, &device), 7);
+    check_device(&device);
+    ASSERT_EQ(json_bind_decode(&json, json.tokens + 1, device_fields, &device), -1);
+}
+
+TEST(test_json_bind, decode_stream)
+{
+    json_stream_t stream;
+    json_bind_t bind;
+    char window[32];
+    device_t device;
+    int i;
+
+    memset(&device, 0, sizeof(device));
+    json_bind_stream_init(&stream, &bind, device_fields, &device, window, sizeof(window));
+    // feed a few bytes at a time
+    for(i = 0; i < (int)strlen(device_text); i += 5)
+    {
+        int length = strlen(device_text) - i;
+        ASSERT_GE(json_stream_feed(&stream, device_text + i, length < 5 ? length : 5), 0);
+    }
+    ASSERT_EQ(json_stream_finish(&stream), JSON_STREAM_DONE);
+    ASSERT_EQ(json_bind_count(&bind), 7);
+    check_device(&device);
+}
+
+TEST(test_json_bind, encode_decode)
+{
+    char buffer[256];
+    jsmntok_t tokens[64];
+    json_writer_t writer;
+    json_t json;
+    device_t device = {-7, 4000000000u, true, -0.25f, "abc\"", {{0}, 65535}};
+    device_t decoded;
+
+    json_writer_init(&writer, buffer, sizeof(buffer), -1);
+    json_bind_encode(&writer, device_fields, &device);
+    ASSERT_GT(json_writer_finish(&writer), 0);
+    buffer[writer.total] = '\0';
+    ASSERT_STREQ(buffer, "{\"count\":-7,\"serial\":4000000000,\"on\":true,\"gain\":-0.250,"
+                         "\"name\":\"abc\\\"\",\"endpoint\":{\"port\":65535}}");
+
+    memset(&decoded, 0, sizeof(decoded));
+    ASSERT_GT(json_init(&json, tokens, 64, buffer, writer.total), 0);
+    ASSERT_EQ(json_bind_decode(&json, json.tokens, device_fields, &decoded), 7);
+    ASSERT_EQ(decoded.count, -7);
+    ASSERT_EQ(decoded.serial, 4000000000u);
+    ASSERT_FLOAT_EQ(decoded.gain, -0.25f);
+    ASSERT_EQ(decoded.endpoint.port, 65535);
+}
+
+TEST(test_json_bind, decode_decimal_only)
+{
+    char text[128];
+    jsmntok_t tokens[16];
+    json_t json;
+    device_t device;
+
+    memset(&device, 0, sizeof(device));
+    strcpy(text, "{\"count\":010,\"serial\":0x10,\"endpoint\":{\"port\":80}}");
+    ASSERT_GT(json_init(&json, tokens, 16, text, strlen(text)), 0);
+    ASSERT_EQ(json_bind_decode(&json, json.tokens, device_fields, &device), 3);
+    ASSERT_EQ(device.count, 10);
+    ASSERT_EQ(device.serial, 0u);
+
+    device.count = 3;
+    strcpy(text, "{\"count\":1.5}");
+    ASSERT_GT(json_init(&json, tokens, 16, text, strlen(text)), 0);
+    ASSERT_EQ(json_bind_decode(&json, json.tokens, device_fields, &device), 0);
+    ASSERT_EQ(device.count, 3);
+}
@@ -30,8 +30,31 @@
  *
  */
 
+#include <string.h>
 #include "vfifo.h"
 
+/**
+ * copies one element of the given size, using a single word access for 1, 2 and 4 byte elements.
+ */
+static inline void vfifo_copy_element(volatile void* dst, const volatile void* src, int32_t element_size)
+{
+	switch(element_size)
+	{
+		case 1:
+			*(volatile uint8_t*)dst = *(const volatile uint8_t*)src;
+		break;
+		case 2:
+			*(volatile uint16_t*)dst = *(const volatile uint16_t*)src;
+		break;
+		case 4:
+			*(volatile uint32_t*)dst = *(const volatile uint32_t*)src;
+		break;
+		default:
+			memcpy((void*)dst, (const void*)src, element_size);
+		break;
+	}
+}
+
 /**
   * @brief 	initializes an existing fifo and memory.
   * 		note that one slot in the supplied memory is always inaccessible.
@@ -41,13 +64,29 @@
   * @param  size is the number of slots of type vfifo_primitive_t in the data space.
   */
 void vfifo_init(vfifo_t* fifo, void* buf, int32_t slots)
+{
+	vfifo_init_sized(fifo, buf, slots, sizeof(vfifo_primitive_t));
+}
+
+/**
+  * @brief 	initializes an existing fifo and memory, for elements of any size.
+  * 		note that one slot in the supplied memory is always inaccessible.
+  * 		Eg: with slots=100, we can use only 99.
+  * @param	fifo is a pointer to a fifo structure.
+  * @param  buf is a pointer to the buffer memory, at least slots * element_size bytes long.
+  * 		for element sizes of 2 or 4, it should be aligned to the element size.
+  * @param  size is the number of slots in the data space.
+  * @param  element_size is the size in bytes of one element.
+  */
+void vfifo_init_sized(vfifo_t* fifo, void* buf, int32_t slots, int32_t element_size)
 {
 	if(fifo)
     {
     	fifo->head = 0;
     	fifo->tail = 0;
     	fifo->usage = 0;
-    	fifo->buf = (vfifo_primitive_t*)buf;
+    	fifo->buf = (uint8_t*)buf;
+    	fifo->element_size = element_size > 0 ? element_size : 1;
     	fifo->size = !buf ? 0 : slots;
     	fifo->free = slots > 0 ? slots-1 : 0;
     }
@@ -62,9 +101,25 @@ void vfifo_init(vfifo_t* fifo, void* buf, int32_t slots)
   */
 vfifo_t* vfifo_create(int32_t size)
 {
-	vfifo_t* vm = malloc(sizeof(vfifo_t) + ((size + 1) * sizeof(vfifo_primitive_t)));
+	return vfifo_create_sized(size, sizeof(vfifo_primitive_t));
+}
+
+/**
+  * @brief 	creates a new fifo and memory, for elements of any size.
+  * 		note that this function allocates one extra slot, so that the number
+  * 		of available slots equals that specified.
+  * @param  size is the number of slots in the data space.
+  * @param  element_size is the size in bytes of one element.
+  * @return returns a pointer to a fifo memory structure.
+  */
+vfifo_t* vfifo_create_sized(int32_t size, int32_t element_size)
+{
+	if(element_size <= 0)
+		element_size = 1;
+
+	vfifo_t* vm = malloc(sizeof(vfifo_t) + ((size + 1) * element_size));
 	if(vm) {
-		vfifo_init(vm, vm + 1, size+1);
+		vfifo_init_sized(vm, vm + 1, size+1, element_size);
 	}
 	return vm;
 }
@@ -90,7 +145,7 @@ bool vfifo_put(vfifo_t* fifo, const void* data)
 		int32_t next = (fifo->head + 1) % fifo->size;
 		if(next == fifo->tail)
 			return false;
-		fifo->buf[fifo->head] = *(vfifo_primitive_t*)data;
+		vfifo_copy_element(&fifo->buf[fifo->head * fifo->element_size], data, fifo->element_size);
 		fifo->head = next;
 		fifo->free--;
 		fifo->usage++;
@@ -112,7 +167,7 @@ bool vfifo_get(vfifo_t* fifo, void* data)
 		if(fifo->head == fifo->tail)
 			return false;
 
-		*(vfifo_primitive_t*)data = fifo->buf[fifo->tail];
+		vfifo_copy_element(data, &fifo->buf[fifo->tail * fifo->element_size], fifo->element_size);
 		fifo->tail = (fifo->tail + 1) % fifo->size;
 		fifo->free++;
 		fifo->usage--;
@@ -121,45 +176,60 @@ bool vfifo_get(vfifo_t* fifo, void* data)
 	return false;
 }
 
+/**
+  * @brief 	puts a block of elements into a fifo.
+  * 		the data is copied in at most two contiguous chunks.
+  * @param	fifo is a pointer to a fifo structure.
+  * @param	data is a pointer to the elements to be inserted into the fifo.
+  * @param	size is the number of elements to insert.
+  * @retval	returns the number of elements inserted, less than size if the fifo filled up.
+  */
 int32_t vfifo_put_block(vfifo_t* fifo, const void* data, int32_t size)
 {
 	int32_t i = 0;
-	const vfifo_primitive_t* d = data;
+	const uint8_t* d = data;
+	void* region;
+	int32_t count;
 
-	if(fifo->size > 0)
-	{
-		while(i < size) {
-			int32_t next = (fifo->head + 1) % fifo->size;
-			if(next == fifo->tail)
-				break;
-			fifo->buf[fifo->head] = *d;
-			fifo->head = next;
-			fifo->free--;
-			fifo->usage++;
-			i++;
-			d++;
-		}
+	while(i < size) {
+		count = vfifo_write_reserve(fifo, &region);
+		if(count <= 0)
+			break;
+		if(count > size - i)
+			count = size - i;
+		memcpy(region, d, count * fifo->element_size);
+		vfifo_write_commit(fifo, count);
+		d += count * fifo->element_size;
+		i += count;
 	}
 	return i;
 }
 
+/**
+  * @brief 	gets a block of elements out of a fifo.
+  * 		the data is copied out in at most two contiguous chunks.
+  * @param	fifo is a pointer to a fifo structure.
+  * @param	data is a pointer to the destination memory.
+  * @param	size is the maximum number of elements to get.
+  * @retval	returns the number of elements read, less than size if the fifo emptied.
+  */
 int32_t vfifo_get_block(vfifo_t* fifo, void* data, int32_t size)
 {
 	int32_t i = 0;
-	vfifo_primitive_t* d = data;
+	uint8_t* d = data;
+	void* region;
+	int32_t count;
 
-	if(fifo->size > 0)
-	{
-		while(i < size) {
-			if(fifo->head == fifo->tail)
-				break;
-			*d = fifo->buf[fifo->tail];
-			fifo->tail = (fifo->tail + 1) % fifo->size;
-			fifo->free++;
-			fifo->usage--;
-			i++;
-			d++;
-		}
+	while(i < size) {
+		count = vfifo_read_peek(fifo, &region);
+		if(count <= 0)
+			break;
+		if(count > size - i)
+			count = size - i;
+		memcpy(d, region, count * fifo->element_size);
+		vfifo_read_consume(fifo, count);
+		d += count * fifo->element_size;
+		i += count;
 	}
 	return i;
 }
@@ -193,6 +263,15 @@ int32_t	vfifo_number_of_slots(vfifo_t* fifo)
 	return fifo->size > 0 ? fifo->size - 1 : 0;
 }
 
+/**
+  * @param	fifo is a pointer to a fifo structure.
+  * @retval	returns the size in bytes of one fifo element.
+  */
+int32_t vfifo_element_size(vfifo_t* fifo)
+{
+	return fifo->element_size;
+}
+
 /**
   * @brief	determines if the fifo is full, or not.
   * @param	fifo is a pointer to a fifo structure.
@@ -224,3 +303,89 @@ void vfifo_reset(vfifo_t* fifo)
 	fifo->tail = 0;
 	fifo->free =  fifo->size > 0 ? fifo->size - 1 : 0;
 }
+
+/**
+  * @brief	gets the largest contiguous free region in the fifo data space,
+  * 		starting at the head. data may be written directly into the region,
+  * 		by a DMA engine for example, then added to the fifo with vfifo_write_commit().
+  * 		when the free space wraps around the end of the data space, only the
+  * 		part up to the end is returned. commit it, then reserve again for the rest.
+  * @param	fifo is a pointer to a fifo structure.
+  * @param	region is set to point at the start of the free region, or NULL if there is none.
+  * @retval	returns the number of contiguous free slots at region.
+  */
+int32_t vfifo_write_reserve(vfifo_t* fifo, void** region)
+{
+	int32_t head = fifo->head;
+	int32_t tail = fifo->tail;
+	int32_t count = 0;
+
+	if(fifo->size > 0)
+	{
+		if(head >= tail)
+			count = fifo->size - head - (tail == 0 ? 1 : 0);
+		else
+			count = tail - head - 1;
+	}
+
+	*region = count > 0 ? (void*)&fifo->buf[head * fifo->element_size] : NULL;
+	return count;
+}
+
+/**
+  * @brief	adds slots written into a region obtained from vfifo_write_reserve() to the fifo.
+  * @param	fifo is a pointer to a fifo structure.
+  * @param	count is the number of slots written, must not exceed the number reserved.
+  */
+void vfifo_write_commit(vfifo_t* fifo, int32_t count)
+{
+	if(fifo->size > 0 && count > 0)
+	{
+		fifo->head = (fifo->head + count) % fifo->size;
+		fifo->free -= count;
+		fifo->usage += count;
+	}
+}
+
+/**
+  * @brief	gets the largest contiguous filled region in the fifo data space,
+  * 		starting at the tail. data may be read or parsed directly from the region,
+  * 		then removed from the fifo with vfifo_read_consume().
+  * 		when the data wraps around the end of the data space, only the part
+  * 		up to the end is returned. consume it, then peek again for the rest.
+  * @param	fifo is a pointer to a fifo structure.
+  * @param	region is set to point at the oldest data in the fifo, or NULL if it is empty.
+  * @retval	returns the number of contiguous filled slots at region.
+  */
+int32_t vfifo_read_peek(vfifo_t* fifo, void** region)
+{
+	int32_t head = fifo->head;
+	int32_t tail = fifo->tail;
+	int32_t count = 0;
+
+	if(fifo->size > 0)
+	{
+		if(head >= tail)
+			count = head - tail;
+		else
+			count = fifo->size - tail;
+	}
+
+	*region = count > 0 ? (void*)&fifo->buf[tail * fifo->element_size] : NULL;
+	return count;
+}
+
+/**
+  * @brief	removes slots read from a region obtained from vfifo_read_peek() from the fifo.
+  * @param	fifo is a pointer to a fifo structure.
+  * @param	count is the number of slots read, must not exceed the number peeked.
+  */
+void vfifo_read_consume(vfifo_t* fifo, int32_t count)
+{
+	if(fifo->size > 0 && count > 0)
+	{
+		fifo->tail = (fifo->tail + count) % fifo->size;
+		fifo->free += count;
+		fifo->usage -= count;
+	}
+}
@@ -39,7 +39,10 @@
 #include <stdlib.h>
 
 /**
- * define VFIFO_PRIMITIVE externally to compile for a custom type.
+ * the element type of fifos created with @ref vfifo_init or @ref vfifo_create.
+ * define VFIFO_PRIMITIVE externally to change the default element type.
+ * fifos of any other element size may be created alongside using
+ * @ref vfifo_init_sized or @ref vfifo_create_sized.
  */
 #ifndef VFIFO_PRIMITIVE
 #define VFIFO_PRIMITIVE uint8_t
@@ -49,7 +52,9 @@ typedef VFIFO_PRIMITIVE vfifo_primitive_t;
 
 /**
  * The VFIFO data type, defines one n-bit FIFO where n may be any multiple of 8.
- * Use @ref vfifo_init to create this object.
+ * The element size is set per fifo, elements of 1, 2 and 4 bytes are copied as
+ * single words, larger elements are copied with memcpy.
+ * Use @ref vfifo_init or @ref vfifo_init_sized to create this object.
  *
  * have set volatile on the members...
  * when compiled using gcc-arm-none-eabi-5_4-2016q3 and running on stm32f407v
@@ -59,14 +64,17 @@ typedef VFIFO_PRIMITIVE vfifo_primitive_t;
 typedef struct {
    volatile int32_t head;			///< the FIFO head position indicator
    volatile int32_t tail;			///< the FIFO tail position indicator
-   volatile vfifo_primitive_t* buf;	///< a pointer to the FIFO buffer data space
-   volatile int32_t size;			///< the size in words of the FIFO
+   volatile uint8_t* buf;			///< a pointer to the FIFO buffer data space
+   volatile int32_t size;			///< the size in elements of the FIFO
+   int32_t element_size;			///< the size in bytes of one FIFO element
    volatile int32_t free;			///< the number of free spaces in the FIFO buffer
    volatile int32_t usage;			///< the number of filled spaces the FIFO buffer
 } vfifo_t;
 
 void vfifo_init(vfifo_t* fifo, void* buf, int32_t size); ///< use this with a predefined memory block.
 vfifo_t* vfifo_create(int32_t size); ///< use this to get a vfifo initialized on the heap.
+void vfifo_init_sized(vfifo_t* fifo, void* buf, int32_t size, int32_t element_size); ///< as vfifo_init(), with elements of element_size bytes.
+vfifo_t* vfifo_create_sized(int32_t size, int32_t element_size); ///< as vfifo_create(), with elements of element_size bytes.
 void vfifo_delete(vfifo_t* fifo); ///< deletes a fifo created with vfifo_create().
 
 bool vfifo_put(vfifo_t* fifo, const void* data);
@@ -76,8 +84,14 @@ int32_t vfifo_get_block(vfifo_t* fifo, void* data, int32_t size);
 int32_t vfifo_used_slots(vfifo_t* fifo);
 int32_t	vfifo_free_slots(vfifo_t* fifo);
 int32_t	vfifo_number_of_slots(vfifo_t* fifo);
+int32_t vfifo_element_size(vfifo_t* fifo);
 bool vfifo_full(vfifo_t* fifo);
 bool vfifo_empty(vfifo_t* fifo);
 void	vfifo_reset(vfifo_t* fifo);
 
+int32_t vfifo_write_reserve(vfifo_t* fifo, void** region); ///< get the largest contiguous free region, for zero copy writes.
+void vfifo_write_commit(vfifo_t* fifo, int32_t count); ///< marks count slots of a reserved region as written.
+int32_t vfifo_read_peek(vfifo_t* fifo, void** region); ///< get the largest contiguous filled region, for zero copy reads.
+void vfifo_read_consume(vfifo_t* fifo, int32_t count); ///< releases count slots of a peeked region.
+
 #endif /* VFIFO_H_ */